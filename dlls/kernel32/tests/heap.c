@@ -174,6 +174,135 @@ DWORD WINAPI heap_thread_proc( void *arg )
     return 0;
 }
 
+static DWORD WINAPI lfh_thread_proc( void *arg )
+{
+    BYTE **ptrs = arg;
+    UINT i, j;
+    BOOL ret;
+
+    for (j = 0; j < 16; j++)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            if (ptrs[i])
+            {
+                ret = HeapFree( GetProcessHeap(), 0, ptrs[i] );
+                ok( ret, "HeapFree failed, error %lu\n", GetLastError() );
+            }
+            ptrs[i] = HeapAlloc( GetProcessHeap(), 0, 8 + (i + j) % 32 * 16 );
+            ok( !!ptrs[i], "HeapAlloc failed, error %lu\n", GetLastError() );
+            memset( ptrs[i], 0xcc, 8 + (i + j) % 32 * 16 );
+        }
+    }
+
+    /* leave some blocks allocated from this thread to the main thread */
+    for (i = 0; i < 256; i += 2)
+    {
+        ret = HeapFree( GetProcessHeap(), 0, ptrs[i] );
+        ok( ret, "HeapFree failed, error %lu\n", GetLastError() );
+        ptrs[i] = NULL;
+    }
+
+    return 0;
+}
+
+static void test_process_heap_threads(void)
+{
+    BYTE *ptrs[256] = {0};
+    HANDLE threads[4];
+    UINT i, j;
+    DWORD res;
+    BOOL ret;
+
+    /* blocks freed and allocated again from several threads, possibly cached per thread */
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        threads[i] = CreateThread( NULL, 0, lfh_thread_proc, ptrs, 0, NULL );
+        ok( !!threads[i], "CreateThread failed, error %lu\n", GetLastError() );
+        res = WaitForSingleObject( threads[i], INFINITE );
+        ok( !res, "WaitForSingleObject returned %#lx, error %lu\n", res, GetLastError() );
+        CloseHandle( threads[i] );
+
+        ret = HeapValidate( GetProcessHeap(), 0, NULL );
+        ok( ret, "HeapValidate failed\n" );
+
+        for (j = 1; j < 256; j += 2)
+        {
+            ok( ptrs[j][0] == 0xcc, "got %#x\n", ptrs[j][0] );
+            ret = HeapValidate( GetProcessHeap(), 0, ptrs[j] );
+            ok( ret, "HeapValidate failed\n" );
+        }
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        if (!ptrs[i]) continue;
+        ret = HeapFree( GetProcessHeap(), 0, ptrs[i] );
+        ok( ret, "HeapFree failed, error %lu\n", GetLastError() );
+    }
+
+    ret = HeapValidate( GetProcessHeap(), 0, NULL );
+    ok( ret, "HeapValidate failed\n" );
+}
+
+static void test_heap_statistics(void)
+{
+    HEAP_WINE_STATISTICS *stats;
+    ULONG i, lfh_used = 0;
+    BYTE *ptrs[0x40], *large;
+    SIZE_T size;
+    HANDLE heap;
+    BOOL ret;
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( !!heap, "HeapCreate failed, error %lu\n", GetLastError() );
+
+    SetLastError( 0xdeadbeef );
+    size = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, 1000 /* HeapWineStatistics */, NULL, 0, &size );
+    if (!ret && GetLastError() == ERROR_INVALID_PARAMETER)
+    {
+        win_skip( "HeapWineStatistics not supported\n" );
+        HeapDestroy( heap );
+        return;
+    }
+    ok( !ret, "HeapQueryInformation succeeded\n" );
+    ok( GetLastError() == ERROR_INSUFFICIENT_BUFFER, "got error %lu\n", GetLastError() );
+    ok( size > offsetof( HEAP_WINE_STATISTICS, Bins[0] ), "got size %#Ix\n", size );
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++) ptrs[i] = pHeapAlloc( heap, 0, 0 );
+    large = pHeapAlloc( heap, 0, 0x100000 );
+    ok( !!large, "HeapAlloc failed, error %lu\n", GetLastError() );
+
+    stats = HeapAlloc( GetProcessHeap(), 0, size );
+    ret = pHeapQueryInformation( heap, 1000 /* HeapWineStatistics */, stats, size, &size );
+    ok( ret, "HeapQueryInformation failed, error %lu\n", GetLastError() );
+    ok( stats->BinCount > 0, "got BinCount %lu\n", stats->BinCount );
+    ok( stats->SubheapCount == 1, "got SubheapCount %lu\n", stats->SubheapCount );
+    ok( stats->LargeCount == 1, "got LargeCount %lu\n", stats->LargeCount );
+    ok( stats->LargeSize == 0x100000, "got LargeSize %#Ix\n", stats->LargeSize );
+    ok( stats->CommittedSize <= stats->ReservedSize, "got CommittedSize %#Ix, ReservedSize %#Ix\n",
+        stats->CommittedSize, stats->ReservedSize );
+    ok( stats->LargestFreeSize <= stats->FreeSize, "got LargestFreeSize %#Ix, FreeSize %#Ix\n",
+        stats->LargestFreeSize, stats->FreeSize );
+    ok( stats->Bins[0].LfhEnabled, "LFH not enabled\n" );
+    for (i = 0; i < stats->BinCount; i++) lfh_used += stats->Bins[i].LfhUsedCount;
+    ok( lfh_used >= ARRAY_SIZE(ptrs) - 0x20, "got %lu LFH used blocks\n", lfh_used );
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++) HeapFree( heap, 0, ptrs[i] );
+    HeapFree( heap, 0, large );
+
+    ret = pHeapQueryInformation( heap, 1000 /* HeapWineStatistics */, stats, size, &size );
+    ok( ret, "HeapQueryInformation failed, error %lu\n", GetLastError() );
+    ok( stats->LargeCount == 0, "got LargeCount %lu\n", stats->LargeCount );
+    for (i = 0, lfh_used = 0; i < stats->BinCount; i++) lfh_used += stats->Bins[i].LfhUsedCount;
+    ok( lfh_used == 0, "got %lu LFH used blocks\n", lfh_used );
+
+    HeapFree( GetProcessHeap(), 0, stats );
+    HeapDestroy( heap );
+}
+
 
 static void test_HeapCreate(void)
 {
@@ -3755,6 +3884,8 @@ START_TEST(heap)
     }
 
     test_HeapCreate();
+    test_process_heap_threads();
+    test_heap_statistics();
     test_GlobalAlloc();
     test_LocalAlloc();
 
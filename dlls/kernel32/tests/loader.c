@@ -2413,6 +2413,231 @@ static void test_import_resolution(void)
     }
 }
 
+static void test_bound_imports(void)
+{
+    char exp_name[MAX_PATH], imp_name[MAX_PATH];
+    const char *basename;
+    IMAGE_NT_HEADERS nt;
+    IMAGE_SECTION_HEADER sec;
+    HMODULE exp_mod, imp_mod;
+    void *reserved, *expect;
+    struct exports
+    {
+        IMAGE_EXPORT_DIRECTORY dir;
+        DWORD functions[1];
+        DWORD names[1];
+        WORD name_ords[1];
+        char name[16];
+        DWORD value;
+        struct
+        {
+            IMAGE_BASE_RELOCATION reloc;
+            USHORT type_off[2];
+        } rel;
+    } exp_data;
+    struct imports
+    {
+        IMAGE_IMPORT_DESCRIPTOR descr[2];
+        IMAGE_THUNK_DATA original_thunks[2];
+        IMAGE_THUNK_DATA thunks[2];
+        struct { WORD hint; char name[16]; } function;
+        char module[MAX_PATH];
+    } imp_data, *ptr;
+
+#define EXP_RVA(ptr) (page_size + ((char *)(ptr) - (char *)&exp_data))
+#define IMP_RVA(ptr) (page_size + ((char *)(ptr) - (char *)&imp_data))
+
+    /* occupy the preferred base of the exporting dll to force its relocation */
+    reserved = VirtualAlloc( NULL, 2 * page_size, MEM_RESERVE, PAGE_NOACCESS );
+    ok( reserved != NULL, "VirtualAlloc failed err %lu\n", GetLastError() );
+
+    nt = nt_header_template;
+    nt.FileHeader.TimeDateStamp = 0x12345678;
+    nt.OptionalHeader.ImageBase = (ULONG_PTR)reserved;
+    nt.OptionalHeader.SectionAlignment = page_size;
+    nt.OptionalHeader.FileAlignment = 0x200;
+    nt.OptionalHeader.SizeOfImage = 2 * page_size;
+    nt.OptionalHeader.SizeOfHeaders = nt.OptionalHeader.FileAlignment;
+
+    memset( &exp_data, 0, sizeof(exp_data) );
+    exp_data.dir.Name = EXP_RVA( exp_data.name );
+    exp_data.dir.Base = 1;
+    exp_data.dir.NumberOfFunctions = 1;
+    exp_data.dir.NumberOfNames = 1;
+    exp_data.dir.AddressOfFunctions = EXP_RVA( exp_data.functions );
+    exp_data.dir.AddressOfNames = EXP_RVA( exp_data.names );
+    exp_data.dir.AddressOfNameOrdinals = EXP_RVA( exp_data.name_ords );
+    exp_data.functions[0] = EXP_RVA( &exp_data.value );
+    exp_data.names[0] = EXP_RVA( exp_data.name );
+    strcpy( exp_data.name, "bound_value" );
+    exp_data.rel.reloc.VirtualAddress = page_size;
+    exp_data.rel.reloc.SizeOfBlock = sizeof(exp_data.rel);
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress = EXP_RVA( &exp_data.dir );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size = sizeof(exp_data.dir);
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress = EXP_RVA( &exp_data.rel );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size = sizeof(exp_data.rel);
+
+    memset( &sec, 0, sizeof(sec) );
+    memcpy( sec.Name, ".data", sizeof(".data") );
+    sec.PointerToRawData = nt.OptionalHeader.FileAlignment;
+    sec.VirtualAddress = nt.OptionalHeader.SectionAlignment;
+    sec.Misc.VirtualSize = sizeof(exp_data);
+    sec.SizeOfRawData = sizeof(exp_data);
+    sec.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ;
+    create_test_dll_sections( &dos_header, &nt, &sec, &exp_data, exp_name );
+
+    exp_mod = LoadLibraryA( exp_name );
+    ok( exp_mod != NULL, "failed to load err %lu\n", GetLastError() );
+    if (!exp_mod) goto done;
+    ok( exp_mod != reserved, "dll loaded at its preferred base %p\n", exp_mod );
+    expect = GetProcAddress( exp_mod, "bound_value" );
+    ok( expect == (char *)exp_mod + EXP_RVA( &exp_data.value ), "got %p\n", expect );
+
+    /* old style binding of the import address table to the preferred base of the exporting dll */
+    basename = strrchr( exp_name, '\\' ) + 1;
+    nt.OptionalHeader.ImageBase = nt_header_template.OptionalHeader.ImageBase;
+    memset( nt.OptionalHeader.DataDirectory, 0, sizeof(nt.OptionalHeader.DataDirectory) );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = IMP_RVA( imp_data.descr );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size = sizeof(imp_data.descr);
+
+    memset( &imp_data, 0, sizeof(imp_data) );
+    imp_data.descr[0].OriginalFirstThunk = IMP_RVA( imp_data.original_thunks );
+    imp_data.descr[0].TimeDateStamp = nt.FileHeader.TimeDateStamp;
+    imp_data.descr[0].ForwarderChain = ~0u;
+    imp_data.descr[0].Name = IMP_RVA( imp_data.module );
+    imp_data.descr[0].FirstThunk = IMP_RVA( imp_data.thunks );
+    imp_data.original_thunks[0].u1.AddressOfData = IMP_RVA( &imp_data.function );
+    imp_data.thunks[0].u1.Function = (ULONG_PTR)reserved + EXP_RVA( &exp_data.value );
+    strcpy( imp_data.function.name, "bound_value" );
+    strcpy( imp_data.module, basename );
+
+    sec.Misc.VirtualSize = sizeof(imp_data);
+    sec.SizeOfRawData = sizeof(imp_data);
+    sec.Characteristics |= IMAGE_SCN_MEM_WRITE;
+    create_test_dll_sections( &dos_header, &nt, &sec, &imp_data, imp_name );
+
+    imp_mod = LoadLibraryExA( imp_name, 0, LOAD_WITH_ALTERED_SEARCH_PATH );
+    ok( imp_mod != NULL, "failed to load err %lu\n", GetLastError() );
+    if (imp_mod)
+    {
+        ptr = (struct imports *)((char *)imp_mod + page_size);
+        ok( (void *)ptr->thunks[0].u1.Function == expect, "thunk %p instead of %p\n",
+            (void *)ptr->thunks[0].u1.Function, expect );
+        FreeLibrary( imp_mod );
+    }
+    DeleteFileA( imp_name );
+    FreeLibrary( exp_mod );
+done:
+    DeleteFileA( exp_name );
+    VirtualFree( reserved, 0, MEM_RELEASE );
+#undef EXP_RVA
+#undef IMP_RVA
+}
+
+struct reloc_data
+{
+    ULONG_PTR ptr;
+    DWORD     value;
+    struct
+    {
+        IMAGE_BASE_RELOCATION reloc;
+        USHORT type_off[2];
+    } rel;
+};
+
+static void check_relocated_image( HMODULE mod )
+{
+    const struct reloc_data *data = (const struct reloc_data *)((char *)mod + page_size);
+    const IMAGE_NT_HEADERS *nt = pRtlImageNtHeader( mod );
+
+    ok( (HMODULE)nt->OptionalHeader.ImageBase == mod, "image base %p instead of %p\n",
+        (void *)nt->OptionalHeader.ImageBase, mod );
+    ok( (const DWORD *)data->ptr == &data->value, "pointer %p instead of %p\n", (void *)data->ptr, &data->value );
+    ok( data->value == 0x12345678, "got value %#lx\n", data->value );
+}
+
+static void test_relocated_image_child( const char *dll_name, const char *base )
+{
+    HMODULE mod, expect;
+
+    sscanf( base, "%p", &expect );
+    mod = LoadLibraryA( dll_name );
+    ok( mod != NULL, "failed to load err %lu\n", GetLastError() );
+    if (!mod) return;
+    ok( mod == expect, "loaded at %p instead of %p\n", mod, expect );
+    check_relocated_image( mod );
+    FreeLibrary( mod );
+}
+
+static void test_relocated_image(void)
+{
+    char dll_name[MAX_PATH], cmdline[MAX_PATH * 2];
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    IMAGE_NT_HEADERS nt;
+    IMAGE_SECTION_HEADER sec;
+    struct reloc_data data;
+    HMODULE mod;
+    char **argv;
+    BOOL ret;
+
+#define DATA_RVA(ptr) (page_size + ((char *)(ptr) - (char *)&data))
+    nt = nt_header_template;
+    nt.OptionalHeader.SectionAlignment = page_size;
+    nt.OptionalHeader.FileAlignment = 0x200;
+    nt.OptionalHeader.SizeOfImage = 2 * page_size;
+    nt.OptionalHeader.SizeOfHeaders = nt.OptionalHeader.FileAlignment;
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].VirtualAddress = DATA_RVA( &data.rel );
+    nt.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC].Size = sizeof(data.rel);
+
+    memset( &data, 0, sizeof(data) );
+    data.ptr = nt.OptionalHeader.ImageBase + DATA_RVA( &data.value );
+    data.value = 0x12345678;
+    data.rel.reloc.VirtualAddress = page_size;
+    data.rel.reloc.SizeOfBlock = sizeof(data.rel);
+#ifdef _WIN64
+    data.rel.type_off[0] = (IMAGE_REL_BASED_DIR64 << 12) + offsetof( struct reloc_data, ptr );
+#else
+    data.rel.type_off[0] = (IMAGE_REL_BASED_HIGHLOW << 12) + offsetof( struct reloc_data, ptr );
+#endif
+
+    memset( &sec, 0, sizeof(sec) );
+    memcpy( sec.Name, ".data", sizeof(".data") );
+    sec.PointerToRawData = nt.OptionalHeader.FileAlignment;
+    sec.VirtualAddress = nt.OptionalHeader.SectionAlignment;
+    sec.Misc.VirtualSize = sizeof(data);
+    sec.SizeOfRawData = sizeof(data);
+    sec.Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ;
+    create_test_dll_sections( &dos_header, &nt, &sec, &data, dll_name );
+#undef DATA_RVA
+
+    mod = LoadLibraryA( dll_name );
+    ok( mod != NULL, "failed to load err %lu\n", GetLastError() );
+    if (!mod) goto done;
+    if (mod == (HMODULE)nt_header_template.OptionalHeader.ImageBase)
+    {
+        skip( "dll not relocated\n" );
+        FreeLibrary( mod );
+        goto done;
+    }
+    check_relocated_image( mod );
+
+    /* the relocated image is shared with other processes mapping it at the same address */
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" loader relocated_image %s %p", argv[0], dll_name, mod );
+    ret = CreateProcessA( argv[0], cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    ok( ret, "CreateProcess(%s) error %lu\n", cmdline, GetLastError() );
+    if (ret)
+    {
+        wait_child_process( pi.hProcess );
+        CloseHandle( pi.hThread );
+        CloseHandle( pi.hProcess );
+    }
+    FreeLibrary( mod );
+done:
+    DeleteFileA( dll_name );
+}
+
 static HANDLE gen_forward_chain_testdll( char testdll_path[MAX_PATH],
                                          const char source_dll[MAX_PATH],
                                          BOOL is_export, BOOL is_import,
@@ -4798,6 +5023,11 @@ START_TEST(loader)
         *child_failures = -1;
 
     argc = winetest_get_mainargs(&argv);
+    if (argc > 4 && !strcmp( argv[2], "relocated_image" ))
+    {
+        test_relocated_image_child( argv[3], argv[4] );
+        return;
+    }
     if (argc > 4)
     {
         test_dll_phase = atoi(argv[4]);
@@ -4818,6 +5048,8 @@ START_TEST(loader)
     test_ImportDescriptors();
     test_section_access();
     test_import_resolution();
+    test_bound_imports();
+    test_relocated_image();
     test_export_forwarder_dep_chain();
     test_ExitProcess();
     test_InMemoryOrderModuleList();
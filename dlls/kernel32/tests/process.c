@@ -4336,7 +4336,9 @@ static void test_GetSystemCpuSetInformation(void)
 
 static void test_largepages(void)
 {
-    SIZE_T size;
+    MEMORY_BASIC_INFORMATION info;
+    SIZE_T size, ret;
+    char *ptr;
 
     if (!pGetLargePageMinimum) {
         win_skip("No GetLargePageMinimum support.\n");
@@ -4344,7 +4346,43 @@ static void test_largepages(void)
     }
     size = pGetLargePageMinimum();
 
+#if defined(__i386__) || defined(__arm__)
     ok((size == 0) || (size == 2*1024*1024) || (size == 4*1024*1024), "GetLargePageMinimum reports %Id size\n", size);
+#else
+    ok((size == 0) || (size == 2*1024*1024), "GetLargePageMinimum reports %Id size\n", size);
+#endif
+    if (!size)
+    {
+        skip("Large pages not supported.\n");
+        return;
+    }
+
+    SetLastError(0xdeadbeef);
+    ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!ptr, "VirtualAlloc succeeded without MEM_COMMIT\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER || broken(GetLastError() == ERROR_PRIVILEGE_NOT_HELD),
+       "got error %lu\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    ptr = VirtualAlloc(NULL, size + 0x1000, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(!ptr, "VirtualAlloc succeeded with a misaligned size\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER || broken(GetLastError() == ERROR_PRIVILEGE_NOT_HELD),
+       "got error %lu\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    ok(ptr != NULL || broken(GetLastError() == ERROR_PRIVILEGE_NOT_HELD) /* needs SeLockMemoryPrivilege */,
+       "VirtualAlloc failed, error %lu\n", GetLastError());
+    if (!ptr) return;
+    ok(!((ULONG_PTR)ptr & (size - 1)), "got misaligned address %p\n", ptr);
+    ptr[0] = ptr[size - 1] = 1;
+    ret = VirtualQuery(ptr, &info, sizeof(info));
+    ok(ret == sizeof(info), "VirtualQuery failed\n");
+    ok(info.RegionSize == size, "got size %Ix\n", info.RegionSize);
+    ok(info.State == MEM_COMMIT, "got state %lx\n", info.State);
+    ok(info.Protect == PAGE_READWRITE, "got protect %lx\n", info.Protect);
+    ret = VirtualFree(ptr, 0, MEM_RELEASE);
+    ok(ret, "VirtualFree failed, error %lu\n", GetLastError());
 }
 
 struct proc_thread_attr
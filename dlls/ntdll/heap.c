@@ -37,6 +37,8 @@
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(heap);
+WINE_DECLARE_DEBUG_CHANNEL(heapstats);
+WINE_DECLARE_DEBUG_CHANNEL(heapprof);
 
 /* HeapCompatibilityInformation values */
 
@@ -1890,6 +1892,51 @@ static NTSTATUS heap_release_bin_group( struct heap *heap, ULONG flags, struct b
     return group_release( heap, flags, bin, group );
 }
 
+/* per-thread cache of freed blocks for the smallest bins of the process heap, the cached blocks
+ * are marked as free but their group free bit is kept clear so that only the owning thread may
+ * use them again, without any interlocked operation.
+ */
+#define THREAD_CACHE_BIN_COUNT  0x20
+#define THREAD_CACHE_DEPTH      8
+
+struct thread_cache
+{
+    struct block *blocks[THREAD_CACHE_BIN_COUNT][THREAD_CACHE_DEPTH];
+    UINT count[THREAD_CACHE_BIN_COUNT];
+};
+
+#define THREAD_CACHE_DETACHED ((struct thread_cache *)~(UINT_PTR)0)
+
+static struct block *thread_cache_pop( struct heap *heap, struct bin *bin )
+{
+    struct thread_cache *cache;
+    UINT index = bin - heap->bins;
+
+    if (heap != process_heap || index >= THREAD_CACHE_BIN_COUNT) return NULL;
+    if (!(cache = NtCurrentTeb()->ReservedForPerf) || cache == THREAD_CACHE_DETACHED) return NULL;
+    if (!cache->count[index]) return NULL;
+    return cache->blocks[index][--cache->count[index]];
+}
+
+static BOOL thread_cache_push( struct heap *heap, struct bin *bin, struct block *block )
+{
+    struct thread_cache *cache;
+    UINT index = bin - heap->bins;
+
+    if (heap != process_heap || index >= THREAD_CACHE_BIN_COUNT) return FALSE;
+    if ((cache = NtCurrentTeb()->ReservedForPerf) == THREAD_CACHE_DETACHED) return FALSE;
+    if (!cache)
+    {
+        /* the cache is larger than the cached bins block size, this will not recurse */
+        if (!(cache = RtlAllocateHeap( heap, HEAP_ZERO_MEMORY, sizeof(*cache) ))) return FALSE;
+        NtCurrentTeb()->ReservedForPerf = cache;
+    }
+
+    if (cache->count[index] == THREAD_CACHE_DEPTH) return FALSE;
+    cache->blocks[index][cache->count[index]++] = block;
+    return TRUE;
+}
+
 static struct block *find_free_bin_block( struct heap *heap, ULONG flags, SIZE_T block_size, struct bin *bin )
 {
     ULONG affinity = heap_current_thread_affinity();
@@ -1929,7 +1976,7 @@ static NTSTATUS heap_allocate_block_lfh( struct heap *heap, ULONG flags, SIZE_T
 
     block_size = BLOCK_BIN_SIZE( BLOCK_SIZE_BIN( block_size ) );
 
-    if ((block = find_free_bin_block( heap, flags, block_size, bin )))
+    if ((block = thread_cache_pop( heap, bin )) || (block = find_free_bin_block( heap, flags, block_size, bin )))
     {
         block_set_type( block, BLOCK_TYPE_USED );
         block_set_flags( block, (BYTE)~BLOCK_FLAG_LFH, BLOCK_USER_FLAGS( flags ) );
@@ -1942,33 +1989,41 @@ static NTSTATUS heap_allocate_block_lfh( struct heap *heap, ULONG flags, SIZE_T
     return block ? STATUS_SUCCESS : STATUS_NO_MEMORY;
 }
 
-static NTSTATUS heap_free_block_lfh( struct heap *heap, ULONG flags, struct block *block )
+/* release a free block to its group, the block must already be marked as free */
+static NTSTATUS group_free_block( struct heap *heap, ULONG flags, struct bin *bin, struct block *block )
 {
-    struct bin *bin, *last = heap->bins + BLOCK_SIZE_BIN_COUNT - 1;
-    SIZE_T i, block_size = block_get_size( block );
     struct group *group = block_get_group( block );
+    SIZE_T i = block_get_group_index( block );
     NTSTATUS status = STATUS_SUCCESS;
 
+    /* if this was the last used block in a group and GROUP_FLAG_FREE was set */
+    if (InterlockedOr( &group->free_bits, 1 << i ) == ~(1 << i))
+    {
+        /* thread now owns the group, and can release it to its bin */
+        group->free_bits = ~GROUP_FLAG_FREE;
+        status = heap_release_bin_group( heap, flags, bin, group );
+    }
+
+    return status;
+}
+
+static NTSTATUS heap_free_block_lfh( struct heap *heap, ULONG flags, struct block *block )
+{
+    struct bin *bin, *last = heap->bins + BLOCK_SIZE_BIN_COUNT - 1;
+    SIZE_T block_size = block_get_size( block );
+
     if (!(block_get_flags( block ) & BLOCK_FLAG_LFH)) return STATUS_UNSUCCESSFUL;
 
     bin = heap->bins + BLOCK_SIZE_BIN( block_size );
     if (bin == last) return STATUS_UNSUCCESSFUL;
 
-    i = block_get_group_index( block );
     valgrind_make_writable( block, sizeof(*block) );
     block_set_type( block, BLOCK_TYPE_FREE );
     block_set_flags( block, (BYTE)~BLOCK_FLAG_LFH, BLOCK_FLAG_FREE );
     mark_block_free( block + 1, (char *)block + block_size - (char *)(block + 1), flags );
 
-    /* if this was the last used block in a group and GROUP_FLAG_FREE was set */
-    if (InterlockedOr( &group->free_bits, 1 << i ) == ~(1 << i))
-    {
-        /* thread now owns the group, and can release it to its bin */
-        group->free_bits = ~GROUP_FLAG_FREE;
-        status = heap_release_bin_group( heap, flags, bin, group );
-    }
-
-    return status;
+    if (thread_cache_push( heap, bin, block )) return STATUS_SUCCESS;
+    return group_free_block( heap, flags, bin, block );
 }
 
 static void bin_try_enable( struct heap *heap, struct bin *bin )
@@ -2015,10 +2070,31 @@ static void heap_thread_detach_bin_groups( struct heap *heap )
     }
 }
 
+static void heap_thread_detach_cache(void)
+{
+    struct thread_cache *cache = NtCurrentTeb()->ReservedForPerf;
+    UINT i;
+
+    /* blocks freed after this point go directly to their group */
+    NtCurrentTeb()->ReservedForPerf = THREAD_CACHE_DETACHED;
+    if (!cache || cache == THREAD_CACHE_DETACHED) return;
+
+    for (i = 0; i < THREAD_CACHE_BIN_COUNT; ++i)
+    {
+        while (cache->count[i])
+            group_free_block( process_heap, process_heap->flags, process_heap->bins + i,
+                              cache->blocks[i][--cache->count[i]] );
+    }
+
+    RtlFreeHeap( process_heap, 0, cache );
+}
+
 void heap_thread_detach(void)
 {
     struct heap *heap;
 
+    heap_thread_detach_cache();
+
     RtlEnterCriticalSection( &process_heap->cs );
 
     LIST_FOR_EACH_ENTRY( heap, &process_heap->entry, struct heap, entry )
@@ -2029,6 +2105,172 @@ void heap_thread_detach(void)
     RtlLeaveCriticalSection( &process_heap->cs );
 }
 
+static void group_get_statistics( const struct block *block, HEAP_WINE_STATISTICS *stats )
+{
+    const struct group *group = (const struct group *)(block + 1);
+    ULONG bin = BLOCK_SIZE_BIN( block_get_size( &group->first_block ) ), free_count = 0;
+    ULONG free_bits = ReadNoFence( &group->free_bits ) & ~GROUP_FLAG_FREE;
+
+    if (bin >= stats->BinCount) return;
+    for (; free_bits; free_bits &= free_bits - 1) free_count++;
+
+    stats->Bins[bin].LfhGroupCount++;
+    stats->Bins[bin].LfhUsedCount += GROUP_BLOCK_COUNT - free_count;
+    stats->Bins[bin].LfhFreeCount += free_count;
+}
+
+/* collect the heap statistics, the heap must be locked */
+static void heap_get_statistics( const struct heap *heap, HEAP_WINE_STATISTICS *stats, ULONG bin_count )
+{
+    const ARENA_LARGE *large;
+    const struct block *block;
+    const SUBHEAP *subheap;
+    ULONG i;
+
+    memset( stats, 0, offsetof( HEAP_WINE_STATISTICS, Bins[bin_count] ) );
+    stats->BinCount = bin_count;
+
+    for (i = 0; i < bin_count; i++)
+    {
+        const struct bin *bin = heap->bins + i;
+        stats->Bins[i].BlockSize = BLOCK_BIN_SIZE( i );
+        stats->Bins[i].AllocCount = ReadNoFence( &bin->count_alloc );
+        stats->Bins[i].FreeCount = ReadNoFence( &bin->count_freed );
+        stats->Bins[i].LfhEnabled = ReadNoFence( &bin->enabled );
+    }
+
+    LIST_FOR_EACH_ENTRY( subheap, &heap->subheap_list, SUBHEAP, entry )
+    {
+        const char *base = subheap_base( subheap );
+
+        stats->SubheapCount++;
+        stats->ReservedSize += subheap_size( subheap );
+        stats->CommittedSize += (const char *)subheap_commit_end( subheap ) - base;
+        stats->OverheadSize += subheap_overhead( subheap );
+
+        for (block = first_block( subheap ); block; block = next_block( subheap, block ))
+        {
+            SIZE_T size = block_get_size( block ) - block_get_overhead( block );
+
+            stats->OverheadSize += block_get_overhead( block );
+            if (block_get_flags( block ) & BLOCK_FLAG_FREE)
+            {
+                stats->FreeCount++;
+                stats->FreeSize += size;
+                stats->LargestFreeSize = max( stats->LargestFreeSize, size );
+            }
+            else
+            {
+                stats->UsedCount++;
+                stats->UsedSize += size;
+                if (block_get_flags( block ) & BLOCK_FLAG_LFH) group_get_statistics( block, stats );
+            }
+        }
+    }
+
+    LIST_FOR_EACH_ENTRY( large, &heap->large_list, ARENA_LARGE, entry )
+    {
+        stats->LargeCount++;
+        stats->LargeSize += large->data_size;
+        stats->ReservedSize += large->block_size;
+        stats->CommittedSize += large->block_size;
+        if (block_get_flags( &large->block ) & BLOCK_FLAG_LFH) group_get_statistics( &large->block, stats );
+    }
+}
+
+#define HEAP_STATS_INTERVAL 10000 /* ms between two statistics traces */
+
+static LONG heap_stats_time;
+
+static void heap_trace_statistics( const struct heap *heap )
+{
+    union
+    {
+        HEAP_WINE_STATISTICS stats;
+        char buffer[offsetof( HEAP_WINE_STATISTICS, Bins[BLOCK_SIZE_BIN_COUNT] )];
+    } info;
+    HEAP_WINE_STATISTICS *stats = &info.stats;
+    ULONG i;
+
+    heap_get_statistics( heap, stats, heap->bins ? BLOCK_SIZE_BIN_COUNT : 0 );
+
+    TRACE_(heapstats)( "heap %p: reserved %#Ix, committed %#Ix, used %#Ix (%lu blocks), free %#Ix (%lu blocks, "
+                       "largest %#Ix), overhead %#Ix, large %#Ix (%lu blocks)\n", heap, stats->ReservedSize,
+                       stats->CommittedSize, stats->UsedSize, stats->UsedCount, stats->FreeSize, stats->FreeCount,
+                       stats->LargestFreeSize, stats->OverheadSize, stats->LargeSize, stats->LargeCount );
+
+    for (i = 0; i < stats->BinCount; i++)
+    {
+        const HEAP_WINE_BIN_STATISTICS *bin = stats->Bins + i;
+        if (!bin->AllocCount && !bin->FreeCount && !bin->LfhGroupCount) continue;
+        TRACE_(heapstats)( "heap %p:   size %#6Ix, alloc %lu, freed %lu, lfh %lu, groups %lu, used %lu, free %lu\n",
+                           heap, bin->BlockSize, bin->AllocCount, bin->FreeCount, bin->LfhEnabled,
+                           bin->LfhGroupCount, bin->LfhUsedCount, bin->LfhFreeCount );
+    }
+}
+
+/* periodically trace the statistics of every heap, heaps locked by other threads are skipped */
+static void heap_trace_all_statistics(void)
+{
+    LONG now = NtGetTickCount(), last = ReadNoFence( &heap_stats_time );
+    struct heap *heap;
+
+    if (now - last < HEAP_STATS_INTERVAL) return;
+    if (InterlockedCompareExchange( &heap_stats_time, now, last ) != last) return;
+
+    RtlEnterCriticalSection( &process_heap->cs );
+
+    heap_trace_statistics( process_heap );
+
+    LIST_FOR_EACH_ENTRY( heap, &process_heap->entry, struct heap, entry )
+    {
+        if (heap->flags & HEAP_NO_SERIALIZE) continue;
+        if (!RtlTryEnterCriticalSection( &heap->cs )) continue;
+        heap_trace_statistics( heap );
+        RtlLeaveCriticalSection( &heap->cs );
+    }
+
+    RtlLeaveCriticalSection( &process_heap->cs );
+}
+
+#define HEAP_PROF_DEFAULT_INTERVAL 1000 /* default number of allocations between two samples */
+#define HEAP_PROF_MAX_FRAMES       16
+
+static ULONG heap_prof_interval = HEAP_PROF_DEFAULT_INTERVAL;
+static LONG heap_prof_count;
+
+/***********************************************************************
+ *           heap_init_profiling
+ *
+ * Reads the allocation sampling interval, once the environment is available.
+ */
+void heap_init_profiling(void)
+{
+    UNICODE_STRING name = RTL_CONSTANT_STRING( L"WINEHEAPPROF" ), value;
+    WCHAR buffer[16];
+    ULONG interval;
+
+    value.Buffer = buffer;
+    value.MaximumLength = sizeof(buffer);
+    if (RtlQueryEnvironmentVariable_U( NULL, &name, &value )) return;
+    if (RtlUnicodeStringToInteger( &value, 10, &interval )) return;
+    heap_prof_interval = max( interval, 1 );
+}
+
+/* trace the call stack of one allocation every WINEHEAPPROF allocations */
+static void heap_prof_sample( const struct heap *heap, void *ptr, SIZE_T size )
+{
+    void *frames[HEAP_PROF_MAX_FRAMES];
+    ULONG i, count;
+
+    if ((ULONG)InterlockedIncrement( &heap_prof_count ) % heap_prof_interval) return;
+
+    count = RtlCaptureStackBackTrace( 2, ARRAY_SIZE(frames), frames, NULL );
+    TRACE_(heapprof)( "heap %p, ptr %p, size %#Ix, stack", heap, ptr, size );
+    for (i = 0; i < count; i++) TRACE_(heapprof)( " %p", frames[i] );
+    TRACE_(heapprof)( "\n" );
+}
+
 /***********************************************************************
  *           RtlAllocateHeap   (NTDLL.@)
  */
@@ -2059,9 +2301,12 @@ void *WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE handle, ULONG flags, SIZE
             InterlockedIncrement( &heap->bins[bin].count_alloc );
             if (!ReadNoFence( &heap->bins[bin].enabled )) bin_try_enable( heap, &heap->bins[bin] );
         }
+
+        if (TRACE_ON(heapstats)) heap_trace_all_statistics();
     }
 
     if (!status) valgrind_notify_alloc( ptr, size, flags & HEAP_ZERO_MEMORY );
+    if (!status && TRACE_ON(heapprof)) heap_prof_sample( heap, ptr, size );
 
     TRACE( "handle %p, flags %#lx, size %#Ix, return %p, status %#lx.\n", handle, flags, size, ptr, status );
     heap_set_status( heap, flags, status );
@@ -2569,6 +2814,23 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS i
         *(ULONG *)info = ReadNoFence( &heap->compat_info );
         return STATUS_SUCCESS;
 
+    case HeapWineStatistics:
+    {
+        ULONG bin_count;
+        SIZE_T size;
+
+        if (!(heap = unsafe_heap_from_handle( handle, 0, &flags ))) return STATUS_ACCESS_VIOLATION;
+        bin_count = heap->bins ? BLOCK_SIZE_BIN_COUNT : 0;
+        size = offsetof( HEAP_WINE_STATISTICS, Bins[bin_count] );
+        if (size_out) *size_out = size;
+        if (size_in < size) return STATUS_BUFFER_TOO_SMALL;
+
+        heap_lock( heap, flags );
+        heap_get_statistics( heap, info, bin_count );
+        heap_unlock( heap, flags );
+        return STATUS_SUCCESS;
+    }
+
     default:
         FIXME( "HEAP_INFORMATION_CLASS %u not implemented!\n", info_class );
         return STATUS_INVALID_INFO_CLASS;
@@ -43,6 +43,7 @@ WINE_DECLARE_DEBUG_CHANNEL(relay);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
+WINE_DECLARE_DEBUG_CHANNEL(loadtime);
 
 #ifdef _WIN64
 #define DEFAULT_SECURITY_COOKIE_64  (((ULONGLONG)0x00002b99 << 32) | 0x2ddfa232)
@@ -89,6 +90,7 @@ static const WCHAR system_path[] = L"C:\\windows\\system32;C:\\windows\\system;C
 
 static BOOL is_prefix_bootstrap;  /* are we bootstrapping the prefix? */
 static BOOL imports_fixup_done = FALSE;  /* set once the imports have been fixed up, before attaching them */
+static unsigned int nb_imported_funcs, nb_bound_funcs;  /* import statistics for +loadtime */
 static BOOL process_detaching = FALSE;  /* set on process detach to avoid deadlocks with thread detach */
 static int free_lib_count;   /* recursion depth of LdrUnloadDll calls */
 static LONG path_safe_mode;  /* path mode set by RtlSetSearchPathMode */
@@ -1080,6 +1082,45 @@ void * WINAPI RtlFindExportedRoutineByName( HMODULE module, const char *name )
 }
 
 
+/*************************************************************************
+ *		is_import_bound
+ *
+ * Check whether the import address table of a descriptor was bound to the
+ * imported module at link time, and whether the binding is still valid.
+ */
+static BOOL is_import_bound( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr,
+                             const char *name, const WINE_MODREF *imp )
+{
+    const IMAGE_NT_HEADERS *nt = RtlImageNtHeader( imp->ldr.DllBase );
+    const IMAGE_BOUND_IMPORT_DESCRIPTOR *start, *bound;
+    DWORD timestamp = descr->TimeDateStamp;
+    ULONG size;
+
+    if (!timestamp || !descr->OriginalFirstThunk) return FALSE;
+    if (TRACE_ON(relay) || TRACE_ON(snoop)) return FALSE;
+    /* the bound addresses are only valid if the module is at its preferred base */
+    if (imp->ldr.Flags & LDR_IMAGE_NOT_AT_BASE) return FALSE;
+
+    if (timestamp == ~0u)  /* new style binding, look for the module in the bound imports directory */
+    {
+        if (!(start = RtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT, &size )))
+            return FALSE;
+        for (bound = start; (const char *)(bound + 1) <= (const char *)start + size && bound->OffsetModuleName;
+             bound += bound->NumberOfModuleForwarderRefs + 1)
+        {
+            if (_stricmp( (const char *)start + bound->OffsetModuleName, name )) continue;
+            /* forwarded exports would need their target modules checked too */
+            if (bound->NumberOfModuleForwarderRefs) return FALSE;
+            return bound->TimeDateStamp == nt->FileHeader.TimeDateStamp;
+        }
+        return FALSE;
+    }
+    /* old style binding, the forwarder chain lists the entries that still need resolving */
+    if (descr->ForwarderChain != ~0u) return FALSE;
+    return timestamp == nt->FileHeader.TimeDateStamp;
+}
+
+
 /*************************************************************************
  *		import_dll
  *
@@ -1134,12 +1175,23 @@ static BOOL import_dll( WINE_MODREF *wm, const IMAGE_IMPORT_DESCRIPTOR *descr, L
     /* unprotect the import address table since it can be located in
      * readonly section */
     while (import_list[protect_size].u1.Ordinal) protect_size++;
+    nb_imported_funcs += protect_size;
+
+    imp_mod = wmImp->ldr.DllBase;
+    if (is_import_bound( module, descr, name, wmImp ))
+    {
+        /* the import address table already contains the right addresses */
+        TRACE_(imports)( "--- %s imports bound to %p\n", name, imp_mod );
+        nb_bound_funcs += protect_size;
+        *pwm = wmImp;
+        return TRUE;
+    }
+
     protect_base = thunk_list;
     protect_size *= sizeof(*thunk_list);
     NtProtectVirtualMemory( NtCurrentProcess(), &protect_base,
                             &protect_size, PAGE_READWRITE, &protect_old );
 
-    imp_mod = wmImp->ldr.DllBase;
     exports = RtlImageDirectoryEntryToData( imp_mod, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size );
 
     if (!exports)
@@ -2214,9 +2266,12 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
     WINE_MODREF *wm;
     NTSTATUS status;
     SIZE_T map_size;
+    BOOL not_at_base;
 
     if (!(nt = RtlImageNtHeader( *module ))) return STATUS_INVALID_IMAGE_FORMAT;
 
+    /* dynamically relocated images have their ImageBase updated when mapped */
+    not_at_base = image_info->ImageDynamicallyRelocated || (ULONG_PTR)*module != nt->OptionalHeader.ImageBase;
     map_size = (nt->OptionalHeader.SizeOfImage + page_size - 1) & ~(page_size - 1);
     if ((status = perform_relocations( *module, nt, map_size ))) return status;
 
@@ -2230,6 +2285,7 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
     if (id) wm->id = *id;
     if (image_info->LoaderFlags) wm->ldr.Flags |= LDR_COR_IMAGE;
     if (image_info->ComPlusILOnly) wm->ldr.Flags |= LDR_COR_ILONLY;
+    if (not_at_base) wm->ldr.Flags |= LDR_IMAGE_NOT_AT_BASE;
     wm->system = system;
 
     update_load_config( *module );
@@ -4335,10 +4391,13 @@ void loader_init( CONTEXT *context, void **entry )
     static int attach_done;
     NTSTATUS status;
     ULONG_PTR cookie, port = 0;
+    LARGE_INTEGER start, imports_time, end, freq;
     WINE_MODREF *wm;
 
     if (process_detaching) NtTerminateThread( GetCurrentThread(), 0 );
 
+    if (TRACE_ON(loadtime)) NtQueryPerformanceCounter( &start, &freq );
+
     RtlEnterCriticalSection( &loader_section );
 
     if (!imports_fixup_done)
@@ -4369,6 +4428,7 @@ void loader_init( CONTEXT *context, void **entry )
             InitializeListHead( &hash_table[i] );
 
         init_user_process_params();
+        heap_init_profiling();
         load_global_options();
         version_init();
 
@@ -4411,6 +4471,7 @@ void loader_init( CONTEXT *context, void **entry )
             NtTerminateProcess( GetCurrentProcess(), status );
         }
         imports_fixup_done = TRUE;
+        if (TRACE_ON(loadtime)) NtQueryPerformanceCounter( &imports_time, NULL );
     }
     else
     {
@@ -4459,6 +4520,16 @@ void loader_init( CONTEXT *context, void **entry )
         if (wm->ldr.TlsIndex == -1) call_tls_callbacks( wm->ldr.DllBase, DLL_PROCESS_ATTACH );
         if (wm->ldr.ActivationContext) RtlDeactivateActivationContext( 0, cookie );
 
+        if (TRACE_ON(loadtime))
+        {
+            NtQueryPerformanceCounter( &end, NULL );
+            TRACE_(loadtime)( "%s: imports resolved in %lu ms (%u functions, %u bound), dlls initialized in %lu ms\n",
+                              debugstr_w(NtCurrentTeb()->Peb->ProcessParameters->ImagePathName.Buffer),
+                              (ULONG)((imports_time.QuadPart - start.QuadPart) * 1000 / freq.QuadPart),
+                              nb_imported_funcs, nb_bound_funcs,
+                              (ULONG)((end.QuadPart - imports_time.QuadPart) * 1000 / freq.QuadPart) );
+        }
+
         NtQueryInformationProcess( GetCurrentProcess(), ProcessDebugPort, &port, sizeof(port), NULL );
         if (port) process_breakpoint();
     }
@@ -1117,25 +1117,60 @@ PVOID WINAPI RtlDecodePointer( PVOID ptr )
     return (PVOID)(ptrval ^ get_pointer_obfuscator());
 }
 
+/* match finder shared by the LZ77 based compressors, using hash chains */
+struct lz_matcher
+{
+    const UCHAR *src;        /* source data */
+    ULONG        size;       /* size of the source data */
+    ULONG       *head;       /* most recent position + 1 for each hash value */
+    ULONG       *prev;       /* previous position + 1 with the same hash, indexed by position */
+    ULONG        hash_bits;  /* size of the head array in bits */
+    ULONG        window;     /* size of the prev array, a power of 2 */
+    ULONG        depth;      /* maximum number of positions to check for a match */
+};
+
+#define LZNT1_HASH_BITS       12
+#define LZNT1_WINDOW          0x1000
+#define XPRESS_HASH_BITS      13
+#define XPRESS_WINDOW         0x2000
+#define XPRESS_MAX_MATCH      (0xffff + 3)
+#define XPRESS_HUFF_HASH_BITS 15
+#define XPRESS_HUFF_WINDOW    0x10000
+#define XPRESS_HUFF_BLOCK     0x10000
+#define XPRESS_HUFF_SYMBOLS   512
+
+/* size of the workspace needed by the compressors: hash heads, hash chains and match tokens */
+static ULONG compress_workspace_size( USHORT format )
+{
+    switch (format & COMPRESSION_FORMAT_MASK)
+    {
+    case COMPRESSION_FORMAT_LZNT1:
+        return ((1 << LZNT1_HASH_BITS) + LZNT1_WINDOW) * sizeof(ULONG);
+    case COMPRESSION_FORMAT_XPRESS:
+        return ((1 << XPRESS_HASH_BITS) + XPRESS_WINDOW) * sizeof(ULONG);
+    case COMPRESSION_FORMAT_XPRESS_HUFF:
+        return ((1 << XPRESS_HUFF_HASH_BITS) + XPRESS_HUFF_WINDOW + XPRESS_HUFF_BLOCK) * sizeof(ULONG);
+    }
+    return 0;
+}
+
 /******************************************************************************
  *  RtlGetCompressionWorkSpaceSize		[NTDLL.@]
  */
 NTSTATUS WINAPI RtlGetCompressionWorkSpaceSize(USHORT format, PULONG compress_workspace,
                                                PULONG decompress_workspace)
 {
-    FIXME("0x%04x, %p, %p: semi-stub\n", format, compress_workspace, decompress_workspace);
+    TRACE("0x%04x, %p, %p\n", format, compress_workspace, decompress_workspace);
 
     switch (format & COMPRESSION_FORMAT_MASK)
     {
         case COMPRESSION_FORMAT_LZNT1:
+        case COMPRESSION_FORMAT_XPRESS:
+        case COMPRESSION_FORMAT_XPRESS_HUFF:
             if (compress_workspace)
-            {
-                /* FIXME: The current implementation of RtlCompressBuffer does not use a
-                 * workspace buffer, but Windows applications might expect a nonzero value. */
-                *compress_workspace = 16;
-            }
+                *compress_workspace = compress_workspace_size(format);
             if (decompress_workspace)
-                *decompress_workspace = 0x1000;
+                *decompress_workspace = (format & COMPRESSION_FORMAT_MASK) == COMPRESSION_FORMAT_LZNT1 ? 0x1000 : 0;
             return STATUS_SUCCESS;
 
         case COMPRESSION_FORMAT_NONE:
@@ -1148,29 +1183,146 @@ NTSTATUS WINAPI RtlGetCompressionWorkSpaceSize(USHORT format, PULONG compress_wo
     }
 }
 
-/* compress data using LZNT1, currently only a stub */
-static NTSTATUS lznt1_compress(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+static void lz_init( struct lz_matcher *matcher, const UCHAR *src, ULONG size, void *workspace,
+                     ULONG hash_bits, ULONG window, USHORT format )
+{
+    matcher->src       = src;
+    matcher->size      = size;
+    matcher->head      = workspace;
+    matcher->prev      = matcher->head + (1 << hash_bits);
+    matcher->hash_bits = hash_bits;
+    matcher->window    = window;
+    matcher->depth     = (format & COMPRESSION_ENGINE_MAXIMUM) ? 256 : 16;
+    memset( matcher->head, 0, (1 << hash_bits) * sizeof(ULONG) );
+}
+
+static inline ULONG lz_hash( const struct lz_matcher *matcher, ULONG pos )
+{
+    const UCHAR *p = matcher->src + pos;
+    return ((p[0] | (p[1] << 8) | (p[2] << 16)) * 0x9e3779b1) >> (32 - matcher->hash_bits);
+}
+
+/* add a position to the hash chains */
+static inline void lz_insert( struct lz_matcher *matcher, ULONG pos )
+{
+    ULONG hash;
+
+    if (pos + 3 > matcher->size) return;
+    hash = lz_hash( matcher, pos );
+    matcher->prev[pos & (matcher->window - 1)] = matcher->head[hash];
+    matcher->head[hash] = pos + 1;
+}
+
+/* find the longest match for the data at pos, starting no earlier than min_pos */
+/* min_pos must be within the window, returns the match length and offset */
+static ULONG lz_find_match( const struct lz_matcher *matcher, ULONG pos, ULONG min_pos,
+                            ULONG max_len, ULONG *offset )
+{
+    const UCHAR *src = matcher->src, *cur = src + pos;
+    ULONG cand, len, best_len = 0, depth = matcher->depth;
+
+    if (max_len < 3) return 0;
+    cand = matcher->head[lz_hash( matcher, pos )];
+    while (cand-- && cand >= min_pos && depth--)
+    {
+        const UCHAR *ptr = src + cand;
+
+        if (ptr[best_len] == cur[best_len] && ptr[0] == cur[0] && ptr[1] == cur[1])
+        {
+            for (len = 2; len < max_len; len++) if (ptr[len] != cur[len]) break;
+            if (len > best_len)
+            {
+                best_len = len;
+                *offset = pos - cand;
+                if (len == max_len) break;
+            }
+        }
+        cand = matcher->prev[cand & (matcher->window - 1)];
+    }
+    return best_len >= 3 ? best_len : 0;
+}
+
+/* compress a single LZNT1 chunk, returns the compressed size or 0 if it doesn't fit */
+static ULONG lznt1_compress_chunk( struct lz_matcher *matcher, ULONG start, ULONG end,
+                                   UCHAR *dst, ULONG dst_size )
+{
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size, *flags = NULL;
+    ULONG pos = start, count = 8, displacement_bits, length_bits, len, offset;
+
+    while (pos < end)
+    {
+        if (count == 8)
+        {
+            if (dst_cur >= dst_end) return 0;
+            flags = dst_cur++;
+            *flags = 0;
+            count = 0;
+        }
+
+        /* same as in lznt1_decompress_chunk */
+        for (displacement_bits = 12; displacement_bits > 4; displacement_bits--)
+            if ((1 << (displacement_bits - 1)) < pos - start) break;
+        length_bits = 16 - displacement_bits;
+
+        if ((len = lz_find_match( matcher, pos, start, min( (1 << length_bits) + 2, end - pos ), &offset )))
+        {
+            if (dst_cur + sizeof(WORD) > dst_end) return 0;
+            *(WORD *)dst_cur = ((offset - 1) << length_bits) | (len - 3);
+            dst_cur += sizeof(WORD);
+            *flags |= 1 << count;
+            while (len--) lz_insert( matcher, pos++ );
+        }
+        else
+        {
+            if (dst_cur >= dst_end) return 0;
+            *dst_cur++ = matcher->src[pos];
+            lz_insert( matcher, pos++ );
+        }
+        count++;
+    }
+
+    return dst_cur - dst;
+}
+
+/* compress data using LZNT1 */
+static NTSTATUS lznt1_compress(USHORT format, UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
                                ULONG chunk_size, ULONG *final_size, UCHAR *workspace)
 {
-    UCHAR *src_cur = src, *src_end = src + src_size;
     UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
-    ULONG block_size;
+    struct lz_matcher matcher;
+    ULONG pos = 0, block_size, size;
 
-    while (src_cur < src_end)
+    lz_init( &matcher, src, src_size, workspace, LZNT1_HASH_BITS, LZNT1_WINDOW, format );
+
+    while (pos < src_size)
     {
         /* determine size of current chunk */
-        block_size = min(0x1000, src_end - src_cur);
-        if (dst_cur + sizeof(WORD) + block_size > dst_end)
+        block_size = min(0x1000, src_size - pos);
+        if (dst_cur + sizeof(WORD) > dst_end)
             return STATUS_BUFFER_TOO_SMALL;
 
-        /* write (uncompressed) chunk header */
-        *(WORD *)dst_cur = 0x3000 | (block_size - 1);
-        dst_cur += sizeof(WORD);
+        /* only keep the compressed chunk if it is smaller */
+        size = lznt1_compress_chunk( &matcher, pos, pos + block_size, dst_cur + sizeof(WORD),
+                                     min( dst_end - dst_cur - sizeof(WORD), block_size - 1 ));
+        if (size)
+        {
+            *(WORD *)dst_cur = 0xb000 | (size - 1);
+            dst_cur += sizeof(WORD) + size;
+        }
+        else
+        {
+            if (dst_cur + sizeof(WORD) + block_size > dst_end)
+                return STATUS_BUFFER_TOO_SMALL;
+
+            /* write (uncompressed) chunk header */
+            *(WORD *)dst_cur = 0x3000 | (block_size - 1);
+            dst_cur += sizeof(WORD);
 
-        /* write chunk content */
-        memcpy(dst_cur, src_cur, block_size);
-        dst_cur += block_size;
-        src_cur += block_size;
+            /* write chunk content */
+            memcpy(dst_cur, src + pos, block_size);
+            dst_cur += block_size;
+        }
+        pos += block_size;
     }
 
     if (final_size)
@@ -1179,6 +1331,327 @@ static NTSTATUS lznt1_compress(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst
     return STATUS_SUCCESS;
 }
 
+/* compress data using the plain LZ77 variant of Xpress */
+static NTSTATUS xpress_compress(USHORT format, UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+                                ULONG *final_size, UCHAR *workspace)
+{
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size, *flags_ptr, *half_byte = NULL;
+    ULONG pos = 0, flags = 0, flag_count = 0, len, offset;
+    struct lz_matcher matcher;
+
+    lz_init( &matcher, src, src_size, workspace, XPRESS_HASH_BITS, XPRESS_WINDOW, format );
+
+    if (dst_size < sizeof(DWORD)) return STATUS_BUFFER_TOO_SMALL;
+    flags_ptr = dst_cur;
+    dst_cur += sizeof(DWORD);
+
+    while (pos < src_size)
+    {
+        if ((len = lz_find_match( &matcher, pos, pos >= XPRESS_WINDOW ? pos - XPRESS_WINDOW + 1 : 0,
+                                  min( src_size - pos, XPRESS_MAX_MATCH ), &offset )))
+        {
+            /* worst case is 2 bytes of match, a length nibble, and 3 bytes of extra length */
+            if (dst_end - dst_cur < 6) return STATUS_BUFFER_TOO_SMALL;
+            if (len - 3 < 7)
+            {
+                *(WORD *)dst_cur = ((offset - 1) << 3) | (len - 3);
+                dst_cur += sizeof(WORD);
+            }
+            else
+            {
+                ULONG extra = len - 3 - 7;
+
+                *(WORD *)dst_cur = ((offset - 1) << 3) | 7;
+                dst_cur += sizeof(WORD);
+                if (!half_byte)
+                {
+                    half_byte = dst_cur++;
+                    *half_byte = min( extra, 15 );
+                }
+                else
+                {
+                    *half_byte |= min( extra, 15 ) << 4;
+                    half_byte = NULL;
+                }
+                if (extra >= 15)
+                {
+                    if (extra - 15 < 255) *dst_cur++ = extra - 15;
+                    else
+                    {
+                        *dst_cur++ = 255;
+                        *(WORD *)dst_cur = len - 3;
+                        dst_cur += sizeof(WORD);
+                    }
+                }
+            }
+            flags = (flags << 1) | 1;
+            while (len--) lz_insert( &matcher, pos++ );
+        }
+        else
+        {
+            if (dst_cur >= dst_end) return STATUS_BUFFER_TOO_SMALL;
+            *dst_cur++ = src[pos];
+            flags <<= 1;
+            lz_insert( &matcher, pos++ );
+        }
+
+        if (++flag_count == 32)
+        {
+            *(DWORD *)flags_ptr = flags;
+            if (dst_end - dst_cur < sizeof(DWORD)) return STATUS_BUFFER_TOO_SMALL;
+            flags_ptr = dst_cur;
+            dst_cur += sizeof(DWORD);
+            flags = flag_count = 0;
+        }
+    }
+
+    /* the remaining flags are set, a match flag without data marks the end of the stream */
+    if (flag_count) flags = (flags << (32 - flag_count)) | ((1u << (32 - flag_count)) - 1);
+    else flags = ~0u;
+    *(DWORD *)flags_ptr = flags;
+
+    if (final_size)
+        *final_size = dst_cur - dst;
+
+    return STATUS_SUCCESS;
+}
+
+struct huff_node
+{
+    ULONG freq;
+    int   parent;
+};
+
+/* build a length-limited Huffman code from the symbol frequencies */
+static void xpress_huff_build_lengths( const ULONG *freqs, UCHAR *lengths )
+{
+    struct huff_node nodes[2 * XPRESS_HUFF_SYMBOLS];
+    ULONG weights[XPRESS_HUFF_SYMBOLS];
+    USHORT leaves[XPRESS_HUFF_SYMBOLS];
+    int i, j, count, leaf, node, next, depth, max_depth;
+
+    for (i = count = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+    {
+        lengths[i] = 0;
+        if ((weights[i] = freqs[i])) leaves[count++] = i;
+    }
+    if (!count) return;
+    if (count == 1)
+    {
+        /* make sure the code is complete */
+        lengths[leaves[0]] = lengths[leaves[0] ? 0 : 1] = 1;
+        return;
+    }
+
+    for (;;)
+    {
+        /* sort the leaves by increasing weight */
+        for (i = 1; i < count; i++)
+        {
+            USHORT sym = leaves[i];
+            for (j = i; j > 0 && weights[leaves[j - 1]] > weights[sym]; j--) leaves[j] = leaves[j - 1];
+            leaves[j] = sym;
+        }
+
+        /* leaves are nodes 0 to count - 1, internal nodes are created in increasing weight order */
+        for (i = 0; i < count; i++) nodes[i].freq = weights[leaves[i]];
+        for (leaf = 0, node = next = count; next < 2 * count - 1; next++)
+        {
+            for (j = 0; j < 2; j++)
+            {
+                int child = (leaf < count && (node == next || nodes[leaf].freq <= nodes[node].freq)) ?
+                            leaf++ : node++;
+                nodes[child].parent = next;
+                nodes[next].freq = j ? nodes[next].freq + nodes[child].freq : nodes[child].freq;
+            }
+        }
+
+        /* the root is the last node, parents always come after their children */
+        max_depth = 0;
+        nodes[next - 1].freq = 0;
+        for (i = next - 2; i >= 0; i--)
+        {
+            nodes[i].freq = depth = nodes[nodes[i].parent].freq + 1;
+            if (depth > max_depth) max_depth = depth;
+        }
+        if (max_depth <= 15) break;
+
+        /* flatten the weights until the code fits */
+        for (i = 0; i < count; i++) weights[leaves[i]] = (weights[leaves[i]] + 1) / 2;
+    }
+
+    for (i = 0; i < count; i++) lengths[leaves[i]] = nodes[i].freq;
+}
+
+/* assign the canonical codes from the code lengths, in the same order as the decoder table */
+static void xpress_huff_build_codes( const UCHAR *lengths, USHORT *codes )
+{
+    ULONG len, sym, pos = 0;
+
+    for (len = 1; len <= 15; len++)
+    {
+        for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+        {
+            if (lengths[sym] != len) continue;
+            codes[sym] = pos >> (15 - len);
+            pos += 1 << (15 - len);
+        }
+    }
+}
+
+/* bit writer for the Xpress Huffman format */
+/* bits are stored in 16-bit words, whose position is reserved in the output when the decoder
+ * would read them; extra length bytes are written in between */
+struct huff_writer
+{
+    UCHAR *cur;        /* current output position for bytes and new words */
+    UCHAR *end;        /* end of the output buffer */
+    UCHAR *word;       /* position of the word being filled */
+    UCHAR *next_word;  /* position of the next word, if reserved */
+    ULONG  bits;       /* pending bits */
+    ULONG  count;      /* number of pending bits */
+};
+
+static BOOL huff_reserve_word( struct huff_writer *writer )
+{
+    if (writer->end - writer->cur < sizeof(WORD)) return FALSE;
+    writer->next_word = writer->cur;
+    writer->cur += sizeof(WORD);
+    return TRUE;
+}
+
+static BOOL huff_put_bits( struct huff_writer *writer, ULONG value, ULONG count )
+{
+    ULONG part;
+
+    if (!count) return TRUE;
+    /* the decoder reads the next word as soon as it starts using the current one */
+    if (!writer->count && !writer->next_word && !huff_reserve_word( writer )) return FALSE;
+    if (writer->count + count < 16)
+    {
+        writer->bits = (writer->bits << count) | value;
+        writer->count += count;
+        return TRUE;
+    }
+    part = 16 - writer->count;
+    count -= part;
+    *(WORD *)writer->word = (writer->bits << part) | (value >> count);
+    writer->word = writer->next_word;
+    writer->next_word = NULL;
+    writer->bits = value & ((1 << count) - 1);
+    writer->count = count;
+    if (count && !huff_reserve_word( writer )) return FALSE;
+    return TRUE;
+}
+
+static BOOL huff_put_byte( struct huff_writer *writer, UCHAR byte )
+{
+    if (writer->cur >= writer->end) return FALSE;
+    *writer->cur++ = byte;
+    return TRUE;
+}
+
+/* compress data using the LZ77 + Huffman variant of Xpress */
+static NTSTATUS xpress_huff_compress(USHORT format, UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+                                     ULONG *final_size, UCHAR *workspace)
+{
+    ULONG freqs[XPRESS_HUFF_SYMBOLS], pos = 0, start, end, len, offset, bits, count, i, *tokens;
+    UCHAR lengths[XPRESS_HUFF_SYMBOLS], *dst_cur = dst, *dst_end = dst + dst_size;
+    USHORT codes[XPRESS_HUFF_SYMBOLS], sym;
+    struct lz_matcher matcher;
+    struct huff_writer writer;
+    BOOL last;
+
+    lz_init( &matcher, src, src_size, workspace, XPRESS_HUFF_HASH_BITS, XPRESS_HUFF_WINDOW, format );
+    tokens = matcher.prev + XPRESS_HUFF_WINDOW;
+
+    do
+    {
+        /* find the matches of the block, a token is either a literal or offset << 16 | (length - 3) */
+        start = pos;
+        end = start + min( src_size - start, XPRESS_HUFF_BLOCK );
+        /* a full block can't hold the end of stream symbol, it needs another block */
+        last = (end - start < XPRESS_HUFF_BLOCK);
+        memset( freqs, 0, sizeof(freqs) );
+        for (count = 0; pos < end; count++)
+        {
+            len = lz_find_match( &matcher, pos, pos >= XPRESS_HUFF_WINDOW ? pos - XPRESS_HUFF_WINDOW + 1 : 0,
+                                 min( end - pos, XPRESS_MAX_MATCH ), &offset );
+            /* symbol 256 is also the end of stream marker, don't use it for a match */
+            if (len && (len > 3 || offset > 1))
+            {
+                BitScanReverse( &bits, offset );
+                freqs[256 + (bits << 4) + min( len - 3, 15 )]++;
+                tokens[count] = (offset << 16) | (len - 3);
+                while (len--) lz_insert( &matcher, pos++ );
+            }
+            else
+            {
+                freqs[src[pos]]++;
+                tokens[count] = src[pos];
+                lz_insert( &matcher, pos++ );
+            }
+        }
+        if (last) freqs[256]++;
+
+        xpress_huff_build_lengths( freqs, lengths );
+        xpress_huff_build_codes( lengths, codes );
+
+        /* write the code lengths, two symbols per byte */
+        if (dst_end - dst_cur < XPRESS_HUFF_SYMBOLS / 2 + 2 * sizeof(WORD)) return STATUS_BUFFER_TOO_SMALL;
+        for (i = 0; i < XPRESS_HUFF_SYMBOLS / 2; i++)
+            *dst_cur++ = lengths[2 * i] | (lengths[2 * i + 1] << 4);
+
+        writer.word = dst_cur;
+        writer.next_word = dst_cur + sizeof(WORD);
+        writer.cur = dst_cur + 2 * sizeof(WORD);
+        writer.end = dst_end;
+        writer.bits = writer.count = 0;
+
+        for (i = 0; i < count; i++)
+        {
+            if (!(offset = tokens[i] >> 16))
+            {
+                if (!huff_put_bits( &writer, codes[tokens[i]], lengths[tokens[i]] ))
+                    return STATUS_BUFFER_TOO_SMALL;
+                continue;
+            }
+            len = tokens[i] & 0xffff;
+            BitScanReverse( &bits, offset );
+            sym = 256 + (bits << 4) + min( len, 15 );
+            if (!huff_put_bits( &writer, codes[sym], lengths[sym] )) return STATUS_BUFFER_TOO_SMALL;
+            if (len >= 15)
+            {
+                if (len - 15 < 255)
+                {
+                    if (!huff_put_byte( &writer, len - 15 )) return STATUS_BUFFER_TOO_SMALL;
+                }
+                else if (!huff_put_byte( &writer, 255 ) || !huff_put_byte( &writer, len & 0xff ) ||
+                         !huff_put_byte( &writer, len >> 8 ))
+                    return STATUS_BUFFER_TOO_SMALL;
+            }
+            if (!huff_put_bits( &writer, offset - (1 << bits), bits )) return STATUS_BUFFER_TOO_SMALL;
+        }
+        if (last && !huff_put_bits( &writer, codes[256], lengths[256] )) return STATUS_BUFFER_TOO_SMALL;
+
+        /* flush the pending bits, and clear the words that have been reserved but not used */
+        if (writer.count)
+        {
+            *(WORD *)writer.word = writer.bits << (16 - writer.count);
+            writer.word = writer.next_word;
+            writer.next_word = NULL;
+        }
+        if (writer.word) *(WORD *)writer.word = 0;
+        if (writer.next_word) *(WORD *)writer.next_word = 0;
+        dst_cur = writer.cur;
+    } while (!last);
+
+    if (final_size)
+        *final_size = dst_cur - dst;
+
+    return STATUS_SUCCESS;
+}
+
 /******************************************************************************
  *  RtlCompressBuffer		[NTDLL.@]
  */
@@ -1186,14 +1659,18 @@ NTSTATUS WINAPI RtlCompressBuffer(USHORT format, PUCHAR uncompressed, ULONG unco
                                   PUCHAR compressed, ULONG compressed_size, ULONG chunk_size,
                                   PULONG final_size, PVOID workspace)
 {
-    FIXME("0x%04x, %p, %lu, %p, %lu, %lu, %p, %p: semi-stub\n", format, uncompressed,
+    void *buffer = NULL;
+    NTSTATUS status;
+
+    TRACE("0x%04x, %p, %lu, %p, %lu, %lu, %p, %p\n", format, uncompressed,
           uncompressed_size, compressed, compressed_size, chunk_size, final_size, workspace);
 
     switch (format & COMPRESSION_FORMAT_MASK)
     {
         case COMPRESSION_FORMAT_LZNT1:
-            return lznt1_compress(uncompressed, uncompressed_size, compressed,
-                                  compressed_size, chunk_size, final_size, workspace);
+        case COMPRESSION_FORMAT_XPRESS:
+        case COMPRESSION_FORMAT_XPRESS_HUFF:
+            break;
 
         case COMPRESSION_FORMAT_NONE:
         case COMPRESSION_FORMAT_DEFAULT:
@@ -1203,6 +1680,29 @@ NTSTATUS WINAPI RtlCompressBuffer(USHORT format, PUCHAR uncompressed, ULONG unco
             FIXME("format %u not implemented\n", format);
             return STATUS_UNSUPPORTED_COMPRESSION;
     }
+
+    /* applications are supposed to pass a workspace, but don't crash if they don't */
+    if (!workspace && !(workspace = buffer = RtlAllocateHeap(GetProcessHeap(), 0, compress_workspace_size(format))))
+        return STATUS_NO_MEMORY;
+
+    switch (format & COMPRESSION_FORMAT_MASK)
+    {
+        case COMPRESSION_FORMAT_LZNT1:
+            status = lznt1_compress(format, uncompressed, uncompressed_size, compressed,
+                                    compressed_size, chunk_size, final_size, workspace);
+            break;
+        case COMPRESSION_FORMAT_XPRESS:
+            status = xpress_compress(format, uncompressed, uncompressed_size, compressed,
+                                     compressed_size, final_size, workspace);
+            break;
+        default:
+            status = xpress_huff_compress(format, uncompressed, uncompressed_size, compressed,
+                                          compressed_size, final_size, workspace);
+            break;
+    }
+
+    RtlFreeHeap(GetProcessHeap(), 0, buffer);
+    return status;
 }
 
 /* decompress a single LZNT1 chunk */
@@ -1382,6 +1882,243 @@ out:
 
 }
 
+/* decompress data encoded with the plain LZ77 variant of Xpress */
+static NTSTATUS xpress_decompress(UCHAR *dst, ULONG dst_size, UCHAR *src, ULONG src_size, ULONG *final_size)
+{
+    UCHAR *src_cur = src, *src_end = src + src_size, *half_byte = NULL;
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
+    ULONG flags = 0, flag_count = 0, len, offset;
+    WORD code;
+
+    while (dst_cur < dst_end)
+    {
+        if (!flag_count)
+        {
+            if (src_cur == src_end) break;
+            if (src_cur + sizeof(DWORD) > src_end)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            flags = *(DWORD *)src_cur;
+            src_cur += sizeof(DWORD);
+            flag_count = 32;
+        }
+        flag_count--;
+
+        if (!(flags & (1u << flag_count)))
+        {
+            /* uncompressed data */
+            if (src_cur >= src_end)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            *dst_cur++ = *src_cur++;
+            continue;
+        }
+
+        /* a match flag at the end of the input marks the end of the stream */
+        if (src_cur == src_end) break;
+        if (src_cur + sizeof(WORD) > src_end)
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        code = *(WORD *)src_cur;
+        src_cur += sizeof(WORD);
+        len    = code & 7;
+        offset = (code >> 3) + 1;
+
+        if (len == 7)
+        {
+            /* extra lengths are stored in half bytes, shared between two matches */
+            if (!half_byte)
+            {
+                if (src_cur >= src_end)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                half_byte = src_cur++;
+                len = *half_byte & 0xf;
+            }
+            else
+            {
+                len = *half_byte >> 4;
+                half_byte = NULL;
+            }
+            if (len == 15)
+            {
+                if (src_cur >= src_end)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                len = *src_cur++;
+                if (len == 255)
+                {
+                    if (src_cur + sizeof(WORD) > src_end)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    len = *(WORD *)src_cur;
+                    src_cur += sizeof(WORD);
+                    if (!len)
+                    {
+                        if (src_cur + sizeof(DWORD) > src_end)
+                            return STATUS_BAD_COMPRESSION_BUFFER;
+                        len = *(DWORD *)src_cur;
+                        src_cur += sizeof(DWORD);
+                    }
+                    if (len < 15 + 7)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    len -= 15 + 7;
+                }
+                len += 15;
+            }
+            len += 7;
+        }
+        len += 3;
+
+        if (offset > dst_cur - dst)
+            return STATUS_BAD_COMPRESSION_BUFFER;
+
+        /* source and destination can overlap */
+        len = min( len, dst_end - dst_cur );
+        while (len--)
+        {
+            *dst_cur = *(dst_cur - offset);
+            dst_cur++;
+        }
+    }
+
+    if (final_size)
+        *final_size = dst_cur - dst;
+
+    return STATUS_SUCCESS;
+}
+
+/* build the decoding table of an Xpress Huffman block, indexed by the next 15 bits */
+static BOOL xpress_huff_build_table(const UCHAR *src, WORD *table, UCHAR *lengths)
+{
+    ULONG len, sym, pos = 0, size;
+
+    for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+        lengths[sym] = (src[sym / 2] >> (4 * (sym & 1))) & 0xf;
+
+    for (len = 1; len <= 15; len++)
+    {
+        for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+        {
+            if (lengths[sym] != len) continue;
+            size = 1 << (15 - len);
+            if (pos + size > 1 << 15) return FALSE;
+            while (size--) table[pos++] = sym;
+        }
+    }
+    if (!pos) return FALSE;
+
+    /* incomplete codes are allowed, as long as the missing codes aren't used */
+    while (pos < 1 << 15) table[pos++] = 0xffff;
+    return TRUE;
+}
+
+/* decompress data encoded with the LZ77 + Huffman variant of Xpress */
+static NTSTATUS xpress_huff_decompress(UCHAR *dst, ULONG dst_size, UCHAR *src, ULONG src_size,
+                                       ULONG *final_size)
+{
+    UCHAR *src_cur = src, *src_end = src + src_size;
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
+    UCHAR lengths[XPRESS_HUFF_SYMBOLS];
+    ULONG next_bits, block_end, len, bits, offset;
+    NTSTATUS status = STATUS_BAD_COMPRESSION_BUFFER;
+    int extra_bits;
+    WORD sym, *table;
+
+    if (!(table = RtlAllocateHeap( GetProcessHeap(), 0, (1 << 15) * sizeof(WORD) )))
+        return STATUS_NO_MEMORY;
+
+    while (dst_cur < dst_end && src_cur < src_end)
+    {
+        if (src_cur + XPRESS_HUFF_SYMBOLS / 2 + 2 * sizeof(WORD) > src_end) goto done;
+        if (!xpress_huff_build_table( src_cur, table, lengths )) goto done;
+        src_cur += XPRESS_HUFF_SYMBOLS / 2;
+
+        next_bits = ((ULONG)*(WORD *)src_cur << 16) | *(WORD *)(src_cur + sizeof(WORD));
+        src_cur += 2 * sizeof(WORD);
+        extra_bits = 16;
+        block_end = (dst_cur - dst) + XPRESS_HUFF_BLOCK;
+
+        while (dst_cur - dst < block_end)
+        {
+            if (dst_cur >= dst_end) break;
+
+            if ((sym = table[next_bits >> 17]) == 0xffff) goto done;
+            next_bits <<= lengths[sym];
+            extra_bits -= lengths[sym];
+            if (extra_bits < 0)
+            {
+                if (src_cur + sizeof(WORD) > src_end) goto done;
+                next_bits |= *(WORD *)src_cur << -extra_bits;
+                src_cur += sizeof(WORD);
+                extra_bits += 16;
+            }
+
+            if (sym < 256)
+            {
+                *dst_cur++ = sym;
+                continue;
+            }
+
+            /* symbol 256 at the end of the input marks the end of the stream */
+            if (sym == 256 && src_cur == src_end) break;
+
+            sym -= 256;
+            len  = sym & 15;
+            bits = sym >> 4;
+            if (len == 15)
+            {
+                if (src_cur >= src_end) goto done;
+                len = *src_cur++;
+                if (len == 255)
+                {
+                    if (src_cur + sizeof(WORD) > src_end) goto done;
+                    len = *(WORD *)src_cur;
+                    src_cur += sizeof(WORD);
+                    if (!len)
+                    {
+                        if (src_cur + sizeof(DWORD) > src_end) goto done;
+                        len = *(DWORD *)src_cur;
+                        src_cur += sizeof(DWORD);
+                    }
+                    if (len < 15) goto done;
+                    len -= 15;
+                }
+                len += 15;
+            }
+            len += 3;
+
+            offset = 1 << bits;
+            if (bits)
+            {
+                offset |= next_bits >> (32 - bits);
+                next_bits <<= bits;
+                extra_bits -= bits;
+                if (extra_bits < 0)
+                {
+                    if (src_cur + sizeof(WORD) > src_end) goto done;
+                    next_bits |= *(WORD *)src_cur << -extra_bits;
+                    src_cur += sizeof(WORD);
+                    extra_bits += 16;
+                }
+            }
+
+            if (offset > dst_cur - dst) goto done;
+
+            /* source and destination can overlap */
+            len = min( len, dst_end - dst_cur );
+            while (len--)
+            {
+                *dst_cur = *(dst_cur - offset);
+                dst_cur++;
+            }
+        }
+        if (dst_cur - dst < block_end) break;  /* end of stream */
+    }
+
+    if (final_size)
+        *final_size = dst_cur - dst;
+    status = STATUS_SUCCESS;
+
+done:
+    RtlFreeHeap( GetProcessHeap(), 0, table );
+    return status;
+}
+
 /******************************************************************************
  *  RtlDecompressFragment	[NTDLL.@]
  */
@@ -1418,6 +2155,17 @@ NTSTATUS WINAPI RtlDecompressBuffer(USHORT format, PUCHAR uncompressed, ULONG un
     TRACE("0x%04x, %p, %lu, %p, %lu, %p\n", format, uncompressed,
         uncompressed_size, compressed, compressed_size, final_size);
 
+    switch (format & COMPRESSION_FORMAT_MASK)
+    {
+        case COMPRESSION_FORMAT_XPRESS:
+            return xpress_decompress(uncompressed, uncompressed_size, compressed,
+                                     compressed_size, final_size);
+
+        case COMPRESSION_FORMAT_XPRESS_HUFF:
+            return xpress_huff_decompress(uncompressed, uncompressed_size, compressed,
+                                          compressed_size, final_size);
+    }
+
     return RtlDecompressFragment(format, uncompressed, uncompressed_size,
                                  compressed, compressed_size, 0, final_size, NULL);
 }
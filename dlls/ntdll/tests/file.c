@@ -632,6 +632,67 @@ static void delete_file_test(void)
     pRtlFreeUnicodeString( &nameW );
 }
 
+static void test_case_insensitive_rename(void)
+{
+    WCHAR dir[MAX_PATH], path[MAX_PATH], newpath[MAX_PATH];
+    ULARGE_INTEGER time;
+    FILETIME ft;
+    DWORD attrs;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathW( MAX_PATH, dir );
+    wcscat( dir, L"ntcaserename" );
+    ret = CreateDirectoryW( dir, NULL );
+    ok( ret, "CreateDirectoryW failed %lu\n", GetLastError() );
+
+    wcscpy( path, dir );
+    wcscat( path, L"\\CaseFile.txt" );
+    file = CreateFileW( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFileW failed %lu\n", GetLastError() );
+    CloseHandle( file );
+
+    /* make the directory look old, so that lookups may use a cached copy of its contents */
+    file = CreateFileW( dir, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFileW failed %lu\n", GetLastError() );
+    GetSystemTimeAsFileTime( &ft );
+    time.LowPart = ft.dwLowDateTime;
+    time.HighPart = ft.dwHighDateTime;
+    time.QuadPart -= (ULONGLONG)3600 * 10000000;
+    ft.dwLowDateTime = time.LowPart;
+    ft.dwHighDateTime = time.HighPart;
+    ret = SetFileTime( file, NULL, NULL, &ft );
+    ok( ret, "SetFileTime failed %lu\n", GetLastError() );
+    CloseHandle( file );
+
+    wcscpy( path, dir );
+    wcscat( path, L"\\CASEFILE.TXT" );
+    attrs = GetFileAttributesW( path );
+    ok( attrs != INVALID_FILE_ATTRIBUTES, "GetFileAttributesW failed %lu\n", GetLastError() );
+
+    wcscpy( newpath, dir );
+    wcscat( newpath, L"\\RenamedFile.txt" );
+    ret = MoveFileW( path, newpath );
+    ok( ret, "MoveFileW failed %lu\n", GetLastError() );
+
+    wcscpy( newpath, dir );
+    wcscat( newpath, L"\\renamedFILE.TXT" );
+    attrs = GetFileAttributesW( newpath );
+    ok( attrs != INVALID_FILE_ATTRIBUTES, "GetFileAttributesW failed %lu\n", GetLastError() );
+
+    wcscpy( path, dir );
+    wcscat( path, L"\\casefile.txt" );
+    attrs = GetFileAttributesW( path );
+    ok( attrs == INVALID_FILE_ATTRIBUTES, "old name still exists\n" );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "got error %lu\n", GetLastError() );
+
+    ret = DeleteFileW( newpath );
+    ok( ret, "DeleteFileW failed %lu\n", GetLastError() );
+    ret = RemoveDirectoryW( dir );
+    ok( ret, "RemoveDirectoryW failed %lu\n", GetLastError() );
+}
+
 #define TEST_OVERLAPPED_READ_SIZE 4096
 
 static void read_file_test(void)
@@ -1139,6 +1200,57 @@ static void test_set_io_completion(void)
     pNtClose( h );
 }
 
+static void test_remove_io_completion_many(void)
+{
+    FILE_IO_COMPLETION_INFORMATION info[200];
+    LARGE_INTEGER timeout = {{0}};
+    NTSTATUS res;
+    ULONG count, i;
+    HANDLE h;
+
+    if (!pNtRemoveIoCompletionEx)
+    {
+        skip("NtRemoveIoCompletionEx() not present\n");
+        return;
+    }
+
+    res = pNtCreateIoCompletion( &h, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+    ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#lx\n", res );
+
+    for (i = 0; i < 150; i++)
+    {
+        res = pNtSetIoCompletion( h, i, i * 2, STATUS_SUCCESS, i * 3 );
+        ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %#lx\n", res );
+    }
+
+    count = 0xdeadbeef;
+    res = pNtRemoveIoCompletionEx( h, info, 100, &count, &timeout, FALSE );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx failed: %#lx\n", res );
+    ok( count == 100, "wrong count %lu\n", count );
+    for (i = 0; i < count; i++)
+    {
+        if (info[i].CompletionKey != i || info[i].CompletionValue != i * 2 ||
+            info[i].IoStatusBlock.Information != i * 3) break;
+    }
+    ok( i == count, "wrong packet %lu: key %#Ix, value %#Ix\n", i,
+        info[i].CompletionKey, info[i].CompletionValue );
+
+    count = get_pending_msgs( h );
+    ok( count == 50, "Unexpected msg count: %ld\n", count );
+
+    count = 0xdeadbeef;
+    res = pNtRemoveIoCompletionEx( h, info, ARRAY_SIZE(info), &count, &timeout, FALSE );
+    ok( res == STATUS_SUCCESS, "NtRemoveIoCompletionEx failed: %#lx\n", res );
+    ok( count == 50, "wrong count %lu\n", count );
+    ok( info[0].CompletionKey == 100, "wrong key %#Ix\n", info[0].CompletionKey );
+    ok( info[49].CompletionKey == 149, "wrong key %#Ix\n", info[49].CompletionKey );
+
+    count = get_pending_msgs( h );
+    ok( !count, "Unexpected msg count: %ld\n", count );
+
+    pNtClose( h );
+}
+
 static void test_file_io_completion(void)
 {
     static const char pipe_name[] = "\\\\.\\pipe\\iocompletiontestnamedpipe";
@@ -4352,6 +4464,101 @@ static void test_file_completion_information(void)
     }
 }
 
+static void test_inproc_file_completion_child( char **argv )
+{
+    HANDLE file, ready, go;
+    char buffer[4];
+    OVERLAPPED ov;
+    DWORD size;
+    BOOL ret;
+    int i;
+
+    sscanf( argv[3], "%p", &file );
+    sscanf( argv[4], "%p", &ready );
+    sscanf( argv[5], "%p", &go );
+
+    memset( &ov, 0, sizeof(ov) );
+    ov.hEvent = CreateEventA( NULL, TRUE, FALSE, NULL );
+
+    /* without a completion port, the client may stop reporting completions to the server */
+    for (i = 0; i < 3; i++)
+    {
+        ov.Offset = i * 4;
+        ret = WriteFile( file, "data", 4, NULL, &ov );
+        ok( ret || GetLastError() == ERROR_IO_PENDING, "WriteFile failed, error %lu\n", GetLastError() );
+        ret = GetOverlappedResult( file, &ov, &size, TRUE );
+        ok( ret, "GetOverlappedResult failed, error %lu\n", GetLastError() );
+        ok( size == 4, "got size %lu\n", size );
+    }
+
+    /* the parent attaches a completion port through its own handle */
+    SetEvent( ready );
+    ret = WaitForSingleObject( go, 10000 );
+    ok( !ret, "wait failed %u\n", ret );
+
+    ov.Offset = 0;
+    ret = ReadFile( file, buffer, sizeof(buffer), NULL, &ov );
+    ok( ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed, error %lu\n", GetLastError() );
+    ret = GetOverlappedResult( file, &ov, &size, TRUE );
+    ok( ret, "GetOverlappedResult failed, error %lu\n", GetLastError() );
+    ok( size == 4, "got size %lu\n", size );
+    ok( !memcmp( buffer, "data", 4 ), "got %s\n", debugstr_an( buffer, size ) );
+
+    CloseHandle( ov.hEvent );
+}
+
+static void test_inproc_file_completion( char **argv )
+{
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+    STARTUPINFOA si = { sizeof(si) };
+    HANDLE file, ready, go, port;
+    char cmdline[MAX_PATH * 2];
+    PROCESS_INFORMATION pi;
+    OVERLAPPED *pov;
+    ULONG_PTR key;
+    DWORD size;
+    BOOL ret;
+
+    if (!(file = create_temp_file( FILE_FLAG_OVERLAPPED ))) return;
+    SetHandleInformation( file, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT );
+    ready = CreateEventA( &sa, FALSE, FALSE, NULL );
+    go = CreateEventA( &sa, FALSE, FALSE, NULL );
+
+    /* run the I/O in a child with in-process synchronization enabled */
+    SetEnvironmentVariableA( "WINEINPROCSYNC", "1" );
+    sprintf( cmdline, "%s %s inproc_completion %p %p %p", argv[0], argv[1], file, ready, go );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi );
+    ok( ret, "CreateProcessA failed, error %lu\n", GetLastError() );
+    SetEnvironmentVariableA( "WINEINPROCSYNC", NULL );
+    if (!ret) goto done;
+
+    ret = WaitForSingleObject( ready, 10000 );
+    ok( !ret, "wait failed %u\n", ret );
+    port = CreateIoCompletionPort( file, NULL, CKEY_FIRST, 0 );
+    ok( port != NULL, "CreateIoCompletionPort failed, error %lu\n", GetLastError() );
+    SetEvent( go );
+
+    wait_child_process( pi.hProcess );
+    CloseHandle( pi.hProcess );
+    CloseHandle( pi.hThread );
+
+    /* only the read done after the port was attached is reported */
+    ret = GetQueuedCompletionStatus( port, &size, &key, &pov, 0 );
+    ok( ret, "GetQueuedCompletionStatus failed, error %lu\n", GetLastError() );
+    ok( key == CKEY_FIRST, "got key %#Ix\n", key );
+    ok( size == 4, "got size %lu\n", size );
+    ok( pov != NULL, "got NULL overlapped\n" );
+    ret = GetQueuedCompletionStatus( port, &size, &key, &pov, 0 );
+    ok( !ret, "got unexpected completion\n" );
+    ok( GetLastError() == WAIT_TIMEOUT, "got error %lu\n", GetLastError() );
+    CloseHandle( port );
+
+done:
+    CloseHandle( ready );
+    CloseHandle( go );
+    CloseHandle( file );
+}
+
 static void test_file_id_information(void)
 {
     BY_HANDLE_FILE_INFORMATION info;
@@ -4391,6 +4598,39 @@ static void test_file_id_information(void)
     CloseHandle( h );
 }
 
+static void test_duplicate_file_access(void)
+{
+    char path[MAX_PATH], buffer[MAX_PATH], data[8];
+    HANDLE handle, dup;
+    DWORD size;
+    BOOL ret;
+
+    GetTempPathA( MAX_PATH, path );
+    GetTempFileNameA( path, "foo", 0, buffer );
+    handle = CreateFileA( buffer, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                          FILE_FLAG_DELETE_ON_CLOSE, 0 );
+    ok( handle != INVALID_HANDLE_VALUE, "CreateFile failed %lu\n", GetLastError() );
+    ret = WriteFile( handle, "data", 4, &size, NULL );
+    ok( ret && size == 4, "WriteFile failed %lu\n", GetLastError() );
+
+    ret = DuplicateHandle( GetCurrentProcess(), handle, GetCurrentProcess(), &dup, FILE_READ_DATA, FALSE, 0 );
+    ok( ret, "DuplicateHandle failed %lu\n", GetLastError() );
+
+    SetLastError( 0xdeadbeef );
+    ret = WriteFile( dup, "data", 4, &size, NULL );
+    ok( !ret, "WriteFile succeeded\n" );
+    ok( GetLastError() == ERROR_ACCESS_DENIED, "got error %lu\n", GetLastError() );
+
+    CloseHandle( handle );
+
+    SetFilePointer( dup, 0, NULL, FILE_BEGIN );
+    memset( data, 0, sizeof(data) );
+    ret = ReadFile( dup, data, sizeof(data), &size, NULL );
+    ok( ret, "ReadFile failed %lu\n", GetLastError() );
+    ok( size == 4 && !memcmp( data, "data", 4 ), "got %lu %s\n", size, debugstr_an( data, size ) );
+    CloseHandle( dup );
+}
+
 static void test_file_access_information(void)
 {
     FILE_ACCESS_INFORMATION info;
@@ -6043,6 +6283,7 @@ static void test_set_io_completion_ex(void)
 
 START_TEST(file)
 {
+    char **argv;
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
     if (!hntdll)
@@ -6085,6 +6326,12 @@ START_TEST(file)
     pNtFlushBuffersFile = (void *)GetProcAddress(hntdll, "NtFlushBuffersFile");
     pNtQueryEaFile          = (void *)GetProcAddress(hntdll, "NtQueryEaFile");
 
+    if (winetest_get_mainargs( &argv ) > 5)
+    {
+        if (!strcmp( argv[2], "inproc_completion" )) test_inproc_file_completion_child( argv );
+        return;
+    }
+
     test_read_write();
     test_NtCreateFile();
     create_file_test();
@@ -6094,6 +6341,7 @@ START_TEST(file)
     append_file_test();
     nt_mailslot_test();
     test_set_io_completion();
+    test_remove_io_completion_many();
     test_set_io_completion_ex();
     test_file_io_completion();
     test_file_basic_information();
@@ -6105,13 +6353,16 @@ START_TEST(file)
     test_file_rename_information(FileRenameInformation);
     test_file_rename_information(FileRenameInformationEx);
     test_file_rename_information_ex();
+    test_case_insensitive_rename();
     test_file_link_information(FileLinkInformation);
     test_file_link_information(FileLinkInformationEx);
     test_file_link_information_ex();
     test_file_disposition_information();
     test_file_completion_information();
+    test_inproc_file_completion( argv );
     test_file_id_information();
     test_file_access_information();
+    test_duplicate_file_access();
     test_file_attribute_tag_information();
     test_file_stat_information();
     test_dotfile_file_attributes();
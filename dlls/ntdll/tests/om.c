@@ -2302,6 +2302,102 @@ static void test_duplicate_object(void)
     if (!status) pNtClose( handle );
 }
 
+static void test_many_handles(void)
+{
+    static const unsigned int count = 20000;
+    NTSTATUS status;
+    HANDLE event, *handles;
+    unsigned int i;
+
+    status = pNtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+    ok( !status, "NtCreateEvent failed %lx\n", status );
+    handles = malloc( count * sizeof(*handles) );
+
+    for (i = 0; i < count; i++)
+    {
+        status = pNtDuplicateObject( GetCurrentProcess(), event, GetCurrentProcess(),
+                                     &handles[i], 0, 0, DUPLICATE_SAME_ACCESS );
+        if (status) break;
+    }
+    ok( i == count, "NtDuplicateObject failed at %u: %lx\n", i, status );
+
+    /* close every other handle, then fill the holes again */
+    for (i = 0; i < count; i += 2)
+    {
+        status = pNtClose( handles[i] );
+        if (status) break;
+    }
+    ok( i >= count, "NtClose failed at %u: %lx\n", i, status );
+    for (i = 0; i < count; i += 2)
+    {
+        status = pNtDuplicateObject( GetCurrentProcess(), event, GetCurrentProcess(),
+                                     &handles[i], 0, 0, DUPLICATE_SAME_ACCESS );
+        if (status) break;
+    }
+    ok( i >= count, "NtDuplicateObject failed at %u: %lx\n", i, status );
+
+    for (i = 0; i < count; i++)
+    {
+        if (handles[i] == event) break;
+        status = pNtClose( handles[i] );
+        if (status) break;
+    }
+    ok( i == count, "NtClose failed at %u: %p %lx\n", i, handles[i], status );
+
+    status = pNtClose( handles[count - 1] );
+    ok( status == STATUS_INVALID_HANDLE, "NtClose returned %lx\n", status );
+
+    free( handles );
+    pNtClose( event );
+}
+
+static void test_handle_reuse(void)
+{
+    HANDLE event, handles[4], handle;
+    NTSTATUS status;
+    unsigned int i;
+
+    status = pNtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+    ok( !status, "NtCreateEvent failed %lx\n", status );
+    for (i = 0; i < ARRAY_SIZE(handles); i++)
+    {
+        status = pNtDuplicateObject( GetCurrentProcess(), event, GetCurrentProcess(),
+                                     &handles[i], 0, 0, DUPLICATE_SAME_ACCESS );
+        ok( !status, "NtDuplicateObject failed %lx\n", status );
+    }
+
+    /* a single closed handle is reused at once */
+    pNtClose( handles[1] );
+    status = pNtDuplicateObject( GetCurrentProcess(), event, GetCurrentProcess(),
+                                 &handle, 0, 0, DUPLICATE_SAME_ACCESS );
+    ok( !status, "NtDuplicateObject failed %lx\n", status );
+    ok( handle == handles[1], "got %p, expected %p\n", handle, handles[1] );
+
+    /* handles closed in decreasing order come back in increasing order */
+    for (i = ARRAY_SIZE(handles); i > 0; i--) pNtClose( handles[i - 1] );
+    for (i = 0; i < ARRAY_SIZE(handles); i++)
+    {
+        status = pNtDuplicateObject( GetCurrentProcess(), event, GetCurrentProcess(),
+                                     &handle, 0, 0, DUPLICATE_SAME_ACCESS );
+        ok( !status, "NtDuplicateObject failed %lx\n", status );
+        ok( handle == handles[i], "%u: got %p, expected %p\n", i, handle, handles[i] );
+    }
+
+    /* handles closed in increasing order are all reused before new ones are allocated */
+    for (i = 0; i < ARRAY_SIZE(handles); i++) pNtClose( handles[i] );
+    for (i = 0; i < ARRAY_SIZE(handles); i++)
+    {
+        status = pNtDuplicateObject( GetCurrentProcess(), event, GetCurrentProcess(),
+                                     &handle, 0, 0, DUPLICATE_SAME_ACCESS );
+        ok( !status, "NtDuplicateObject failed %lx\n", status );
+        ok( handle == handles[0] || handle == handles[1] || handle == handles[2] || handle == handles[3],
+            "%u: got unexpected handle %p\n", i, handle );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(handles); i++) pNtClose( handles[i] );
+    pNtClose( event );
+}
+
 static void test_object_types(void)
 {
     static const struct { const WCHAR *name; GENERIC_MAPPING mapping; ULONG mask, broken; } tests[] =
@@ -3886,6 +3982,8 @@ START_TEST(om)
     test_process();
     test_token();
     test_duplicate_object();
+    test_many_handles();
+    test_handle_reuse();
     test_object_types();
     test_get_next_thread();
     test_globalroot();
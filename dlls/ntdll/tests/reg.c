@@ -799,6 +799,236 @@ static void test_NtQueryValueKey(void)
     pNtClose(key);
 }
 
+static void test_value_cache(void)
+{
+    KEY_VALUE_PARTIAL_INFORMATION *info;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name, upper_name, subkey_name;
+    HANDLE key, key2, key3, subkey;
+    char buffer[64];
+    NTSTATUS status;
+    DWORD value, len;
+
+    /* values cached by ntdll must reflect changes made through other handles */
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+    status = pNtOpenKey(&key2, KEY_ALL_ACCESS, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+
+    info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+    pRtlInitUnicodeString(&name, L"cachetest");
+
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08lx\n", status);
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08lx\n", status);
+
+    value = 1;
+    status = pNtSetValueKey(key2, &name, 0, REG_DWORD, &value, sizeof(value));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+    ok(*(DWORD *)info->Data == 1, "got %lu\n", *(DWORD *)info->Data);
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+    ok(*(DWORD *)info->Data == 1, "got %lu\n", *(DWORD *)info->Data);
+
+    value = 2;
+    status = pNtSetValueKey(key2, &name, 0, REG_DWORD, &value, sizeof(value));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+    ok(*(DWORD *)info->Data == 2, "got %lu\n", *(DWORD *)info->Data);
+
+    /* value names are case-insensitive */
+    pRtlInitUnicodeString(&upper_name, L"CacheTest");
+    status = pNtQueryValueKey(key, &upper_name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+    ok(*(DWORD *)info->Data == 2, "got %lu\n", *(DWORD *)info->Data);
+
+    /* cached values must not be returned through handles without query access */
+    status = pNtOpenKey(&key3, KEY_SET_VALUE, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(key3, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_ACCESS_DENIED, "got 0x%08lx\n", status);
+    pNtClose(key3);
+    status = pNtOpenKey(&key3, KEY_ENUMERATE_SUB_KEYS, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(key3, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_ACCESS_DENIED, "got 0x%08lx\n", status);
+    pNtClose(key3);
+
+    /* a buffer too small for the data must still be handled correctly */
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer,
+                              FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[2]), &len);
+    ok(status == STATUS_BUFFER_OVERFLOW, "got 0x%08lx\n", status);
+    ok(len == FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[4]), "got len %lu\n", len);
+
+    status = pNtDeleteValueKey(key2, &name);
+    ok(status == STATUS_SUCCESS, "NtDeleteValueKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08lx\n", status);
+
+    /* values queried through a closed handle must still reflect later changes */
+    status = pNtSetValueKey(key2, &name, 0, REG_DWORD, &value, sizeof(value));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+    pNtClose(key);
+
+    value = 3;
+    status = pNtSetValueKey(key2, &name, 0, REG_DWORD, &value, sizeof(value));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_READ, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(key, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+    ok(*(DWORD *)info->Data == 3, "got %lu\n", *(DWORD *)info->Data);
+    pNtClose(key);
+
+    /* a reused handle must not return the values of the previous key */
+    pRtlInitUnicodeString(&subkey_name, L"cachetest");
+    InitializeObjectAttributes(&attr, &subkey_name, 0, key2, 0);
+    status = pNtCreateKey(&subkey, KEY_ALL_ACCESS, &attr, 0, 0, REG_OPTION_VOLATILE, 0);
+    ok(status == STATUS_SUCCESS, "NtCreateKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(subkey, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08lx\n", status);
+
+    status = pNtDeleteKey(subkey);
+    ok(status == STATUS_SUCCESS, "NtDeleteKey failed: 0x%08lx\n", status);
+    status = pNtQueryValueKey(subkey, &name, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_KEY_DELETED, "got 0x%08lx\n", status);
+    pNtClose(subkey);
+
+    status = pNtDeleteValueKey(key2, &name);
+    ok(status == STATUS_SUCCESS, "NtDeleteValueKey failed: 0x%08lx\n", status);
+    pNtClose(key2);
+}
+
+static void test_large_key(void)
+{
+    KEY_BASIC_INFORMATION *key_info;
+    KEY_VALUE_BASIC_INFORMATION *value_info;
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING str;
+    HANDLE key, subkey;
+    WCHAR name[16];
+    char buffer[256];
+    NTSTATUS status;
+    DWORD len, i, n;
+
+    /* enough subkeys and values for the server to index them, created out of order */
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&subkey, KEY_ALL_ACCESS, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+    pRtlInitUnicodeString(&str, L"LargeKey");
+    InitializeObjectAttributes(&attr, &str, 0, subkey, 0);
+    status = pNtCreateKey(&key, KEY_ALL_ACCESS, &attr, 0, 0, REG_OPTION_VOLATILE, 0);
+    ok(status == STATUS_SUCCESS, "NtCreateKey failed: 0x%08lx\n", status);
+    pNtClose(subkey);
+    if (status) return;
+
+    for (i = 0; i < 1000; i++)
+    {
+        n = (i * 337) % 1000;
+        swprintf(name, ARRAY_SIZE(name), n % 2 ? L"k%03u" : L"K%03u", n);
+        pRtlInitUnicodeString(&str, name);
+        InitializeObjectAttributes(&attr, &str, 0, key, 0);
+        status = pNtCreateKey(&subkey, KEY_ALL_ACCESS, &attr, 0, 0, REG_OPTION_VOLATILE, 0);
+        ok(status == STATUS_SUCCESS, "%lu: NtCreateKey failed: 0x%08lx\n", i, status);
+        pNtClose(subkey);
+
+        swprintf(name, ARRAY_SIZE(name), n % 3 ? L"v%03u" : L"V%03u", n);
+        pRtlInitUnicodeString(&str, name);
+        status = pNtSetValueKey(key, &str, 0, REG_DWORD, &n, sizeof(n));
+        ok(status == STATUS_SUCCESS, "%lu: NtSetValueKey failed: 0x%08lx\n", i, status);
+    }
+
+    /* lookups are case insensitive */
+    for (i = 0; i < 1000; i += 7)
+    {
+        swprintf(name, ARRAY_SIZE(name), i % 2 ? L"K%03u" : L"k%03u", i);
+        pRtlInitUnicodeString(&str, name);
+        InitializeObjectAttributes(&attr, &str, 0, key, 0);
+        status = pNtOpenKey(&subkey, KEY_READ, &attr);
+        ok(status == STATUS_SUCCESS, "%lu: NtOpenKey failed: 0x%08lx\n", i, status);
+        pNtClose(subkey);
+
+        swprintf(name, ARRAY_SIZE(name), i % 3 ? L"V%03u" : L"v%03u", i);
+        pRtlInitUnicodeString(&str, name);
+        status = pNtQueryValueKey(key, &str, KeyValuePartialInformation, buffer, sizeof(buffer), &len);
+        ok(status == STATUS_SUCCESS, "%lu: NtQueryValueKey failed: 0x%08lx\n", i, status);
+        ok(*(DWORD *)((KEY_VALUE_PARTIAL_INFORMATION *)buffer)->Data == i, "%lu: wrong data\n", i);
+    }
+
+    /* delete every third subkey and value */
+    for (i = 0; i < 1000; i += 3)
+    {
+        swprintf(name, ARRAY_SIZE(name), L"k%03u", i);
+        pRtlInitUnicodeString(&str, name);
+        InitializeObjectAttributes(&attr, &str, 0, key, 0);
+        status = pNtOpenKey(&subkey, KEY_ALL_ACCESS, &attr);
+        ok(status == STATUS_SUCCESS, "%lu: NtOpenKey failed: 0x%08lx\n", i, status);
+        status = pNtDeleteKey(subkey);
+        ok(status == STATUS_SUCCESS, "%lu: NtDeleteKey failed: 0x%08lx\n", i, status);
+        pNtClose(subkey);
+
+        swprintf(name, ARRAY_SIZE(name), L"v%03u", i);
+        pRtlInitUnicodeString(&str, name);
+        status = pNtDeleteValueKey(key, &str);
+        ok(status == STATUS_SUCCESS, "%lu: NtDeleteValueKey failed: 0x%08lx\n", i, status);
+    }
+
+    /* enumeration returns the remaining entries in sorted order */
+    key_info = (KEY_BASIC_INFORMATION *)buffer;
+    for (i = n = 0; n < 1000; n++)
+    {
+        if (!(n % 3)) continue;
+        status = pNtEnumerateKey(key, i, KeyBasicInformation, buffer, sizeof(buffer), &len);
+        ok(status == STATUS_SUCCESS, "%lu: NtEnumerateKey failed: 0x%08lx\n", i, status);
+        swprintf(name, ARRAY_SIZE(name), n % 2 ? L"k%03u" : L"K%03u", n);
+        ok(key_info->NameLength == wcslen(name) * sizeof(WCHAR) &&
+           !memcmp(key_info->Name, name, key_info->NameLength), "%lu: got %s\n", i,
+           wine_dbgstr_wn(key_info->Name, key_info->NameLength / sizeof(WCHAR)));
+        i++;
+    }
+    status = pNtEnumerateKey(key, i, KeyBasicInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_NO_MORE_ENTRIES, "got 0x%08lx\n", status);
+
+    value_info = (KEY_VALUE_BASIC_INFORMATION *)buffer;
+    for (i = n = 0; n < 1000; n++)
+    {
+        if (!(n % 3)) continue;
+        status = pNtEnumerateValueKey(key, i, KeyValueBasicInformation, buffer, sizeof(buffer), &len);
+        ok(status == STATUS_SUCCESS, "%lu: NtEnumerateValueKey failed: 0x%08lx\n", i, status);
+        swprintf(name, ARRAY_SIZE(name), L"v%03u", n);
+        ok(value_info->NameLength == wcslen(name) * sizeof(WCHAR) &&
+           !memcmp(value_info->Name, name, value_info->NameLength), "%lu: got %s\n", i,
+           wine_dbgstr_wn(value_info->Name, value_info->NameLength / sizeof(WCHAR)));
+        i++;
+    }
+    status = pNtEnumerateValueKey(key, i, KeyValueBasicInformation, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_NO_MORE_ENTRIES, "got 0x%08lx\n", status);
+
+    while (!pNtEnumerateKey(key, 0, KeyBasicInformation, buffer, sizeof(buffer), &len))
+    {
+        memcpy(name, key_info->Name, key_info->NameLength);
+        name[key_info->NameLength / sizeof(WCHAR)] = 0;
+        pRtlInitUnicodeString(&str, name);
+        InitializeObjectAttributes(&attr, &str, 0, key, 0);
+        status = pNtOpenKey(&subkey, KEY_ALL_ACCESS, &attr);
+        ok(status == STATUS_SUCCESS, "NtOpenKey failed: 0x%08lx\n", status);
+        if (status) break;
+        pNtDeleteKey(subkey);
+        pNtClose(subkey);
+    }
+    status = pNtDeleteKey(key);
+    ok(status == STATUS_SUCCESS, "NtDeleteKey failed: 0x%08lx\n", status);
+    pNtClose(key);
+}
+
 static void test_NtDeleteKey(void)
 {
     UNICODE_STRING string;
@@ -3095,6 +3325,8 @@ START_TEST(reg)
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
+    test_value_cache();
+    test_large_key();
     test_long_value_name();
     test_notify();
     test_RtlCreateRegistryKey();
@@ -2433,7 +2433,6 @@ static void test_RtlCompressBuffer(void)
                                buf1, sizeof(buf1), 4096, &final_size, workspace);
     ok(status == STATUS_SUCCESS, "got wrong status 0x%08lx\n", status);
     ok((*(WORD *)buf1 & 0x7000) == 0x3000, "no chunk signature found %04x\n", *(WORD *)buf1);
-    todo_wine
     ok(final_size < sizeof(test_buffer), "got wrong final_size %lu\n", final_size);
 
     /* test decompression */
@@ -2457,6 +2456,79 @@ static void test_RtlCompressBuffer(void)
     HeapFree(GetProcessHeap(), 0, workspace);
 }
 
+static void test_RtlCompressBuffer_formats(void)
+{
+    static const UCHAR xpress_abc[] = {0xff, 0xff, 0xff, 0x1f, 'a', 'b', 'c', 0x17, 0x00, 0x0f, 0xff, 0x26, 0x01};
+    static const USHORT formats[] = {COMPRESSION_FORMAT_LZNT1, COMPRESSION_FORMAT_XPRESS,
+                                     COMPRESSION_FORMAT_XPRESS_HUFF};
+    ULONG compress_workspace, decompress_workspace, final_size, compressed_size, size, i, j;
+    UCHAR *workspace, *src, *dst, *buf;
+    unsigned int seed = 1;
+    NTSTATUS status;
+
+    size = 200000;
+    src = HeapAlloc(GetProcessHeap(), 0, size);
+    dst = HeapAlloc(GetProcessHeap(), 0, size + 0x1000);
+    buf = HeapAlloc(GetProcessHeap(), 0, size);
+
+    /* random letters, with lots of short repeats */
+    for (i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        if (i > 64 && (seed >> 16) % 8) src[i] = src[i - 1 - (seed >> 16) % 64];
+        else src[i] = 'a' + (seed >> 16) % 26;
+    }
+
+    /* example from the specification */
+    memset(buf, 0x11, 301);
+    status = RtlDecompressBuffer(COMPRESSION_FORMAT_XPRESS, buf, 301, (UCHAR *)xpress_abc,
+                                 sizeof(xpress_abc), &final_size);
+    if (status == STATUS_UNSUPPORTED_COMPRESSION)
+    {
+        win_skip("Xpress compression is not supported\n");
+        goto done;
+    }
+    ok(status == STATUS_SUCCESS, "got wrong status 0x%08lx\n", status);
+    ok(final_size == 300, "got wrong final_size %lu\n", final_size);
+    for (i = 0; i < 300; i++) if (buf[i] != "abc"[i % 3]) break;
+    ok(i == 300, "got wrong decoded data at %lu\n", i);
+    ok(buf[300] == 0x11, "too many bytes written\n");
+
+    for (i = 0; i < ARRAY_SIZE(formats); i++)
+    {
+        for (j = 0; j < 2; j++)
+        {
+            USHORT format = formats[i] | (j ? COMPRESSION_ENGINE_MAXIMUM : COMPRESSION_ENGINE_STANDARD);
+
+            status = RtlGetCompressionWorkSpaceSize(format, &compress_workspace, &decompress_workspace);
+            ok(status == STATUS_SUCCESS, "%04x: got wrong status 0x%08lx\n", format, status);
+            workspace = HeapAlloc(GetProcessHeap(), 0, compress_workspace);
+
+            compressed_size = 0xdeadbeef;
+            status = RtlCompressBuffer(format, src, size, dst, size + 0x1000, 4096, &compressed_size, workspace);
+            ok(status == STATUS_SUCCESS, "%04x: got wrong status 0x%08lx\n", format, status);
+            ok(compressed_size < size * 9 / 10, "%04x: got compressed size %lu\n", format, compressed_size);
+
+            final_size = 0xdeadbeef;
+            memset(buf, 0, size);
+            status = RtlDecompressBuffer(formats[i], buf, size, dst, compressed_size, &final_size);
+            ok(status == STATUS_SUCCESS, "%04x: got wrong status 0x%08lx\n", format, status);
+            ok(final_size == size, "%04x: got wrong final_size %lu\n", format, final_size);
+            ok(!memcmp(buf, src, size), "%04x: got wrong decoded data\n", format);
+
+            status = RtlCompressBuffer(format, src, size, dst, compressed_size / 2, 4096, &final_size, workspace);
+            ok(status == STATUS_BUFFER_TOO_SMALL, "%04x: got wrong status 0x%08lx\n", format, status);
+
+            HeapFree(GetProcessHeap(), 0, workspace);
+        }
+    }
+
+done:
+    HeapFree(GetProcessHeap(), 0, src);
+    HeapFree(GetProcessHeap(), 0, dst);
+    HeapFree(GetProcessHeap(), 0, buf);
+}
+
 static void test_RtlGetCompressionWorkSpaceSize(void)
 {
     ULONG compress_workspace, decompress_workspace;
@@ -5419,6 +5491,7 @@ START_TEST(rtl)
     test_LdrAddRefDll();
     test_LdrLockLoaderLock();
     test_RtlCompressBuffer();
+    test_RtlCompressBuffer_formats();
     test_RtlGetCompressionWorkSpaceSize();
     test_RtlDecompressBuffer();
     test_RtlIsCriticalSectionLocked();
@@ -27,11 +27,13 @@
 #include "wine/test.h"
 
 static NTSTATUS (WINAPI *pNtAlertThreadByThreadId)( HANDLE );
+static NTSTATUS (WINAPI *pNtCancelTimer)( HANDLE, BOOLEAN * );
 static NTSTATUS (WINAPI *pNtClose)( HANDLE );
 static NTSTATUS (WINAPI *pNtCreateEvent) ( PHANDLE, ACCESS_MASK, const OBJECT_ATTRIBUTES *, EVENT_TYPE, BOOLEAN);
 static NTSTATUS (WINAPI *pNtCreateKeyedEvent)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES *, ULONG );
 static NTSTATUS (WINAPI *pNtCreateMutant)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES *, BOOLEAN );
 static NTSTATUS (WINAPI *pNtCreateSemaphore)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES *, LONG, LONG );
+static NTSTATUS (WINAPI *pNtCreateTimer)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES *, TIMER_TYPE );
 static NTSTATUS (WINAPI *pNtDelayExecution)( BOOLEAN, const LARGE_INTEGER * );
 static NTSTATUS (WINAPI *pNtOpenEvent)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES * );
 static NTSTATUS (WINAPI *pNtOpenKeyedEvent)( HANDLE *, ACCESS_MASK, const OBJECT_ATTRIBUTES * );
@@ -45,6 +47,8 @@ static NTSTATUS (WINAPI *pNtReleaseMutant)( HANDLE, LONG * );
 static NTSTATUS (WINAPI *pNtReleaseSemaphore)( HANDLE, ULONG, ULONG * );
 static NTSTATUS (WINAPI *pNtResetEvent)( HANDLE, LONG * );
 static NTSTATUS (WINAPI *pNtSetEvent)( HANDLE, LONG * );
+static NTSTATUS (WINAPI *pNtSetTimer)( HANDLE, const LARGE_INTEGER *, PTIMER_APC_ROUTINE, void *, BOOLEAN, ULONG, BOOLEAN * );
+static NTSTATUS (WINAPI *pNtWaitForSingleObject)( HANDLE, BOOLEAN, const LARGE_INTEGER * );
 static NTSTATUS (WINAPI *pNtWaitForAlertByThreadId)( void *, const LARGE_INTEGER * );
 static NTSTATUS (WINAPI *pNtWaitForKeyedEvent)( HANDLE, const void *, BOOLEAN, const LARGE_INTEGER * );
 static BOOLEAN  (WINAPI *pRtlAcquireResourceExclusive)( RTL_RWLOCK *, BOOLEAN );
@@ -1129,6 +1133,176 @@ static void test_delayexecution(void)
     }
 }
 
+static void test_many_timers(void)
+{
+    HANDLE timers[512];
+    LARGE_INTEGER due, timeout;
+    NTSTATUS status;
+    BOOLEAN state;
+    unsigned int i;
+
+    /* queue many server timeouts with out of order expiry times, then cancel half of them */
+    for (i = 0; i < ARRAY_SIZE(timers); i++)
+    {
+        status = pNtCreateTimer( &timers[i], TIMER_ALL_ACCESS, NULL, NotificationTimer );
+        ok( !status, "%u: NtCreateTimer failed %#lx\n", i, status );
+        due.QuadPart = -10000 * (LONGLONG)(1 + (i * 37) % 50);
+        status = pNtSetTimer( timers[i], &due, NULL, NULL, FALSE, 0, NULL );
+        ok( !status, "%u: NtSetTimer failed %#lx\n", i, status );
+    }
+
+    for (i = 1; i < ARRAY_SIZE(timers); i += 2)
+    {
+        status = pNtCancelTimer( timers[i], &state );
+        ok( !status, "%u: NtCancelTimer failed %#lx\n", i, status );
+    }
+
+    timeout.QuadPart = -50000000;
+    for (i = 0; i < ARRAY_SIZE(timers); i += 2)
+    {
+        status = pNtWaitForSingleObject( timers[i], FALSE, &timeout );
+        ok( !status, "%u: wait failed %#lx\n", i, status );
+    }
+
+    timeout.QuadPart = 0;
+    for (i = 1; i < ARRAY_SIZE(timers); i += 2)
+    {
+        status = pNtWaitForSingleObject( timers[i], FALSE, &timeout );
+        ok( status == STATUS_TIMEOUT, "%u: wait returned %#lx\n", i, status );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(timers); i++) pNtClose( timers[i] );
+}
+
+struct contention_params
+{
+    HANDLE mutant;
+    HANDLE semaphore;
+    HANDLE event;
+    LONG   mutant_count;
+    LONG   semaphore_count;
+    LONG   event_count;
+};
+
+static DWORD WINAPI contention_thread( void *arg )
+{
+    struct contention_params *params = arg;
+    NTSTATUS status;
+    LONG prev;
+    unsigned int i;
+
+    for (i = 0; i < 2000; i++)
+    {
+        status = pNtWaitForSingleObject( params->mutant, FALSE, NULL );
+        ok( !status, "wait failed %#lx\n", status );
+        status = pNtWaitForSingleObject( params->mutant, FALSE, NULL );
+        ok( !status, "recursive wait failed %#lx\n", status );
+        params->mutant_count++;
+        status = pNtReleaseMutant( params->mutant, &prev );
+        ok( !status, "NtReleaseMutant failed %#lx\n", status );
+        ok( prev == -1, "got prev %ld\n", prev );
+        status = pNtReleaseMutant( params->mutant, &prev );
+        ok( !status, "NtReleaseMutant failed %#lx\n", status );
+        ok( !prev, "got prev %ld\n", prev );
+
+        status = pNtWaitForSingleObject( params->semaphore, FALSE, NULL );
+        ok( !status, "wait failed %#lx\n", status );
+        params->semaphore_count++;
+        status = pNtReleaseSemaphore( params->semaphore, 1, NULL );
+        ok( !status, "NtReleaseSemaphore failed %#lx\n", status );
+
+        status = pNtWaitForSingleObject( params->event, FALSE, NULL );
+        ok( !status, "wait failed %#lx\n", status );
+        params->event_count++;
+        status = pNtSetEvent( params->event, &prev );
+        ok( !status, "NtSetEvent failed %#lx\n", status );
+        ok( !prev, "got prev %ld\n", prev );
+    }
+    return 0;
+}
+
+static DWORD WINAPI abandon_thread( void *arg )
+{
+    NTSTATUS status = pNtWaitForSingleObject( arg, FALSE, NULL );
+    ok( !status, "wait failed %#lx\n", status );
+    return 0;
+}
+
+static void test_contention(void)
+{
+    struct contention_params params = { 0 };
+    HANDLE threads[4];
+    LARGE_INTEGER timeout;
+    NTSTATUS status;
+    unsigned int i;
+    ULONG count;
+    LONG prev;
+
+    status = pNtCreateMutant( &params.mutant, MUTANT_ALL_ACCESS, NULL, FALSE );
+    ok( !status, "NtCreateMutant failed %#lx\n", status );
+    status = pNtCreateSemaphore( &params.semaphore, SEMAPHORE_ALL_ACCESS, NULL, 1, 1 );
+    ok( !status, "NtCreateSemaphore failed %#lx\n", status );
+    status = pNtCreateEvent( &params.event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, TRUE );
+    ok( !status, "NtCreateEvent failed %#lx\n", status );
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread( NULL, 0, contention_thread, &params, 0, NULL );
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        status = pNtWaitForSingleObject( threads[i], FALSE, NULL );
+        ok( !status, "wait failed %#lx\n", status );
+        CloseHandle( threads[i] );
+    }
+
+    ok( params.mutant_count == 2000 * ARRAY_SIZE(threads), "got mutant count %ld\n", params.mutant_count );
+    ok( params.semaphore_count == 2000 * ARRAY_SIZE(threads), "got semaphore count %ld\n", params.semaphore_count );
+    ok( params.event_count == 2000 * ARRAY_SIZE(threads), "got event count %ld\n", params.event_count );
+
+    /* all objects must be back in their initial state */
+    timeout.QuadPart = 0;
+    status = pNtReleaseMutant( params.mutant, &prev );
+    ok( status == STATUS_MUTANT_NOT_OWNED, "NtReleaseMutant returned %#lx\n", status );
+    status = pNtReleaseSemaphore( params.semaphore, 1, &count );
+    ok( status == STATUS_SEMAPHORE_LIMIT_EXCEEDED, "NtReleaseSemaphore returned %#lx\n", status );
+    status = pNtWaitForSingleObject( params.event, FALSE, &timeout );
+    ok( !status, "wait failed %#lx\n", status );
+    status = pNtWaitForSingleObject( params.event, FALSE, &timeout );
+    ok( status == STATUS_TIMEOUT, "wait returned %#lx\n", status );
+
+    /* a mutex still owned by a thread when it exits is abandoned */
+    threads[0] = CreateThread( NULL, 0, abandon_thread, params.mutant, 0, NULL );
+    status = pNtWaitForSingleObject( threads[0], FALSE, NULL );
+    ok( !status, "wait failed %#lx\n", status );
+    CloseHandle( threads[0] );
+    status = pNtWaitForSingleObject( params.mutant, FALSE, &timeout );
+    ok( status == STATUS_ABANDONED, "wait returned %#lx\n", status );
+    status = pNtReleaseMutant( params.mutant, &prev );
+    ok( !status, "NtReleaseMutant failed %#lx\n", status );
+
+    pNtClose( params.mutant );
+    pNtClose( params.semaphore );
+    pNtClose( params.event );
+}
+
+static void test_inproc_contention( char **argv )
+{
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    char cmdline[MAX_PATH];
+    BOOL ret;
+
+    /* run the same operations with the client-side fast paths enabled */
+    SetEnvironmentVariableA( "WINEINPROCSYNC", "1" );
+    sprintf( cmdline, "%s %s contention", argv[0], argv[1] );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    ok( ret, "failed to create process, error %lu\n", GetLastError() );
+    SetEnvironmentVariableA( "WINEINPROCSYNC", NULL );
+    if (!ret) return;
+    wait_child_process( pi.hProcess );
+    CloseHandle( pi.hProcess );
+    CloseHandle( pi.hThread );
+}
+
 START_TEST(sync)
 {
     HMODULE module = GetModuleHandleA("ntdll.dll");
@@ -1137,14 +1311,14 @@ START_TEST(sync)
 
     argc = winetest_get_mainargs( &argv );
 
-    if (argc > 2) return;
-
     pNtAlertThreadByThreadId        = (void *)GetProcAddress(module, "NtAlertThreadByThreadId");
+    pNtCancelTimer                  = (void *)GetProcAddress(module, "NtCancelTimer");
     pNtClose                        = (void *)GetProcAddress(module, "NtClose");
     pNtCreateEvent                  = (void *)GetProcAddress(module, "NtCreateEvent");
     pNtCreateKeyedEvent             = (void *)GetProcAddress(module, "NtCreateKeyedEvent");
     pNtCreateMutant                 = (void *)GetProcAddress(module, "NtCreateMutant");
     pNtCreateSemaphore              = (void *)GetProcAddress(module, "NtCreateSemaphore");
+    pNtCreateTimer                  = (void *)GetProcAddress(module, "NtCreateTimer");
     pNtDelayExecution               = (void *)GetProcAddress(module, "NtDelayExecution");
     pNtOpenEvent                    = (void *)GetProcAddress(module, "NtOpenEvent");
     pNtOpenKeyedEvent               = (void *)GetProcAddress(module, "NtOpenKeyedEvent");
@@ -1158,6 +1332,8 @@ START_TEST(sync)
     pNtReleaseSemaphore             = (void *)GetProcAddress(module, "NtReleaseSemaphore");
     pNtResetEvent                   = (void *)GetProcAddress(module, "NtResetEvent");
     pNtSetEvent                     = (void *)GetProcAddress(module, "NtSetEvent");
+    pNtSetTimer                     = (void *)GetProcAddress(module, "NtSetTimer");
+    pNtWaitForSingleObject          = (void *)GetProcAddress(module, "NtWaitForSingleObject");
     pNtWaitForAlertByThreadId       = (void *)GetProcAddress(module, "NtWaitForAlertByThreadId");
     pNtWaitForKeyedEvent            = (void *)GetProcAddress(module, "NtWaitForKeyedEvent");
     pRtlAcquireResourceExclusive    = (void *)GetProcAddress(module, "RtlAcquireResourceExclusive");
@@ -1170,6 +1346,12 @@ START_TEST(sync)
     pRtlWakeAddressAll              = (void *)GetProcAddress(module, "RtlWakeAddressAll");
     pRtlWakeAddressSingle           = (void *)GetProcAddress(module, "RtlWakeAddressSingle");
 
+    if (argc > 2)
+    {
+        if (!strcmp( argv[2], "contention" )) test_contention();
+        return;
+    }
+
     test_wait_on_address();
     test_event();
     test_mutant();
@@ -1179,4 +1361,7 @@ START_TEST(sync)
     test_tid_alert( argv );
     test_completion_port_scheduling();
     test_delayexecution();
+    test_many_timers();
+    test_contention();
+    test_inproc_contention( argv );
 }
@@ -838,6 +838,72 @@ static void test_tp_work_scheduler(void)
     pTpReleasePool(pool);
 }
 
+struct starvation_info
+{
+    LONG count;
+    LONG total;
+    HANDLE event;
+};
+
+static void CALLBACK work_starvation_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    struct starvation_info *info = userdata;
+    DWORD result;
+
+    if (InterlockedIncrement(&info->count) == info->total) SetEvent(info->event);
+    result = WaitForSingleObject(info->event, 5000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+}
+
+static void test_tp_work_starvation(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    struct starvation_info info;
+    SYSTEM_INFO system_info;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    DWORD result, ticks;
+    int i;
+
+    /* post more mutually dependent callbacks than there are CPUs, none of them
+     * can return before all of them are running */
+    GetSystemInfo(&system_info);
+    info.count = 0;
+    info.total = system_info.dwNumberOfProcessors + 32;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %lx\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+    pTpSetPoolMaxThreads(pool, info.total);
+
+    info.event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(info.event != NULL, "CreateEventW failed %lu\n", GetLastError());
+
+    work = NULL;
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    status = pTpAllocWork(&work, work_starvation_cb, &info, &environment);
+    ok(!status, "TpAllocWork failed with status %lx\n", status);
+    ok(work != NULL, "expected work != NULL\n");
+
+    ticks = GetTickCount();
+    for (i = 0; i < info.total; i++)
+        pTpPostWork(work);
+    result = WaitForSingleObject(info.event, 5000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    ticks = GetTickCount() - ticks;
+    ok(ticks < 1000, "callbacks stalled for %lu ms\n", ticks);
+    pTpWaitForWork(work, FALSE);
+    ok(info.count == info.total, "expected count = %lu, got %lu\n", info.total, info.count);
+
+    pTpReleaseWork(work);
+    pTpReleasePool(pool);
+    CloseHandle(info.event);
+}
+
 static void CALLBACK simple_release_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
 {
     HANDLE *semaphores = userdata;
@@ -1628,6 +1694,87 @@ static void test_tp_window_length(void)
     CloseHandle(semaphore);
 }
 
+struct multi_timer_info
+{
+    HANDLE semaphore;
+    LONG fired;
+};
+
+static void CALLBACK multi_timer_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_TIMER *timer)
+{
+    struct multi_timer_info *info = userdata;
+    InterlockedIncrement(&info->fired);
+    ReleaseSemaphore(info->semaphore, 1, NULL);
+}
+
+static void test_tp_multi_timer(void)
+{
+    struct multi_timer_info info[64];
+    TP_CALLBACK_ENVIRON environment;
+    TP_TIMER *timers[64];
+    LARGE_INTEGER when;
+    HANDLE semaphore;
+    NTSTATUS status;
+    TP_POOL *pool;
+    DWORD result;
+    int i;
+
+    semaphore = CreateSemaphoreA(NULL, 0, ARRAY_SIZE(timers), NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %lu\n", GetLastError());
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %lx\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    /* queue timers in reverse order of their expiration */
+    for (i = 0; i < ARRAY_SIZE(timers); i++)
+    {
+        info[i].semaphore = semaphore;
+        info[i].fired = 0;
+        timers[i] = NULL;
+        status = pTpAllocTimer(&timers[i], multi_timer_cb, &info[i], &environment);
+        ok(!status, "TpAllocTimer failed with status %lx\n", status);
+        ok(timers[i] != NULL, "expected timers[%d] != NULL\n", i);
+
+        when.QuadPart = (ULONGLONG)(200 + 2 * (ARRAY_SIZE(timers) - i)) * -10000;
+        pTpSetTimer(timers[i], &when, 0, 0);
+    }
+
+    /* cancel every third timer and reschedule some of the others */
+    for (i = 0; i < ARRAY_SIZE(timers); i += 3)
+        pTpSetTimer(timers[i], NULL, 0, 0);
+    for (i = 1; i < ARRAY_SIZE(timers); i += 6)
+    {
+        when.QuadPart = (ULONGLONG)(150 + i) * -10000;
+        pTpSetTimer(timers[i], &when, 0, 0);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(timers) - (ARRAY_SIZE(timers) + 2) / 3; i++)
+    {
+        result = WaitForSingleObject(semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    }
+    result = WaitForSingleObject(semaphore, 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %lu\n", result);
+
+    for (i = 0; i < ARRAY_SIZE(timers); i++)
+    {
+        pTpWaitForTimer(timers[i], FALSE);
+        ok(info[i].fired == (i % 3 ? 1 : 0), "timer %d fired %ld times\n", i, info[i].fired);
+        pTpReleaseTimer(timers[i]);
+    }
+
+    /* cleanup */
+    pTpReleasePool(pool);
+    CloseHandle(semaphore);
+}
+
 struct wait_info
 {
     HANDLE semaphore;
@@ -2398,12 +2545,14 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_work_starvation();
     test_tp_group_wait();
     test_tp_group_cancel();
     test_tp_instance();
     test_tp_disassociate();
     test_tp_timer();
     test_tp_window_length();
+    test_tp_multi_timer();
     test_tp_wait();
     test_tp_multi_wait();
     test_tp_io();
@@ -97,6 +97,7 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_GATE_INTERVAL 50
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
 /* internal threadpool representation */
@@ -114,6 +115,14 @@ struct threadpool
     int                     min_workers;
     int                     num_workers;
     int                     num_busy_workers;
+    int                     num_idle_workers;
+    /* concurrency control, locked via .cs */
+    int                     target_workers;
+    int                     climb_direction;
+    ULONG                   num_completed;
+    ULONG                   last_throughput;
+    BOOL                    gate_running;
+    RTL_CONDITION_VARIABLE  gate_event;
     HANDLE                  compl_port;
     TP_POOL_STACK_INFORMATION stack_info;
 };
@@ -178,7 +187,7 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            unsigned int    heap_index;
             BOOL            timer_set;
             ULONGLONG       timeout;
             LONG            period;
@@ -244,7 +253,10 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    /* binary min-heap of pending timers, ordered by timeout */
+    struct threadpool_object **pending_timers;
+    unsigned int            num_pending;
+    unsigned int            max_pending;
     RTL_CONDITION_VARIABLE  update_event;
 }
 timerqueue =
@@ -252,7 +264,9 @@ timerqueue =
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    NULL,                                       /* pending_timers */
+    0,                                          /* num_pending */
+    0,                                          /* max_pending */
     RTL_CONDITION_VARIABLE_INIT                 /* update_event */
 };
 
@@ -363,6 +377,7 @@ static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CAL
 }
 
 static void CALLBACK threadpool_worker_proc( void *param );
+static void CALLBACK threadpool_gate_proc( void *param );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread );
 static void tp_object_prepare_shutdown( struct threadpool_object *object );
@@ -1050,15 +1065,133 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
+static void timerqueue_heap_set( unsigned int index, struct threadpool_object *timer )
+{
+    timerqueue.pending_timers[index] = timer;
+    timer->u.timer.heap_index = index;
+}
+
+static void timerqueue_sift_up( unsigned int index, struct threadpool_object *timer )
+{
+    while (index)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (timerqueue.pending_timers[parent]->u.timer.timeout <= timer->u.timer.timeout) break;
+        timerqueue_heap_set( index, timerqueue.pending_timers[parent] );
+        index = parent;
+    }
+    timerqueue_heap_set( index, timer );
+}
+
+static void timerqueue_sift_down( unsigned int index, struct threadpool_object *timer )
+{
+    unsigned int child;
+
+    while ((child = 2 * index + 1) < timerqueue.num_pending)
+    {
+        if (child + 1 < timerqueue.num_pending &&
+            timerqueue.pending_timers[child + 1]->u.timer.timeout < timerqueue.pending_timers[child]->u.timer.timeout)
+            child++;
+        if (timer->u.timer.timeout <= timerqueue.pending_timers[child]->u.timer.timeout) break;
+        timerqueue_heap_set( index, timerqueue.pending_timers[child] );
+        index = child;
+    }
+    timerqueue_heap_set( index, timer );
+}
+
+/***********************************************************************
+ *           timerqueue_add_pending    (internal)
+ *
+ * Adds a timer to the pending heap. Space is reserved by tp_timerqueue_lock,
+ * so this cannot fail. Must be called with timerqueue.cs held.
+ */
+static void timerqueue_add_pending( struct threadpool_object *timer )
+{
+    assert( !timer->u.timer.timer_pending );
+    assert( timerqueue.num_pending < timerqueue.max_pending );
+
+    timerqueue_sift_up( timerqueue.num_pending++, timer );
+    timer->u.timer.timer_pending = TRUE;
+}
+
+/***********************************************************************
+ *           timerqueue_remove_pending    (internal)
+ *
+ * Removes a timer from the pending heap. Must be called with timerqueue.cs held.
+ */
+static void timerqueue_remove_pending( struct threadpool_object *timer )
+{
+    unsigned int index = timer->u.timer.heap_index;
+    struct threadpool_object *last;
+
+    assert( timer->u.timer.timer_pending );
+    assert( timerqueue.pending_timers[index] == timer );
+
+    timer->u.timer.timer_pending = FALSE;
+    last = timerqueue.pending_timers[--timerqueue.num_pending];
+    if (last == timer) return;
+
+    if (index && last->u.timer.timeout < timerqueue.pending_timers[(index - 1) / 2]->u.timer.timeout)
+        timerqueue_sift_up( index, last );
+    else
+        timerqueue_sift_down( index, last );
+}
+
+/***********************************************************************
+ *           timerqueue_get_upper    (internal)
+ *
+ * Returns the earliest time any of the pending timers must fire, taking
+ * their window length into account. Subtrees whose root expires after the
+ * current bound cannot lower it any further and are skipped.
+ */
+static void timerqueue_get_upper( unsigned int index, ULONGLONG *timeout_upper )
+{
+    struct threadpool_object *timer;
+    ULONGLONG new_timeout;
+
+    if (index >= timerqueue.num_pending) return;
+
+    timer = timerqueue.pending_timers[index];
+    assert( timer->type == TP_OBJECT_TYPE_TIMER );
+    if (timer->u.timer.timeout >= *timeout_upper) return;
+
+    new_timeout = timer->u.timer.timeout + (ULONGLONG)timer->u.timer.window_length * 10000;
+    if (new_timeout < *timeout_upper)
+        *timeout_upper = new_timeout;
+
+    timerqueue_get_upper( 2 * index + 1, timeout_upper );
+    timerqueue_get_upper( 2 * index + 2, timeout_upper );
+}
+
+/***********************************************************************
+ *           timerqueue_get_lower    (internal)
+ *
+ * Returns the latest timeout not after the given upper bound, so that a
+ * single wakeup fires as many timers as possible.
+ */
+static void timerqueue_get_lower( unsigned int index, ULONGLONG timeout_upper, ULONGLONG *timeout_lower )
+{
+    struct threadpool_object *timer;
+
+    if (index >= timerqueue.num_pending) return;
+
+    timer = timerqueue.pending_timers[index];
+    if (timer->u.timer.timeout > timeout_upper) return;
+
+    if (*timeout_lower == MAXLONGLONG || timer->u.timer.timeout > *timeout_lower)
+        *timeout_lower = timer->u.timer.timeout;
+
+    timerqueue_get_lower( 2 * index + 1, timeout_upper, timeout_lower );
+    timerqueue_get_lower( 2 * index + 2, timeout_upper, timeout_lower );
+}
+
 /***********************************************************************
  *           timerqueue_thread_proc    (internal)
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    ULONGLONG timeout_lower, timeout_upper;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
 
     TRACE( "starting timer queue thread\n" );
     set_thread_name(L"wine_threadpool_timerqueue");
@@ -1069,17 +1202,16 @@ static void CALLBACK timerqueue_thread_proc( void *param )
         NtQuerySystemTime( &now );
 
         /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        while (timerqueue.num_pending)
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            struct threadpool_object *timer = timerqueue.pending_timers[0];
             assert( timer->type == TP_OBJECT_TYPE_TIMER );
             assert( timer->u.timer.timer_pending );
             if (timer->u.timer.timeout > now.QuadPart)
                 break;
 
             /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
-            timer->u.timer.timer_pending = FALSE;
+            timerqueue_remove_pending( timer );
             tp_object_submit( timer, FALSE );
 
             /* Insert the timer back into the queue, except it's marked for shutdown. */
@@ -1088,34 +1220,14 @@ static void CALLBACK timerqueue_thread_proc( void *param )
                 timer->u.timer.timeout += (ULONGLONG)timer->u.timer.period * 10000;
                 if (timer->u.timer.timeout <= now.QuadPart)
                     timer->u.timer.timeout = now.QuadPart + 1;
-
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
-                timer->u.timer.timer_pending = TRUE;
+                timerqueue_add_pending( timer );
             }
         }
 
-        timeout_lower = timeout_upper = MAXLONGLONG;
-
         /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
-                break;
-
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
-            if (new_timeout < timeout_upper)
-                timeout_upper = new_timeout;
-        }
+        timeout_lower = timeout_upper = MAXLONGLONG;
+        timerqueue_get_upper( 0, &timeout_upper );
+        timerqueue_get_lower( 0, timeout_upper, &timeout_lower );
 
         /* Wait for timer update events or until the next timer expires. */
         if (timerqueue.objcount)
@@ -1164,6 +1276,63 @@ static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
     return status;
 }
 
+/***********************************************************************
+ *           tp_threadpool_min_target    (internal)
+ *
+ * Returns the lowest number of workers the concurrency control may target.
+ */
+static int tp_threadpool_min_target( const struct threadpool *pool )
+{
+    int count = max( pool->min_workers, NtCurrentTeb()->Peb->NumberOfProcessors );
+    return max( min( count, pool->max_workers ), 1 );
+}
+
+/***********************************************************************
+ *           tp_threadpool_start_gate    (internal)
+ *
+ * Starts the thread measuring the throughput of a saturated pool,
+ * pool->cs has to be held.
+ */
+static void tp_threadpool_start_gate( struct threadpool *pool )
+{
+    HANDLE thread;
+
+    if (pool->gate_running) return;
+    if (RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, 0, 0, 0,
+                             threadpool_gate_proc, pool, &thread, NULL )) return;
+    InterlockedIncrement( &pool->refcount );
+    pool->gate_running = TRUE;
+    NtClose( thread );
+}
+
+/***********************************************************************
+ *           tp_threadpool_climb    (internal)
+ *
+ * Hill climbing step of the concurrency control: keeps moving the target
+ * number of workers in the same direction as long as the throughput
+ * improves, reverses direction otherwise. Workers are still started whenever
+ * all of them are busy; the target only decides how many idle workers are
+ * kept instead of being retired after a short idle period. pool->cs has to
+ * be held.
+ */
+static void tp_threadpool_climb( struct threadpool *pool, ULONG throughput )
+{
+    int target, min_target = tp_threadpool_min_target( pool );
+
+    if (throughput < pool->last_throughput) pool->climb_direction = -pool->climb_direction;
+    pool->last_throughput = throughput;
+
+    target = pool->target_workers + pool->climb_direction;
+    if (target < min_target || target > pool->max_workers)
+    {
+        pool->climb_direction = -pool->climb_direction;
+        target = min( max( target, min_target ), pool->max_workers );
+    }
+    if (target != pool->target_workers)
+        TRACE( "pool %p throughput %lu, target %d workers\n", pool, throughput, target );
+    pool->target_workers = target;
+}
+
 /***********************************************************************
  *           tp_timerqueue_lock    (internal)
  *
@@ -1184,8 +1353,17 @@ static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
 
     RtlEnterCriticalSection( &timerqueue.cs );
 
+    /* Reserve a heap slot, so that setting the timer cannot fail. */
+    if (!timerqueue.pending_timers &&
+        (timerqueue.pending_timers = RtlAllocateHeap( GetProcessHeap(), 0, 8 * sizeof(*timerqueue.pending_timers) )))
+        timerqueue.max_pending = 8;
+
+    if (!array_reserve( (void **)&timerqueue.pending_timers, &timerqueue.max_pending,
+                        timerqueue.objcount + 1, sizeof(*timerqueue.pending_timers) ))
+        status = STATUS_NO_MEMORY;
+
     /* Make sure that the timerqueue thread is running. */
-    if (!timerqueue.thread_running)
+    if (!status && !timerqueue.thread_running)
     {
         HANDLE thread;
         status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, 0, 0, 0,
@@ -1221,15 +1399,15 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
     {
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
-        {
-            list_remove( &timer->u.timer.timer_entry );
-            timer->u.timer.timer_pending = FALSE;
-        }
+            timerqueue_remove_pending( timer );
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( !timerqueue.num_pending );
+            RtlFreeHeap( GetProcessHeap(), 0, timerqueue.pending_timers );
+            timerqueue.pending_timers = NULL;
+            timerqueue.max_pending = 0;
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1695,6 +1873,13 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     pool->min_workers             = 0;
     pool->num_workers             = 0;
     pool->num_busy_workers        = 0;
+    pool->num_idle_workers        = 0;
+    pool->target_workers          = tp_threadpool_min_target( pool );
+    pool->climb_direction         = 1;
+    pool->num_completed           = 0;
+    pool->last_throughput         = 0;
+    pool->gate_running            = FALSE;
+    RtlInitializeConditionVariable( &pool->gate_event );
     pool->stack_info.StackReserve = nt->OptionalHeader.SizeOfStackReserve;
     pool->stack_info.StackCommit  = nt->OptionalHeader.SizeOfStackCommit;
 
@@ -1717,6 +1902,7 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
 
     pool->shutdown = TRUE;
     RtlWakeAllConditionVariable( &pool->update_event );
+    RtlWakeAllConditionVariable( &pool->gate_event );
 }
 
 /***********************************************************************
@@ -1999,10 +2185,14 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 
     RtlEnterCriticalSection( &pool->cs );
 
-    /* Start new worker threads if required. */
+    /* Start new worker threads if required. Beyond the target concurrency,
+     * the gate thread decides how many of them are kept once idle. */
     if (pool->num_busy_workers >= pool->num_workers &&
         pool->num_workers < pool->max_workers)
+    {
         status = tp_new_worker_thread( pool );
+        if (pool->num_workers > pool->target_workers) tp_threadpool_start_gate( pool );
+    }
 
     /* Queue work item and increment refcount. */
     InterlockedIncrement( &object->refcount );
@@ -2017,7 +2207,7 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     if (status != STATUS_SUCCESS)
     {
         assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
+        if (pool->num_idle_workers) RtlWakeConditionVariable( &pool->update_event );
     }
 
     RtlLeaveCriticalSection( &pool->cs );
@@ -2343,6 +2533,8 @@ static void CALLBACK threadpool_worker_proc( void *param )
     struct threadpool *pool = param;
     LARGE_INTEGER timeout;
     struct list *ptr;
+    NTSTATUS status;
+    BOOL trim;
 
     TRACE( "starting worker thread for pool %p\n", pool );
     set_thread_name(L"wine_threadpool_worker");
@@ -2365,6 +2557,7 @@ static void CALLBACK threadpool_worker_proc( void *param )
 
             assert(pool->num_busy_workers);
             pool->num_busy_workers--;
+            pool->num_completed++;
 
             tp_object_release( object );
         }
@@ -2377,10 +2570,20 @@ static void CALLBACK threadpool_worker_proc( void *param )
          * when no new tasks are available, and the number of threads can be
          * decreased without violating the min_workers limit. An exception is when
          * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+         * can be terminated. Workers beyond the target concurrency are trimmed
+         * after a shorter idle period. */
+        trim = pool->num_workers > pool->target_workers;
+        if (trim)
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_GATE_INTERVAL * -10000;
+        else
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+        pool->num_idle_workers++;
+        status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout );
+        pool->num_idle_workers--;
+        if (status == STATUS_TIMEOUT && trim && pool->num_workers <= pool->target_workers)
+            continue;
+        if (status == STATUS_TIMEOUT && !threadpool_get_next_item( pool ) &&
+            (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
             break;
@@ -2394,6 +2597,52 @@ static void CALLBACK threadpool_worker_proc( void *param )
     RtlExitUserThread( 0 );
 }
 
+/***********************************************************************
+ *           threadpool_gate_proc    (internal)
+ *
+ * Periodically measures the throughput of a saturated pool, and adjusts
+ * the target concurrency accordingly.
+ */
+static void CALLBACK threadpool_gate_proc( void *param )
+{
+    struct threadpool *pool = param;
+    LARGE_INTEGER timeout;
+    ULONG completed, idle_rounds = 0;
+
+    TRACE( "starting gate thread for pool %p\n", pool );
+    set_thread_name(L"wine_threadpool_gate");
+
+    RtlEnterCriticalSection( &pool->cs );
+    completed = pool->num_completed;
+    while (!pool->shutdown && idle_rounds < THREADPOOL_WORKER_TIMEOUT / THREADPOOL_GATE_INTERVAL)
+    {
+        timeout.QuadPart = (ULONGLONG)THREADPOOL_GATE_INTERVAL * -10000;
+        RtlSleepConditionVariableCS( &pool->gate_event, &pool->cs, &timeout );
+
+        if (!threadpool_get_next_item( pool ) || pool->num_busy_workers < pool->num_workers)
+        {
+            idle_rounds++;
+        }
+        else if (pool->num_completed == completed)
+        {
+            /* all workers are blocked, the throughput says nothing about the concurrency */
+            idle_rounds = 0;
+        }
+        else
+        {
+            idle_rounds = 0;
+            tp_threadpool_climb( pool, pool->num_completed - completed );
+        }
+        completed = pool->num_completed;
+    }
+    pool->gate_running = FALSE;
+    RtlLeaveCriticalSection( &pool->cs );
+
+    TRACE( "terminating gate thread for pool %p\n", pool );
+    tp_threadpool_release( pool );
+    RtlExitUserThread( 0 );
+}
+
 /***********************************************************************
  *           TpAllocCleanupGroup    (NTDLL.@)
  */
@@ -2979,7 +3228,6 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
     ULONGLONG timestamp;
 
@@ -3017,10 +3265,7 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
 
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
-    {
-        list_remove( &this->u.timer.timer_entry );
-        this->u.timer.timer_pending = FALSE;
-    }
+        timerqueue_remove_pending( this );
 
     /* If the timer was enabled, then add it back to the queue. */
     if (timeout)
@@ -3029,20 +3274,11 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         this->u.timer.period        = period;
         this->u.timer.window_length = window_length;
 
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
+        timerqueue_add_pending( this );
 
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (!this->u.timer.heap_index)
             RtlWakeAllConditionVariable( &timerqueue.update_event );
-
-        this->u.timer.timer_pending = TRUE;
     }
 
     RtlLeaveCriticalSection( &timerqueue.cs );
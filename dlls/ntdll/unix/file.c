@@ -215,6 +215,7 @@ struct dir_data_names
     const WCHAR *long_name;          /* long file name in Unicode */
     const WCHAR *short_name;         /* short file name in Unicode */
     const char  *unix_name;          /* Unix file name in host encoding */
+    BOOL         is_reg;             /* known to be a regular file from the directory entry */
 };
 
 struct dir_data
@@ -548,6 +549,7 @@ static BOOL add_dir_data_names( struct dir_data *data, const WCHAR *long_name,
 
     if (!(names[data->count].long_name = add_dir_data_nameW( data, long_name ))) return FALSE;
     if (!(names[data->count].unix_name = add_dir_data_nameA( data, unix_name ))) return FALSE;
+    names[data->count].is_reg = FALSE;
     data->count++;
     return TRUE;
 }
@@ -1731,8 +1733,10 @@ static NTSTATUS fd_set_file_info( int fd, UINT attr, BOOL force_set_xattr )
 }
 
 
-/* get the stat info and file attributes for a file (by name) */
-static int get_file_info( const char *path, struct stat *st, ULONG *attr )
+/* get the stat info and file attributes for a file (by name), the parent directory identity
+ * may be specified by the caller to avoid looking it up for mount point detection */
+static int get_file_info_parent( const char *path, const struct file_identity *parent,
+                                 struct stat *st, ULONG *attr )
 {
     char *parent_path;
     char attr_data[65];
@@ -1748,6 +1752,12 @@ static int get_file_info( const char *path, struct stat *st, ULONG *attr )
         /* is a symbolic link and a directory, consider these "reparse points" */
         if (S_ISDIR( st->st_mode )) *attr |= FILE_ATTRIBUTE_REPARSE_POINT;
     }
+    else if (S_ISDIR( st->st_mode ) && parent)
+    {
+        /* consider mount points to be reparse points (IO_REPARSE_TAG_MOUNT_POINT) */
+        if (st->st_dev != parent->dev || st->st_ino == parent->ino)
+            *attr |= FILE_ATTRIBUTE_REPARSE_POINT;
+    }
     else if (S_ISDIR( st->st_mode ) && (parent_path = malloc( strlen(path) + 4 )))
     {
         struct stat parent_st;
@@ -1784,6 +1794,13 @@ static int get_file_info( const char *path, struct stat *st, ULONG *attr )
 }
 
 
+/* get the stat info and file attributes for a file (by name) */
+static int get_file_info( const char *path, struct stat *st, ULONG *attr )
+{
+    return get_file_info_parent( path, NULL, st, attr );
+}
+
+
 #if defined(__ANDROID__) && !defined(HAVE_FUTIMENS)
 static int futimens( int fd, const struct timespec spec[2] )
 {
@@ -2309,16 +2326,25 @@ static NTSTATUS get_dir_data_entry( struct dir_data *dir_data, void *info_ptr, I
                                     union file_directory_info **last_info )
 {
     const struct dir_data_names *names = &dir_data->names[dir_data->pos];
+    const struct file_identity *parent = &dir_data->id;
     union file_directory_info *info;
     struct stat st;
     ULONG name_len, start, dir_size, attributes;
+    int ret;
 
-    if (get_file_info( names->unix_name, &st, &attributes ) == -1)
+    /* the entries' parent is the listed directory, except for "." and ".." */
+    if (!strcmp( names->unix_name, "." ) || !strcmp( names->unix_name, ".." )) parent = NULL;
+
+    if (class != FileNamesInformation) ret = get_file_info_parent( names->unix_name, parent, &st, &attributes );
+    else if (names->is_reg) ret = 0; /* only directories may be ignored, no need to stat */
+    else ret = stat( names->unix_name, &st );
+
+    if (ret == -1)
     {
         TRACE( "file no longer exists %s\n", debugstr_a(names->unix_name) );
         return STATUS_SUCCESS;
     }
-    if (is_ignored_file( &st ))
+    if (!names->is_reg && is_ignored_file( &st ))
     {
         TRACE( "ignoring file %s\n", debugstr_a(names->unix_name) );
         return STATUS_SUCCESS;
@@ -2533,6 +2559,15 @@ static NTSTATUS read_directory_data_readdir( struct dir_data *data, const UNICOD
     while ((de = readdir( dir )))
     {
         if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." )) continue;
+#ifdef DT_REG
+        if (de->d_type == DT_REG)
+        {
+            unsigned int count = data->count;
+            if (!append_entry( data, de->d_name, NULL, mask )) goto done;
+            if (data->count > count) data->names[count].is_reg = TRUE;
+            continue;
+        }
+#endif
         if (!append_entry( data, de->d_name, NULL, mask )) goto done;
     }
     status = STATUS_SUCCESS;
@@ -2778,6 +2813,183 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/* cache of the names of the directories scanned by find_file_in_dir */
+struct dir_name_cache
+{
+    struct list          entry;     /* entry in the LRU list */
+    struct file_identity id;        /* directory identity */
+    time_t               mtime;     /* directory modification time */
+    long                 mtime_nsec;
+    struct dir_data     *data;      /* directory names */
+    unsigned int         hash_size; /* size of the hash table, a power of two */
+    unsigned int        *hash;      /* open addressing hash table of (name index * 2 + is_short) + 1 */
+};
+
+static struct list dir_name_cache_list = LIST_INIT( dir_name_cache_list );
+static unsigned int dir_name_cache_dirs;   /* count of cached directories */
+static unsigned int dir_name_cache_count;  /* total count of cached names */
+static pthread_mutex_t dir_name_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define DIR_NAME_CACHE_MAX_DIRS   32
+#define DIR_NAME_CACHE_MAX_NAMES  0x100000
+
+static unsigned int hash_dir_name( const WCHAR *name, int length )
+{
+    unsigned int hash = 0;
+    int i;
+
+    for (i = 0; i < length; i++) hash = hash * 65599 + towupper( name[i] );
+    return hash;
+}
+
+static inline long get_stat_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+static void free_dir_name_cache( struct dir_name_cache *cache )
+{
+    list_remove( &cache->entry );
+    dir_name_cache_dirs--;
+    dir_name_cache_count -= cache->data->count;
+    free_dir_data( cache->data );
+    free( cache->hash );
+    free( cache );
+}
+
+static void add_dir_name_hash( struct dir_name_cache *cache, const WCHAR *name, unsigned int value )
+{
+    unsigned int mask = cache->hash_size - 1, i = hash_dir_name( name, wcslen( name ) ) & mask;
+
+    while (cache->hash[i]) i = (i + 1) & mask;
+    cache->hash[i] = value + 1;
+}
+
+/* read all the names of a directory, only if it wasn't modified recently as changes made within
+ * the modification time granularity would otherwise go unnoticed */
+static struct dir_name_cache *create_dir_name_cache( const char *unix_name, const struct stat *st )
+{
+    struct dir_name_cache *cache;
+    struct dirent *de;
+    unsigned int i;
+    DIR *dir;
+
+    if (st->st_mtime >= time( NULL ) - 1) return NULL;
+
+    if (!(cache = calloc( 1, sizeof(*cache) ))) return NULL;
+    if (!(cache->data = calloc( 1, sizeof(*cache->data) ))) goto failed;
+    if (!(dir = opendir( unix_name ))) goto failed;
+    while ((de = readdir( dir )))
+        if (!append_entry( cache->data, de->d_name, NULL, NULL )) break;
+    closedir( dir );
+    if (de) goto failed;
+
+    for (cache->hash_size = 16; cache->hash_size < cache->data->count * 4; cache->hash_size *= 2) ;
+    if (!(cache->hash = calloc( cache->hash_size, sizeof(*cache->hash) ))) goto failed;
+    for (i = 0; i < cache->data->count; i++)
+    {
+        add_dir_name_hash( cache, cache->data->names[i].long_name, i * 2 );
+        if (cache->data->names[i].short_name[0])
+            add_dir_name_hash( cache, cache->data->names[i].short_name, i * 2 + 1 );
+    }
+
+    cache->id.dev = st->st_dev;
+    cache->id.ino = st->st_ino;
+    cache->mtime = st->st_mtime;
+    cache->mtime_nsec = get_stat_mtime_nsec( st );
+    TRACE( "cached %u names for %s\n", cache->data->count, debugstr_a(unix_name) );
+    return cache;
+
+failed:
+    if (cache->data) free_dir_data( cache->data );
+    free( cache );
+    return NULL;
+}
+
+/* find the cached names of a directory, discarding them if the directory was modified */
+static struct dir_name_cache *get_dir_name_cache( const struct stat *st )
+{
+    struct dir_name_cache *cache;
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_name_cache_list, struct dir_name_cache, entry )
+    {
+        if (cache->id.dev != st->st_dev || cache->id.ino != st->st_ino) continue;
+        if (cache->mtime == st->st_mtime && cache->mtime_nsec == get_stat_mtime_nsec( st )) return cache;
+        free_dir_name_cache( cache );
+        break;
+    }
+    return NULL;
+}
+
+static const char *lookup_dir_name_cache( const struct dir_name_cache *cache, const WCHAR *name, int length,
+                                          BOOLEAN short_name )
+{
+    unsigned int mask = cache->hash_size - 1, i = hash_dir_name( name, length ) & mask;
+    const struct dir_data_names *names;
+    const WCHAR *str;
+
+    for (; cache->hash[i]; i = (i + 1) & mask)
+    {
+        if ((cache->hash[i] - 1) % 2 != short_name) continue;
+        names = &cache->data->names[(cache->hash[i] - 1) / 2];
+        str = short_name ? names->short_name : names->long_name;
+        if (wcslen( str ) == length && !wcsnicmp( str, name, length )) return names->unix_name;
+    }
+    return NULL;
+}
+
+/* look for a file name in the cached names of a directory, return FALSE if the directory isn't cached */
+static BOOL find_file_in_dir_cache( char *unix_name, int pos, const WCHAR *name, int length,
+                                    BOOLEAN is_name_8_dot_3, NTSTATUS *status )
+{
+    struct dir_name_cache *cache;
+    const char *found = NULL;
+    struct stat st;
+
+    if (stat( unix_name, &st ) == -1 || !S_ISDIR( st.st_mode )) return FALSE;
+
+    mutex_lock( &dir_name_cache_mutex );
+
+    if ((cache = get_dir_name_cache( &st )))
+    {
+        list_remove( &cache->entry );
+        list_add_head( &dir_name_cache_list, &cache->entry );
+    }
+    else if ((cache = create_dir_name_cache( unix_name, &st )))
+    {
+        struct list *ptr;
+
+        list_add_head( &dir_name_cache_list, &cache->entry );
+        dir_name_cache_dirs++;
+        dir_name_cache_count += cache->data->count;
+        while ((ptr = list_tail( &dir_name_cache_list )) != &cache->entry &&
+               (dir_name_cache_dirs > DIR_NAME_CACHE_MAX_DIRS || dir_name_cache_count > DIR_NAME_CACHE_MAX_NAMES))
+            free_dir_name_cache( LIST_ENTRY( ptr, struct dir_name_cache, entry ) );
+    }
+
+    if (cache)
+    {
+        found = lookup_dir_name_cache( cache, name, length, FALSE );
+        if (!found && is_name_8_dot_3) found = lookup_dir_name_cache( cache, name, length, TRUE );
+        if (found)
+        {
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, found );
+        }
+        *status = found ? STATUS_SUCCESS : STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
+    mutex_unlock( &dir_name_cache_mutex );
+    return cache != NULL;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2790,6 +3002,7 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 {
     WCHAR buffer[MAX_DIR_ENTRY_LEN];
     BOOLEAN is_name_8_dot_3;
+    NTSTATUS status;
     DIR *dir;
     struct dirent *de;
     struct stat st;
@@ -2868,6 +3081,12 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    if (find_file_in_dir_cache( unix_name, pos, name, length, is_name_8_dot_3, &status ))
+    {
+        if (!status) return STATUS_SUCCESS;
+        goto not_found;
+    }
+
     if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
 
     unix_name[pos - 1] = '/';
@@ -4013,9 +4232,12 @@ NTSTATUS open_unix_file( HANDLE *handle, const char *unix_name, ACCESS_MASK acce
     struct object_attributes *objattr;
     unsigned int status;
     data_size_t len;
+    sigset_t sigset;
 
     if ((status = alloc_object_attributes( attr, &objattr, &len ))) return status;
 
+    /* the server sends the unix fd along with the handle */
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
     SERVER_START_REQ( create_file )
     {
         req->access     = access;
@@ -4027,8 +4249,10 @@ NTSTATUS open_unix_file( HANDLE *handle, const char *unix_name, ACCESS_MASK acce
         wine_server_add_data( req, unix_name, strlen(unix_name) );
         status = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        receive_handle_fd( *handle, reply->fd_type, reply->fd_access, reply->fd_options );
     }
     SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
     free( objattr );
     return status;
 }
@@ -5409,6 +5633,11 @@ static unsigned int register_async_file_read( HANDLE handle, HANDLE event,
 
 static void add_completion( HANDLE handle, ULONG_PTR value, NTSTATUS status, ULONG info, BOOL async )
 {
+    data_size_t sync_offset = 0;
+
+    /* the server would ignore it, the file has no completion port */
+    if (!inproc_file_may_have_completion( handle )) return;
+
     SERVER_START_REQ( add_fd_completion )
     {
         req->handle      = wine_server_obj_handle( handle );
@@ -5416,9 +5645,10 @@ static void add_completion( HANDLE handle, ULONG_PTR value, NTSTATUS status, ULO
         req->status      = status;
         req->information = info;
         req->async       = async;
-        wine_server_call( req );
+        if (!wine_server_call( req )) sync_offset = reply->sync_offset;
     }
     SERVER_END_REQ;
+    if (sync_offset) cache_inproc_file( handle, sync_offset );
 }
 
 /* notify direct completion of async and close the wait handle if it is no longer needed */
@@ -39,6 +39,8 @@ WINE_DEFAULT_DEBUG_CHANNEL(reg);
 /* maximum length of a value name in bytes (without terminating null) */
 #define MAX_VALUE_LENGTH (16383 * sizeof(WCHAR))
 
+static void add_reg_cache_handle( HANDLE handle, UINT64 key_id, unsigned int slot, unsigned int access );
+
 
 NTSTATUS open_hkcu_key( const char *path, HANDLE *key )
 {
@@ -96,6 +98,7 @@ NTSTATUS WINAPI NtCreateKey( HANDLE *key, ACCESS_MASK access, const OBJECT_ATTRI
         if (class) wine_server_add_data( req, class->Buffer, class->Length );
         ret = wine_server_call( req );
         *key = wine_server_ptr_handle( reply->hkey );
+        if (!ret || ret == STATUS_OBJECT_NAME_EXISTS) add_reg_cache_handle( *key, reply->key_id, reply->slot, reply->access );
     }
     SERVER_END_REQ;
 
@@ -154,6 +157,7 @@ NTSTATUS WINAPI NtOpenKeyEx( HANDLE *key, ACCESS_MASK access, const OBJECT_ATTRI
         wine_server_add_data( req, attr->ObjectName->Buffer, attr->ObjectName->Length );
         ret = wine_server_call( req );
         *key = wine_server_ptr_handle( reply->hkey );
+        if (!ret) add_reg_cache_handle( *key, reply->key_id, reply->slot, reply->access );
     }
     SERVER_END_REQ;
     TRACE("<- %p\n", *key);
@@ -484,6 +488,254 @@ NTSTATUS WINAPI NtEnumerateValueKey( HANDLE handle, ULONG index, KEY_VALUE_INFOR
 }
 
 
+/* client-side cache of registry values
+ *
+ * Values are cached per key object and validated against the change serials
+ * that the server publishes in a shared mapping, so that repeated queries of
+ * rarely changing values don't need a server round-trip. The key objects of
+ * the open key handles are recorded when the handles are created, cached
+ * values outlive the handles that were used to retrieve them.
+ */
+
+#define REG_CACHE_BUCKETS    256   /* number of hash buckets */
+#define REG_CACHE_BUCKET_MAX 16    /* max number of cached values or handles per bucket */
+#define REG_CACHE_MAX_DATA   1024  /* max data size of a cached value */
+
+struct reg_cache_handle
+{
+    struct list    entry;     /* entry in the hash bucket */
+    HANDLE         handle;    /* key handle */
+    UINT64         key_id;    /* unique id of the key object */
+    unsigned int   slot;      /* key slot in the shared serials */
+    unsigned int   access;    /* access rights granted to the handle */
+};
+
+struct reg_cache_entry
+{
+    struct list    entry;     /* entry in the hash bucket */
+    UINT64         key_id;    /* unique id of the key object */
+    unsigned int   slot;      /* key slot in the shared serials */
+    UINT64         serial;    /* key serial at the time the value was retrieved */
+    unsigned int   status;    /* status of the query */
+    int            type;      /* value type */
+    data_size_t    total;     /* value data length */
+    USHORT         name_len;  /* value name length in bytes */
+    WCHAR          name[1];   /* value name, followed by the value data */
+};
+
+static const registry_shm_t *registry_shm;
+static struct list reg_cache[REG_CACHE_BUCKETS];
+static unsigned int reg_cache_count[REG_CACHE_BUCKETS];
+static struct list reg_cache_handles[REG_CACHE_BUCKETS];
+static unsigned int reg_cache_handle_count[REG_CACHE_BUCKETS];
+static pthread_mutex_t reg_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void init_reg_cache(void)
+{
+    HANDLE handle = 0;
+    SIZE_T size = 0;
+    void *ptr = NULL;
+    unsigned int i, status;
+
+    for (i = 0; i < REG_CACHE_BUCKETS; i++)
+    {
+        list_init( &reg_cache[i] );
+        list_init( &reg_cache_handles[i] );
+    }
+
+    SERVER_START_REQ( get_registry_mapping )
+    {
+        if (!(status = wine_server_call( req ))) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (status) return;
+
+    status = NtMapViewOfSection( handle, NtCurrentProcess(), &ptr, 0, 0, NULL, &size,
+                                 ViewShare, 0, PAGE_READONLY );
+    NtClose( handle );
+    if (status)
+    {
+        WARN( "failed to map registry serials, status %#x\n", status );
+        return;
+    }
+    registry_shm = ptr;
+}
+
+static BOOL use_reg_cache(void)
+{
+    static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+    pthread_once( &init_once, init_reg_cache );
+    return registry_shm != NULL;
+}
+
+static inline unsigned int reg_cache_handle_bucket( HANDLE handle )
+{
+    return (wine_server_obj_handle( handle ) >> 2) % REG_CACHE_BUCKETS;
+}
+
+static inline unsigned int reg_cache_bucket( UINT64 key_id )
+{
+    return key_id % REG_CACHE_BUCKETS;
+}
+
+static struct reg_cache_handle *find_reg_cache_handle( HANDLE handle )
+{
+    struct reg_cache_handle *entry;
+
+    LIST_FOR_EACH_ENTRY( entry, &reg_cache_handles[reg_cache_handle_bucket( handle )],
+                         struct reg_cache_handle, entry )
+        if (entry->handle == handle) return entry;
+    return NULL;
+}
+
+static void free_reg_cache_handle( struct reg_cache_handle *entry )
+{
+    reg_cache_handle_count[reg_cache_handle_bucket( entry->handle )]--;
+    list_remove( &entry->entry );
+    free( entry );
+}
+
+/* value names are case-insensitive and may contain embedded nulls */
+static int reg_cache_name_cmp( const WCHAR *str1, const WCHAR *str2, unsigned int len )
+{
+    unsigned int i;
+
+    for (i = 0; i < len; i++) if (towupper( str1[i] ) != towupper( str2[i] )) return 1;
+    return 0;
+}
+
+static struct reg_cache_entry *find_reg_cache_entry( UINT64 key_id, const UNICODE_STRING *name )
+{
+    struct reg_cache_entry *entry;
+
+    LIST_FOR_EACH_ENTRY( entry, &reg_cache[reg_cache_bucket( key_id )], struct reg_cache_entry, entry )
+    {
+        if (entry->key_id != key_id || entry->name_len != name->Length) continue;
+        if (!reg_cache_name_cmp( entry->name, name->Buffer, name->Length / sizeof(WCHAR) )) return entry;
+    }
+    return NULL;
+}
+
+static void free_reg_cache_entry( struct reg_cache_entry *entry )
+{
+    reg_cache_count[reg_cache_bucket( entry->key_id )]--;
+    list_remove( &entry->entry );
+    free( entry );
+}
+
+/* record the key object of a newly created key handle */
+static void add_reg_cache_handle( HANDLE handle, UINT64 key_id, unsigned int slot, unsigned int access )
+{
+    struct reg_cache_handle *entry, *old;
+    unsigned int bucket = reg_cache_handle_bucket( handle );
+    sigset_t sigset;
+
+    if (!key_id || !use_reg_cache()) return;
+    if (!(entry = malloc( sizeof(*entry) ))) return;
+    entry->handle = handle;
+    entry->key_id = key_id;
+    entry->slot   = slot;
+    entry->access = access;
+
+    server_enter_uninterrupted_section( &reg_cache_mutex, &sigset );
+    if ((old = find_reg_cache_handle( handle ))) free_reg_cache_handle( old );
+    if (reg_cache_handle_count[bucket] >= REG_CACHE_BUCKET_MAX)
+        free_reg_cache_handle( LIST_ENTRY( list_tail( &reg_cache_handles[bucket] ), struct reg_cache_handle, entry ));
+    list_add_head( &reg_cache_handles[bucket], &entry->entry );
+    reg_cache_handle_count[bucket]++;
+    server_leave_uninterrupted_section( &reg_cache_mutex, &sigset );
+}
+
+/* retrieve a value from the cache if it's still valid; returns FALSE if it needs to be fetched,
+ * in which case key_id is set to the key object of the handle, or 0 if the value can't be cached */
+static BOOL get_cached_value( HANDLE handle, const UNICODE_STRING *name, UINT64 *key_id, unsigned int *status,
+                              int *type, data_size_t *total, void *data, data_size_t size )
+{
+    struct reg_cache_handle *key;
+    struct reg_cache_entry *entry;
+    sigset_t sigset;
+    BOOL ret = FALSE;
+
+    *key_id = 0;
+    if (!use_reg_cache()) return FALSE;
+
+    server_enter_uninterrupted_section( &reg_cache_mutex, &sigset );
+    /* the server checks the access rights of handles that can't query values */
+    if ((key = find_reg_cache_handle( handle )) && !(key->access & KEY_QUERY_VALUE)) key = NULL;
+    if (key)
+    {
+        *key_id = key->key_id;
+        /* move it to the front of the bucket */
+        list_remove( &key->entry );
+        list_add_head( &reg_cache_handles[reg_cache_handle_bucket( handle )], &key->entry );
+    }
+    if (key && (entry = find_reg_cache_entry( key->key_id, name )))
+    {
+        if (ReadNoFence64( (volatile LONG64 *)&registry_shm->serials[entry->slot] ) == entry->serial)
+        {
+            *status = entry->status;
+            *type   = entry->type;
+            *total  = entry->total;
+            memcpy( data, (char *)entry->name + entry->name_len, min( size, entry->total ));
+            /* move it to the front of the bucket */
+            list_remove( &entry->entry );
+            list_add_head( &reg_cache[reg_cache_bucket( entry->key_id )], &entry->entry );
+            ret = TRUE;
+        }
+        else free_reg_cache_entry( entry );
+    }
+    server_leave_uninterrupted_section( &reg_cache_mutex, &sigset );
+    return ret;
+}
+
+/* add the result of a value query to the cache */
+static void cache_value( UINT64 key_id, const UNICODE_STRING *name, unsigned int status, int type,
+                         const void *data, data_size_t total, unsigned int slot, UINT64 serial )
+{
+    struct reg_cache_entry *entry, *old;
+    unsigned int bucket = reg_cache_bucket( key_id );
+    sigset_t sigset;
+
+    if (!registry_shm || slot >= REGISTRY_SHM_SLOTS || total > REG_CACHE_MAX_DATA) return;
+    if (!(entry = malloc( offsetof( struct reg_cache_entry, name[0] ) + name->Length + total ))) return;
+    entry->key_id   = key_id;
+    entry->slot     = slot;
+    entry->serial   = serial;
+    entry->status   = status;
+    entry->type     = type;
+    entry->total    = total;
+    entry->name_len = name->Length;
+    memcpy( entry->name, name->Buffer, name->Length );
+    if (total) memcpy( (char *)entry->name + name->Length, data, total );
+
+    server_enter_uninterrupted_section( &reg_cache_mutex, &sigset );
+    if ((old = find_reg_cache_entry( key_id, name ))) free_reg_cache_entry( old );
+    if (reg_cache_count[bucket] >= REG_CACHE_BUCKET_MAX)
+        free_reg_cache_entry( LIST_ENTRY( list_tail( &reg_cache[bucket] ), struct reg_cache_entry, entry ));
+    list_add_head( &reg_cache[bucket], &entry->entry );
+    reg_cache_count[bucket]++;
+    server_leave_uninterrupted_section( &reg_cache_mutex, &sigset );
+}
+
+/***********************************************************************
+ *           close_registry_cache
+ *
+ * Forget the key object of a key handle; called with signals blocked when the handle is closed.
+ * The cached values of the key are kept, they are validated by the key serial.
+ */
+void close_registry_cache( HANDLE handle )
+{
+    struct reg_cache_handle *entry;
+
+    if (!registry_shm || !reg_cache_handle_count[reg_cache_handle_bucket( handle )]) return;
+
+    pthread_mutex_lock( &reg_cache_mutex );
+    if ((entry = find_reg_cache_handle( handle ))) free_reg_cache_handle( entry );
+    pthread_mutex_unlock( &reg_cache_mutex );
+}
+
+
 /******************************************************************************
  *              NtQueryValueKey  (NTDLL.@)
  */
@@ -494,6 +746,10 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
     unsigned int ret;
     UCHAR *data_ptr;
     unsigned int fixed_size, min_size;
+    UCHAR buffer[REG_CACHE_MAX_DATA];
+    data_size_t total;
+    UINT64 key_id;
+    int type;
 
     TRACE( "(%p,%s,%d,%p,%d)\n", handle, debugstr_us(name), info_class, info, (int)length );
 
@@ -539,21 +795,38 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
         return STATUS_INVALID_PARAMETER;
     }
 
-    SERVER_START_REQ( get_key_value )
+    if (get_cached_value( handle, name, &key_id, &ret, &type, &total, buffer, sizeof(buffer) ))
     {
-        req->hkey = wine_server_obj_handle( handle );
-        wine_server_add_data( req, name->Buffer, name->Length );
-        if (length > fixed_size && data_ptr) wine_server_set_reply( req, data_ptr, length - fixed_size );
-        if (!(ret = wine_server_call( req )))
+        if (ret) return ret;
+        if (length > fixed_size && data_ptr) memcpy( data_ptr, buffer, min( length - fixed_size, total ));
+    }
+    else
+    {
+        SERVER_START_REQ( get_key_value )
         {
-            copy_key_value_info( info_class, info, length, reply->type,
-                                 name->Length, reply->total );
-            *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : reply->total);
-            if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
-            else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
+            req->hkey = wine_server_obj_handle( handle );
+            wine_server_add_data( req, name->Buffer, name->Length );
+            if (length > fixed_size && data_ptr) wine_server_set_reply( req, data_ptr, length - fixed_size );
+            ret = wine_server_call( req );
+            type  = reply->type;
+            total = reply->total;
+            /* the handle may have been closed and reused for another key in the meantime */
+            if (key_id && reply->key_id == key_id)
+            {
+                if (ret == STATUS_OBJECT_NAME_NOT_FOUND)
+                    cache_value( key_id, name, ret, type, NULL, 0, reply->slot, reply->serial );
+                else if (!ret && (!total || (data_ptr && wine_server_reply_size( reply ) == total)))
+                    cache_value( key_id, name, ret, type, data_ptr, total, reply->slot, reply->serial );
+            }
         }
+        SERVER_END_REQ;
+        if (ret) return ret;
     }
-    SERVER_END_REQ;
+
+    copy_key_value_info( info_class, info, length, type, name->Length, total );
+    *result_len = fixed_size + (info_class == KeyValueBasicInformation ? 0 : total);
+    if (length < min_size) ret = STATUS_BUFFER_TOO_SMALL;
+    else if (length < *result_len) ret = STATUS_BUFFER_OVERFLOW;
     return ret;
 }
 
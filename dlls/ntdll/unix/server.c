@@ -103,7 +103,7 @@ sigset_t server_block_set;  /* signals to block during server calls */
 static int fd_socket = -1;  /* socket to exchange file descriptors with the server */
 static int initial_cwd = -1;
 static pid_t server_pid;
-static pthread_mutex_t fd_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t fd_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* atomically exchange a 64-bit value */
 static inline LONG64 interlocked_xchg64( LONG64 *dest, LONG64 val )
@@ -1095,6 +1095,25 @@ static int remove_fd_from_cache( HANDLE handle )
 }
 
 
+/***********************************************************************
+ *           receive_handle_fd
+ *
+ * Receive the fd sent by the server along with a newly created handle.
+ * Caller must hold fd_cache_mutex.
+ */
+void receive_handle_fd( HANDLE handle, enum server_fd_type type, unsigned int access,
+                        unsigned int options )
+{
+    obj_handle_t fd_handle;
+    int fd;
+
+    if (type == FD_TYPE_INVALID) return;
+    if ((fd = receive_fd( &fd_handle )) == -1) return;
+    assert( wine_server_ptr_handle(fd_handle) == handle );
+    if (!add_fd_to_cache( handle, fd, type, access, options )) close( fd );
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -1798,7 +1817,11 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        close_inproc_sync( source );
+        close_registry_cache( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1810,6 +1833,8 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
         req->options     = options;
         if (!(ret = wine_server_call( req )))
         {
+            receive_handle_fd( wine_server_ptr_handle( reply->handle ), reply->fd_type,
+                               reply->fd_access, reply->fd_options );
             if (dest) *dest = wine_server_ptr_handle( reply->handle );
         }
     }
@@ -1869,6 +1894,8 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    close_inproc_sync( handle );
+    close_registry_cache( handle );
 
     SERVER_START_REQ( close_handle )
     {
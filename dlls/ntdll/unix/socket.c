@@ -837,12 +837,31 @@ static BOOL is_icmp_over_dgram( int fd )
 #endif
 }
 
+/* check if the server allows completing an I/O on the socket without queuing an async;
+ * the socket state is only shared once the server has seen a recv or send request */
+static BOOL sock_can_complete_inproc( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc,
+                                      unsigned int flag, unsigned int *state )
+{
+    if (apc || in_wow64_call()) return FALSE;
+    if (!(*state = get_inproc_socket_state( handle )) || !(*state & flag)) return FALSE;
+    /* without an event, the server would signal the socket handle instead */
+    return event || (*state & INPROC_SOCKET_SKIP_SIGNAL);
+}
+
+/* signal the completion of an I/O that was performed without the server */
+static void sock_complete_inproc( HANDLE handle, HANDLE event, void *apc_user, IO_STATUS_BLOCK *io,
+                                  unsigned int state, NTSTATUS status, ULONG_PTR information )
+{
+    if (state & INPROC_SOCKET_SKIP_PORT) apc_user = NULL;
+    file_complete_async( handle, 0, event, NULL, apc_user, io, status, information );
+}
+
 static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *io,
                            int fd, struct async_recv_ioctl *async, int force_async )
 {
     HANDLE wait_handle;
     BOOL nonblocking;
-    unsigned int i, status;
+    unsigned int i, status, state;
     ULONG options;
 
     for (i = 0; i < async->count; ++i)
@@ -854,6 +873,23 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         }
     }
 
+    if (!(async->unix_flags & MSG_OOB) && sock_can_complete_inproc( handle, event, apc, INPROC_SOCKET_RECV, &state ))
+    {
+        ULONG_PTR information;
+
+        status = try_recv( fd, async, &information );
+        if (status == STATUS_DEVICE_NOT_READY && (force_async || !(state & INPROC_SOCKET_NONBLOCKING)))
+            status = STATUS_PENDING;  /* let the server queue the async */
+        else if (!NT_ERROR(status))
+            sock_complete_inproc( handle, event, apc_user, io, state, status, information );
+
+        if (status != STATUS_PENDING)
+        {
+            release_fileio( &async->io );
+            return status;
+        }
+    }
+
     SERVER_START_REQ( recv_socket )
     {
         req->force_async = force_async;
@@ -863,6 +899,7 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         wait_handle = wine_server_ptr_handle( reply->wait );
         options     = reply->options;
         nonblocking = reply->nonblocking;
+        cache_inproc_socket( handle, reply->sync_offset );
     }
     SERVER_END_REQ;
 
@@ -1109,9 +1146,22 @@ static NTSTATUS sock_send( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
 {
     HANDLE wait_handle;
     BOOL nonblocking;
-    unsigned int status;
+    unsigned int status, state;
     ULONG options;
 
+    if (!(server_flags & SERVER_SOCKET_IO_SYSTEM) &&
+        sock_can_complete_inproc( handle, event, apc, INPROC_SOCKET_SEND, &state ))
+    {
+        /* failures and short writes are left to the server, which needs to reset the write events */
+        if ((status = try_send( fd, async )) == STATUS_SUCCESS)
+        {
+            sock_complete_inproc( handle, event, apc_user, io, state, status, async->sent_len );
+            if (async->fd != -1) close( async->fd );
+            release_fileio( &async->io );
+            return status;
+        }
+    }
+
     SERVER_START_REQ( send_socket )
     {
         req->flags = server_flags;
@@ -1120,6 +1170,7 @@ static NTSTATUS sock_send( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         wait_handle = wine_server_ptr_handle( reply->wait );
         options     = reply->options;
         nonblocking = reply->nonblocking;
+        cache_inproc_socket( handle, reply->sync_offset );
     }
     SERVER_END_REQ;
 
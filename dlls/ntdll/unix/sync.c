@@ -301,6 +301,292 @@ static unsigned int validate_open_object_attributes( const OBJECT_ATTRIBUTES *at
 }
 
 
+/* in-process synchronization objects
+ *
+ * Events, semaphores and mutexes created by this process may have their state
+ * stored in a block shared with the server. As long as the server has no
+ * waiters queued on an object, its state can be changed and consumed with
+ * atomic operations without a server round-trip; everything that may need to
+ * block or wake up another thread is left to the server.
+ */
+
+#define INPROC_SYNC_CACHE_BLOCK_SIZE (65536 / sizeof(LONG))
+#define INPROC_SYNC_CACHE_ENTRIES    128
+
+static inproc_sync_t *inproc_sync_data;     /* shared block, NULL if disabled */
+static data_size_t inproc_sync_size;        /* size of the shared block */
+static LONG *inproc_sync_cache[INPROC_SYNC_CACHE_ENTRIES];  /* handle to object offset cache */
+
+static void init_inproc_sync(void)
+{
+    const char *env = getenv( "WINEINPROCSYNC" );
+    HANDLE handle = 0;
+    SIZE_T size = 0;
+    void *ptr = NULL;
+    unsigned int status;
+
+    if (!env || !atoi( env )) return;
+
+    SERVER_START_REQ( get_inproc_sync_mapping )
+    {
+        if (!(status = wine_server_call( req ))) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (status) return;
+
+    status = NtMapViewOfSection( handle, NtCurrentProcess(), &ptr, 0, 0, NULL, &size,
+                                 ViewShare, 0, PAGE_READWRITE );
+    NtClose( handle );
+    if (status)
+    {
+        WARN( "failed to map in-process sync block, status %#x\n", status );
+        return;
+    }
+    TRACE( "in-process sync block at %p size %#lx\n", ptr, size );
+    inproc_sync_size = size;
+    inproc_sync_data = ptr;
+}
+
+static BOOL use_inproc_sync(void)
+{
+    static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+    pthread_once( &init_once, init_inproc_sync );
+    return inproc_sync_data != NULL;
+}
+
+static inline unsigned int inproc_sync_cache_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / INPROC_SYNC_CACHE_BLOCK_SIZE;
+    return idx % INPROC_SYNC_CACHE_BLOCK_SIZE;
+}
+
+static void cache_inproc_sync( HANDLE handle, data_size_t offset )
+{
+    unsigned int entry, idx = inproc_sync_cache_index( handle, &entry );
+
+    if (!offset || offset > inproc_sync_size - sizeof(inproc_sync_t)) return;
+    if (entry >= INPROC_SYNC_CACHE_ENTRIES) return;
+    if (!inproc_sync_cache[entry])
+    {
+        static const size_t size = INPROC_SYNC_CACHE_BLOCK_SIZE * sizeof(LONG);
+        void *ptr = anon_mmap_alloc( size, PROT_READ | PROT_WRITE );
+
+        if (ptr == MAP_FAILED) return;
+        if (InterlockedCompareExchangePointer( (void **)&inproc_sync_cache[entry], ptr, NULL ))
+            munmap( ptr, size ); /* someone beat us to it */
+    }
+    InterlockedExchange( &inproc_sync_cache[entry][idx], offset );
+}
+
+/***********************************************************************
+ *           close_inproc_sync
+ *
+ * Remove a handle from the in-process sync cache; called when the handle is closed.
+ */
+void close_inproc_sync( HANDLE handle )
+{
+    unsigned int entry, idx = inproc_sync_cache_index( handle, &entry );
+
+    if (entry < INPROC_SYNC_CACHE_ENTRIES && inproc_sync_cache[entry])
+        InterlockedExchange( &inproc_sync_cache[entry][idx], 0 );
+}
+
+static inproc_sync_t *get_inproc_sync( HANDLE handle, unsigned int type )
+{
+    unsigned int entry, idx = inproc_sync_cache_index( handle, &entry );
+    inproc_sync_t *sync;
+    LONG offset;
+
+    if (entry >= INPROC_SYNC_CACHE_ENTRIES || !inproc_sync_cache[entry]) return NULL;
+    if (!(offset = ReadNoFence( &inproc_sync_cache[entry][idx] ))) return NULL;
+    sync = (inproc_sync_t *)((char *)inproc_sync_data + offset);
+    if (type == INPROC_SYNC_AUTO_EVENT && sync->type == INPROC_SYNC_MANUAL_EVENT) return sync;
+    if (type != INPROC_SYNC_NONE && sync->type != type) return NULL;
+    return sync;
+}
+
+static inline ULONG64 get_inproc_state( inproc_sync_t *sync )
+{
+    return ReadNoFence64( (volatile LONG64 *)&sync->state );
+}
+
+/* atomically replace the object state; fails if the state changed or the server has waiters */
+static inline BOOL replace_inproc_state( inproc_sync_t *sync, ULONG64 old, ULONG64 new )
+{
+    return InterlockedCompareExchange64( (volatile LONG64 *)&sync->state, new, old ) == old;
+}
+
+/* set the state of an event, returns FALSE if the server needs to handle it */
+static BOOL inproc_set_event( HANDLE handle, ULONG64 new_state, LONG *prev_state )
+{
+    inproc_sync_t *sync;
+    ULONG64 state;
+
+    if (!(sync = get_inproc_sync( handle, INPROC_SYNC_AUTO_EVENT ))) return FALSE;
+    do
+    {
+        state = get_inproc_state( sync );
+        if (state & INPROC_SYNC_SERVER_WAIT) return FALSE;
+    } while (state != new_state && !replace_inproc_state( sync, state, new_state ));
+
+    if (prev_state) *prev_state = state;
+    return TRUE;
+}
+
+/* release a semaphore, returns FALSE if the server needs to handle it */
+static BOOL inproc_release_semaphore( HANDLE handle, ULONG count, ULONG *previous, unsigned int *ret )
+{
+    inproc_sync_t *sync;
+    ULONG64 state;
+
+    if (!(sync = get_inproc_sync( handle, INPROC_SYNC_SEMAPHORE ))) return FALSE;
+    do
+    {
+        state = get_inproc_state( sync );
+        if (state & INPROC_SYNC_SERVER_WAIT) return FALSE;
+        if (count > sync->max - state)
+        {
+            *ret = STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+            return TRUE;
+        }
+    } while (!replace_inproc_state( sync, state, state + count ));
+
+    if (previous) *previous = state;
+    *ret = STATUS_SUCCESS;
+    return TRUE;
+}
+
+/* release a mutex, returns FALSE if the server needs to handle it */
+static BOOL inproc_release_mutex( HANDLE handle, LONG *prev_count, unsigned int *ret )
+{
+    ULONG tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    inproc_sync_t *sync;
+    ULONG64 state, new_state;
+    unsigned int count;
+
+    if (!(sync = get_inproc_sync( handle, INPROC_SYNC_MUTEX ))) return FALSE;
+    do
+    {
+        state = get_inproc_state( sync );
+        if (state & INPROC_SYNC_SERVER_WAIT) return FALSE;
+        count = (state >> INPROC_SYNC_MUTEX_COUNT_SHIFT) & INPROC_SYNC_MUTEX_COUNT_MAX;
+        if (!count || (state & INPROC_SYNC_MUTEX_OWNER) != tid)
+        {
+            *ret = STATUS_MUTANT_NOT_OWNED;
+            return TRUE;
+        }
+        if (count == 1) new_state = 0;
+        else new_state = state - ((ULONG64)1 << INPROC_SYNC_MUTEX_COUNT_SHIFT);
+    } while (!replace_inproc_state( sync, state, new_state ));
+
+    if (prev_count) *prev_count = 1 - count;
+    *ret = STATUS_SUCCESS;
+    return TRUE;
+}
+
+/* try to satisfy a wait on a single object without blocking, returns FALSE if the server needs to handle it */
+static BOOL inproc_wait( HANDLE handle, unsigned int *ret )
+{
+    ULONG tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    inproc_sync_t *sync;
+    ULONG64 state, new_state;
+    unsigned int count;
+
+    if (!(sync = get_inproc_sync( handle, INPROC_SYNC_NONE ))) return FALSE;
+    do
+    {
+        state = get_inproc_state( sync );
+        if (state & INPROC_SYNC_SERVER_WAIT) return FALSE;
+        *ret = STATUS_WAIT_0;
+
+        switch (sync->type)
+        {
+        case INPROC_SYNC_AUTO_EVENT:
+            if (!state) goto not_signaled;
+            new_state = 0;
+            break;
+        case INPROC_SYNC_MANUAL_EVENT:
+            if (!state) goto not_signaled;
+            return TRUE;
+        case INPROC_SYNC_SEMAPHORE:
+            if (!state) goto not_signaled;
+            new_state = state - 1;
+            break;
+        case INPROC_SYNC_MUTEX:
+            count = (state >> INPROC_SYNC_MUTEX_COUNT_SHIFT) & INPROC_SYNC_MUTEX_COUNT_MAX;
+            if (!count)
+            {
+                if (state & INPROC_SYNC_MUTEX_ABANDONED) *ret = STATUS_ABANDONED_WAIT_0;
+                new_state = tid | ((ULONG64)1 << INPROC_SYNC_MUTEX_COUNT_SHIFT);
+                break;
+            }
+            if ((state & INPROC_SYNC_MUTEX_OWNER) != tid) goto not_signaled;
+            if (count == INPROC_SYNC_MUTEX_COUNT_MAX) return FALSE;
+            new_state = state + ((ULONG64)1 << INPROC_SYNC_MUTEX_COUNT_SHIFT);
+            break;
+        default:
+            return FALSE;
+        }
+    } while (!replace_inproc_state( sync, state, new_state ));
+    return TRUE;
+
+not_signaled:
+    *ret = STATUS_TIMEOUT;
+    return TRUE;
+}
+
+/***********************************************************************
+ *           cache_inproc_socket
+ *
+ * Remember the location of the shared state of a socket, as returned by the server.
+ */
+void cache_inproc_socket( HANDLE handle, data_size_t offset )
+{
+    if (inproc_sync_data) cache_inproc_sync( handle, offset );
+}
+
+/***********************************************************************
+ *           get_inproc_socket_state
+ *
+ * Get the INPROC_SOCKET_* flags of a socket, or 0 if they are not shared with us.
+ */
+unsigned int get_inproc_socket_state( HANDLE handle )
+{
+    inproc_sync_t *sync;
+
+    if (!use_inproc_sync()) return 0;
+    if (!(sync = get_inproc_sync( handle, INPROC_SYNC_SOCKET ))) return 0;
+    return get_inproc_state( sync );
+}
+
+/***********************************************************************
+ *           cache_inproc_file
+ *
+ * Remember the location of the shared state of a file, as returned by the server.
+ */
+void cache_inproc_file( HANDLE handle, data_size_t offset )
+{
+    if (inproc_sync_data) cache_inproc_sync( handle, offset );
+}
+
+/***********************************************************************
+ *           inproc_file_may_have_completion
+ *
+ * Check if completions of a file need to be sent to the server, i.e. unless
+ * the server told us that no completion port is attached to it.
+ */
+BOOL inproc_file_may_have_completion( HANDLE handle )
+{
+    inproc_sync_t *sync;
+
+    if (!use_inproc_sync()) return TRUE;
+    if (!(sync = get_inproc_sync( handle, INPROC_SYNC_FILE ))) return TRUE;
+    return (get_inproc_state( sync ) & INPROC_FILE_COMPLETION) != 0;
+}
+
+
 /******************************************************************************
  *              NtCreateSemaphore (NTDLL.@)
  */
@@ -314,6 +600,7 @@ NTSTATUS WINAPI NtCreateSemaphore( HANDLE *handle, ACCESS_MASK access, const OBJ
     *handle = 0;
     if (max <= 0 || initial < 0 || initial > max) return STATUS_INVALID_PARAMETER;
     if ((ret = alloc_object_attributes( attr, &objattr, &len ))) return ret;
+    use_inproc_sync();
 
     SERVER_START_REQ( create_semaphore )
     {
@@ -323,6 +610,7 @@ NTSTATUS WINAPI NtCreateSemaphore( HANDLE *handle, ACCESS_MASK access, const OBJ
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_inproc_sync( *handle, reply->sync_offset );
     }
     SERVER_END_REQ;
 
@@ -364,6 +652,7 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 {
     unsigned int ret;
     SEMAPHORE_BASIC_INFORMATION *out = info;
+    inproc_sync_t *sync;
 
     TRACE("(%p, %u, %p, %u, %p)\n", handle, class, info, (int)len, ret_len);
 
@@ -375,6 +664,14 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 
     if (len != sizeof(SEMAPHORE_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((sync = get_inproc_sync( handle, INPROC_SYNC_SEMAPHORE )))
+    {
+        out->CurrentCount = get_inproc_state( sync ) & ~INPROC_SYNC_SERVER_WAIT;
+        out->MaximumCount = sync->max;
+        if (ret_len) *ret_len = sizeof(SEMAPHORE_BASIC_INFORMATION);
+        return STATUS_SUCCESS;
+    }
+
     SERVER_START_REQ( query_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -397,6 +694,8 @@ NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, ULONG *previous
 {
     unsigned int ret;
 
+    if (inproc_release_semaphore( handle, count, previous, &ret )) return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -424,6 +723,7 @@ NTSTATUS WINAPI NtCreateEvent( HANDLE *handle, ACCESS_MASK access, const OBJECT_
     *handle = 0;
     if (type != NotificationEvent && type != SynchronizationEvent) return STATUS_INVALID_PARAMETER;
     if ((ret = alloc_object_attributes( attr, &objattr, &len ))) return ret;
+    use_inproc_sync();
 
     SERVER_START_REQ( create_event )
     {
@@ -433,6 +733,7 @@ NTSTATUS WINAPI NtCreateEvent( HANDLE *handle, ACCESS_MASK access, const OBJECT_
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_inproc_sync( *handle, reply->sync_offset );
     }
     SERVER_END_REQ;
 
@@ -473,6 +774,8 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, LONG *prev_state )
 {
     unsigned int ret;
 
+    if (inproc_set_event( handle, 1, prev_state )) return STATUS_SUCCESS;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -492,6 +795,8 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, LONG *prev_state )
 {
     unsigned int ret;
 
+    if (inproc_set_event( handle, 0, prev_state )) return STATUS_SUCCESS;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -541,6 +846,7 @@ NTSTATUS WINAPI NtQueryEvent( HANDLE handle, EVENT_INFORMATION_CLASS class,
 {
     unsigned int ret;
     EVENT_BASIC_INFORMATION *out = info;
+    inproc_sync_t *sync;
 
     TRACE("(%p, %u, %p, %u, %p)\n", handle, class, info, (int)len, ret_len);
 
@@ -552,6 +858,14 @@ NTSTATUS WINAPI NtQueryEvent( HANDLE handle, EVENT_INFORMATION_CLASS class,
 
     if (len != sizeof(EVENT_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((sync = get_inproc_sync( handle, INPROC_SYNC_AUTO_EVENT )))
+    {
+        out->EventType  = sync->type == INPROC_SYNC_MANUAL_EVENT ? NotificationEvent : SynchronizationEvent;
+        out->EventState = (get_inproc_state( sync ) & ~INPROC_SYNC_SERVER_WAIT) != 0;
+        if (ret_len) *ret_len = sizeof(EVENT_BASIC_INFORMATION);
+        return STATUS_SUCCESS;
+    }
+
     SERVER_START_REQ( query_event )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -579,6 +893,7 @@ NTSTATUS WINAPI NtCreateMutant( HANDLE *handle, ACCESS_MASK access, const OBJECT
 
     *handle = 0;
     if ((ret = alloc_object_attributes( attr, &objattr, &len ))) return ret;
+    use_inproc_sync();
 
     SERVER_START_REQ( create_mutex )
     {
@@ -587,6 +902,7 @@ NTSTATUS WINAPI NtCreateMutant( HANDLE *handle, ACCESS_MASK access, const OBJECT
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_inproc_sync( *handle, reply->sync_offset );
     }
     SERVER_END_REQ;
 
@@ -627,6 +943,8 @@ NTSTATUS WINAPI NtReleaseMutant( HANDLE handle, LONG *prev_count )
 {
     unsigned int ret;
 
+    if (inproc_release_mutex( handle, prev_count, &ret )) return ret;
+
     SERVER_START_REQ( release_mutex )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -646,6 +964,7 @@ NTSTATUS WINAPI NtQueryMutant( HANDLE handle, MUTANT_INFORMATION_CLASS class,
 {
     unsigned int ret;
     MUTANT_BASIC_INFORMATION *out = info;
+    inproc_sync_t *sync;
 
     TRACE("(%p, %u, %p, %u, %p)\n", handle, class, info, (int)len, ret_len);
 
@@ -657,6 +976,18 @@ NTSTATUS WINAPI NtQueryMutant( HANDLE handle, MUTANT_INFORMATION_CLASS class,
 
     if (len != sizeof(MUTANT_BASIC_INFORMATION)) return STATUS_INFO_LENGTH_MISMATCH;
 
+    if ((sync = get_inproc_sync( handle, INPROC_SYNC_MUTEX )))
+    {
+        ULONG64 state = get_inproc_state( sync );
+        unsigned int count = (state >> INPROC_SYNC_MUTEX_COUNT_SHIFT) & INPROC_SYNC_MUTEX_COUNT_MAX;
+
+        out->CurrentCount   = 1 - count;
+        out->OwnedByCaller  = count && (state & INPROC_SYNC_MUTEX_OWNER) == HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+        out->AbandonedState = (state & INPROC_SYNC_MUTEX_ABANDONED) != 0;
+        if (ret_len) *ret_len = sizeof(MUTANT_BASIC_INFORMATION);
+        return STATUS_SUCCESS;
+    }
+
     SERVER_START_REQ( query_mutex )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -1577,6 +1908,21 @@ NTSTATUS WINAPI NtWaitForMultipleObjects( DWORD count, const HANDLE *handles, BO
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    if (count == 1 && !alertable)
+    {
+        unsigned int ret;
+
+        if (inproc_wait( handles[0], &ret ))
+        {
+            if (ret != STATUS_TIMEOUT) return ret;
+            if (timeout && !timeout->QuadPart)
+            {
+                NtYieldExecution();
+                return ret;
+            }
+        }
+    }
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -2085,9 +2431,10 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE handle, ULONG_PTR *key, ULONG_PTR *
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
+    struct completion_msg msgs[64];
     HANDLE wait_handle = NULL;
     unsigned int status;
-    ULONG i = 0;
+    ULONG i = 0, j, extra;
 
     TRACE( "%p %p %u %p %p %u\n", handle, info, (int)count, written, timeout, alertable );
 
@@ -2095,22 +2442,34 @@ NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORM
 
     while (i < count)
     {
+        extra = 0;
         SERVER_START_REQ( remove_completion )
         {
             req->handle = wine_server_obj_handle( handle );
             req->alertable = alertable;
+            wine_server_set_reply( req, msgs, min( count - i - 1, ARRAY_SIZE(msgs) ) * sizeof(msgs[0]) );
             if (!(status = wine_server_call( req )))
             {
                 info[i].CompletionKey             = reply->ckey;
                 info[i].CompletionValue           = reply->cvalue;
                 info[i].IoStatusBlock.Information = reply->information;
                 info[i].IoStatusBlock.Status      = reply->status;
+                extra = wine_server_reply_size( reply ) / sizeof(msgs[0]);
             }
             else wait_handle = wine_server_ptr_handle( reply->wait_handle );
         }
         SERVER_END_REQ;
         if (status != STATUS_SUCCESS) break;
         ++i;
+        for (j = 0; j < extra; j++, i++)
+        {
+            info[i].CompletionKey             = msgs[j].ckey;
+            info[i].CompletionValue           = msgs[j].cvalue;
+            info[i].IoStatusBlock.Information = msgs[j].information;
+            info[i].IoStatusBlock.Status      = msgs[j].status;
+        }
+        /* the server returns everything that was queued when the reply buffer is not full */
+        if (extra < ARRAY_SIZE(msgs)) break;
     }
     if (i || (status != STATUS_PENDING && status != STATUS_USER_APC))
     {
@@ -182,6 +182,7 @@ extern BOOL process_exiting;
 extern HANDLE keyed_event;
 extern timeout_t server_start_time;
 extern sigset_t server_block_set;
+extern pthread_mutex_t fd_cache_mutex;
 extern struct _KUSER_SHARED_DATA *user_shared_data;
 extern SYSTEM_CPU_INFORMATION cpu_info;
 #ifdef __i386__
@@ -217,6 +218,8 @@ extern unsigned int server_queue_process_apc( HANDLE process, const union apc_ca
                                               union apc_result *result );
 extern int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options );
+extern void receive_handle_fd( HANDLE handle, enum server_fd_type type, unsigned int access,
+                               unsigned int options );
 extern void wine_server_send_fd( int fd );
 extern void process_exit_wrapper( int status ) DECLSPEC_NORETURN;
 extern size_t server_init_process(void);
@@ -263,6 +266,11 @@ extern NTSTATUS set_thread_context( HANDLE handle, const void *context, BOOL *se
 extern NTSTATUS get_thread_context( HANDLE handle, void *context, BOOL *self, USHORT machine );
 extern unsigned int alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct object_attributes **ret,
                                              data_size_t *ret_len );
+extern void close_inproc_sync( HANDLE handle );
+extern void cache_inproc_socket( HANDLE handle, data_size_t offset );
+extern unsigned int get_inproc_socket_state( HANDLE handle );
+extern void cache_inproc_file( HANDLE handle, data_size_t offset );
+extern BOOL inproc_file_may_have_completion( HANDLE handle );
 extern NTSTATUS system_time_precise( void *args );
 
 extern void *anon_mmap_fixed( void *start, size_t size, int prot, int flags );
@@ -326,6 +334,7 @@ extern NTSTATUS get_thread_wow64_context( HANDLE handle, void *ctx, ULONG size )
 extern NTSTATUS set_thread_wow64_context( HANDLE handle, const void *ctx, ULONG size );
 extern void fill_vm_counters( VM_COUNTERS_EX *pvmi, int unix_pid );
 extern NTSTATUS open_hkcu_key( const char *path, HANDLE *key );
+extern void close_registry_cache( HANDLE handle );
 
 extern NTSTATUS sync_ioctl( HANDLE file, ULONG code, void *in_buffer, ULONG in_size,
                             void *out_buffer, ULONG out_size );
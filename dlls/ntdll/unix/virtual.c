@@ -42,6 +42,10 @@
 #ifdef HAVE_SYS_SYSCALL_H
 # include <sys/syscall.h>
 #endif
+#ifdef HAVE_LINUX_USERFAULTFD_H
+# include <sys/ioctl.h>
+# include <linux/userfaultfd.h>
+#endif
 #ifdef HAVE_SYS_SYSCTL_H
 # include <sys/sysctl.h>
 #endif
@@ -133,6 +137,7 @@ struct file_view
 #define VPROT_SYSTEM           0x0200  /* system view (underlying mmap not under our control) */
 #define VPROT_PLACEHOLDER      0x0400
 #define VPROT_FREE_PLACEHOLDER 0x0800
+#define VPROT_KERNEL_WRITEWATCH 0x1000  /* write watches are tracked by the kernel */
 
 /* Conversion from VPROT_* to Win32 flags */
 static const BYTE VIRTUAL_Win32Flags[16] =
@@ -157,6 +162,8 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 
 static struct wine_rb_tree views_tree;
 static pthread_mutex_t virtual_mutex;
+static unsigned int virtual_mutex_depth;  /* recursion count of virtual_mutex, protected by it */
+static LONG views_seq;  /* odd while views or page protections are being modified */
 
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
@@ -216,6 +223,7 @@ static void *preload_reserve_start;
 static void *preload_reserve_end;
 static BOOL force_exec_prot;  /* whether to force PROT_EXEC on all PROT_READ mmaps */
 static BOOL enable_write_exceptions;  /* raise exception on writes to executable memory */
+static BOOL use_huge_pages;  /* use transparent huge pages for large anonymous allocations */
 
 struct range_entry
 {
@@ -226,6 +234,71 @@ struct range_entry
 static struct range_entry *free_ranges;
 static struct range_entry *free_ranges_end;
 
+#if defined(__i386__) || defined(__x86_64__)
+/* this prevents compilers from reordering the reads of the views against the sequence checks */
+#define VIEWS_READ_FENCE do { __asm__ __volatile__( "" ::: "memory" ); } while (0)
+#else
+#define VIEWS_READ_FENCE __atomic_thread_fence( __ATOMIC_ACQUIRE )
+#endif
+
+
+/***********************************************************************
+ *           start_views_update
+ *
+ * Mark the views and page protections as being modified, so that lock-free
+ * readers retry. virtual_mutex must be held by caller; the update is
+ * published when the outermost lock is released.
+ */
+static inline void start_views_update(void)
+{
+    if (!(views_seq & 1)) InterlockedIncrement( &views_seq );
+}
+
+
+/***********************************************************************
+ *           lock_virtual
+ */
+static inline void lock_virtual( sigset_t *sigset )
+{
+    server_enter_uninterrupted_section( &virtual_mutex, sigset );
+    virtual_mutex_depth++;
+}
+
+
+/***********************************************************************
+ *           unlock_virtual
+ */
+static inline void unlock_virtual( sigset_t *sigset )
+{
+    if (!--virtual_mutex_depth && (views_seq & 1)) InterlockedIncrement( &views_seq );
+    server_leave_uninterrupted_section( &virtual_mutex, sigset );
+}
+
+
+/***********************************************************************
+ *           views_read_begin
+ *
+ * Start a lock-free read of the views; returns FALSE if an update is in progress.
+ */
+static inline BOOL views_read_begin( LONG *seq )
+{
+    *seq = ReadNoFence( &views_seq );
+    VIEWS_READ_FENCE;
+    return !(*seq & 1);
+}
+
+
+/***********************************************************************
+ *           views_read_end
+ *
+ * Check that the views didn't change during a lock-free read.
+ */
+static inline BOOL views_read_end( LONG seq )
+{
+    VIEWS_READ_FENCE;
+    return ReadNoFence( &views_seq ) == seq;
+}
+
 
 static inline BOOL is_beyond_limit( const void *addr, size_t size, const void *limit )
 {
@@ -629,7 +702,7 @@ void *get_builtin_so_handle( void *module )
     void *ret = NULL;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -637,7 +710,7 @@ void *get_builtin_so_handle( void *module )
         if (ret) builtin->refcount++;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return ret;
 }
 
@@ -652,7 +725,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, const void **fun
     NTSTATUS status = STATUS_DLL_NOT_FOUND;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -669,7 +742,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, const void **fun
         }
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -683,7 +756,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
     NTSTATUS status = STATUS_SUCCESS;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -691,7 +764,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
         else status = STATUS_IMAGE_ALREADY_LOADED;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -965,6 +1038,7 @@ static void set_page_vprot( const void *addr, size_t size, BYTE vprot )
     size_t idx = (size_t)addr >> page_shift;
     size_t end = ((size_t)addr + size + page_mask) >> page_shift;
 
+    start_views_update();
 #ifdef _WIN64
     while (idx >> pages_vprot_shift != end >> pages_vprot_shift)
     {
@@ -989,6 +1063,7 @@ static void set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE c
     size_t idx = (size_t)addr >> page_shift;
     size_t end = ((size_t)addr + size + page_mask) >> page_shift;
 
+    start_views_update();
 #ifdef _WIN64
     for ( ; idx < end; idx++)
     {
@@ -1017,6 +1092,7 @@ static BOOL set_page_vprot_exec_write_protect( const void *addr, size_t size )
     {
         BYTE *ptr = pages_vprot[idx >> pages_vprot_shift] + (idx & pages_vprot_mask);
         if (!is_vprot_exec_write( *ptr )) continue;
+        start_views_update();
         *ptr |= VPROT_WRITEWATCH;
         ret = TRUE;
     }
@@ -1202,12 +1278,12 @@ static void VIRTUAL_Dump(void)
     struct file_view *view;
 
     TRACE( "Dump of all virtual memory views:\n" );
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         dump_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 }
 #endif
 
@@ -1253,6 +1329,16 @@ static inline BOOL is_write_watch_range( const void *addr, size_t size )
 }
 
 
+/***********************************************************************
+ *           is_kernel_write_watch_range
+ */
+static inline BOOL is_kernel_write_watch_range( const void *addr, size_t size )
+{
+    struct file_view *view = find_view( addr, size );
+    return view && (view->protect & VPROT_KERNEL_WRITEWATCH);
+}
+
+
 /***********************************************************************
  *           find_view_range
  *
@@ -1558,6 +1644,7 @@ static void free_view( struct file_view *view )
  */
 static void unregister_view( struct file_view *view )
 {
+    start_views_update();
     if (mmap_is_in_reserved_area( view->base, view->size ))
         free_ranges_remove_view( view );
     wine_rb_remove( &views_tree, &view->entry );
@@ -1586,6 +1673,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
  */
 static void register_view( struct file_view *view )
 {
+    start_views_update();
     wine_rb_put( &views_tree, view->base, &view->entry );
     if (mmap_is_in_reserved_area( view->base, view->size ))
         free_ranges_insert_view( view );
@@ -1811,11 +1899,229 @@ static void commit_arm64ec_map( struct file_view *view )
     size_t size = ROUND_SIZE( start, end + 1 - start );
     void *base = ROUND_ADDR( (char *)arm64ec_view->base + start, page_mask );
 
+    start_views_update();
     view->protect |= VPROT_ARM64EC;
     set_vprot( arm64ec_view, base, size, VPROT_READ | VPROT_WRITE | VPROT_COMMITTED );
 }
 
 
+#if defined(HAVE_LINUX_USERFAULTFD_H) && defined(__NR_userfaultfd) && defined(UFFDIO_WRITEPROTECT)
+
+/* definitions from linux/fs.h and linux/userfaultfd.h, for older headers */
+#ifndef PAGEMAP_SCAN
+#define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#define PAGE_IS_WRITTEN       (1 << 1)
+#define PM_SCAN_WP_MATCHING   (1 << 0)
+struct page_region
+{
+    __u64 start;
+    __u64 end;
+    __u64 categories;
+};
+struct pm_scan_arg
+{
+    __u64 size;
+    __u64 flags;
+    __u64 start;
+    __u64 end;
+    __u64 walk_end;
+    __u64 vec;
+    __u64 vec_len;
+    __u64 max_pages;
+    __u64 category_inverted;
+    __u64 category_mask;
+    __u64 category_anyof_mask;
+    __u64 return_mask;
+};
+#endif
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY 1
+#endif
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC       (1 << 15)
+#endif
+
+static int uffd_fd = -1;          /* userfaultfd write protecting the write watch views */
+static int pagemap_scan_fd = -1;  /* /proc/self/pagemap, used to scan for written pages */
+
+/***********************************************************************
+ *           init_kernel_write_watches
+ *
+ * Check if the kernel supports tracking written pages with asynchronous
+ * userfaultfd write protection, which avoids taking a fault on the first
+ * write to every watched page.
+ */
+static void init_kernel_write_watches(void)
+{
+    static const __u64 features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+    struct uffdio_api api;
+    struct pm_scan_arg arg;
+
+    if ((uffd_fd = syscall( __NR_userfaultfd, UFFD_USER_MODE_ONLY | O_CLOEXEC | O_NONBLOCK )) == -1) return;
+
+    memset( &api, 0, sizeof(api) );
+    api.api = UFFD_API;
+    api.features = features;
+    if (ioctl( uffd_fd, UFFDIO_API, &api ) || (api.features & features) != features) goto failed;
+
+    if ((pagemap_scan_fd = open( "/proc/self/pagemap", O_RDONLY | O_CLOEXEC )) == -1) goto failed;
+    memset( &arg, 0, sizeof(arg) );
+    arg.size = sizeof(arg);
+    if (ioctl( pagemap_scan_fd, PAGEMAP_SCAN, &arg ) == -1) goto failed;
+
+    TRACE( "using kernel write watches\n" );
+    return;
+
+failed:
+    if (pagemap_scan_fd != -1) close( pagemap_scan_fd );
+    close( uffd_fd );
+    uffd_fd = pagemap_scan_fd = -1;
+}
+
+/***********************************************************************
+ *           reset_kernel_write_watches
+ */
+static BOOL reset_kernel_write_watches( void *base, size_t size )
+{
+    struct uffdio_writeprotect wp;
+
+    wp.range.start = (ULONG_PTR)base;
+    wp.range.len   = size;
+    wp.mode        = UFFDIO_WRITEPROTECT_MODE_WP;
+    if (!ioctl( uffd_fd, UFFDIO_WRITEPROTECT, &wp )) return TRUE;
+    WARN( "failed to write protect %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+    return FALSE;
+}
+
+/***********************************************************************
+ *           register_kernel_write_watches
+ */
+static BOOL register_kernel_write_watches( void *base, size_t size )
+{
+    struct uffdio_register reg;
+
+    if (uffd_fd == -1) return FALSE;
+    reg.range.start = (ULONG_PTR)base;
+    reg.range.len   = size;
+    reg.mode        = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl( uffd_fd, UFFDIO_REGISTER, &reg ))
+    {
+        WARN( "failed to register %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+        return FALSE;
+    }
+    return reset_kernel_write_watches( base, size );
+}
+
+/***********************************************************************
+ *           unregister_kernel_write_watches
+ */
+static void unregister_kernel_write_watches( void *base, size_t size )
+{
+    struct uffdio_range range;
+
+    range.start = (ULONG_PTR)base;
+    range.len   = size;
+    if (ioctl( uffd_fd, UFFDIO_UNREGISTER, &range ))
+        WARN( "failed to unregister %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+}
+
+/***********************************************************************
+ *           get_kernel_write_watches
+ *
+ * Retrieve the pages written to since the last reset, optionally
+ * write protecting them again.
+ */
+static ULONG_PTR get_kernel_write_watches( void *base, SIZE_T size, void **addresses,
+                                           ULONG_PTR count, BOOL reset )
+{
+    struct page_region regions[64];
+    struct pm_scan_arg arg;
+    ULONG_PTR addr, pos = 0;
+    int i, ret;
+
+    memset( &arg, 0, sizeof(arg) );
+    arg.size          = sizeof(arg);
+    arg.flags         = reset ? PM_SCAN_WP_MATCHING : 0;
+    arg.start         = (ULONG_PTR)base;
+    arg.end           = (ULONG_PTR)base + size;
+    arg.vec           = (ULONG_PTR)regions;
+    arg.vec_len       = ARRAY_SIZE(regions);
+    arg.category_mask = PAGE_IS_WRITTEN;
+    arg.return_mask   = PAGE_IS_WRITTEN;
+
+    while (pos < count && arg.start < arg.end)
+    {
+        arg.max_pages = count - pos;
+        if ((ret = ioctl( pagemap_scan_fd, PAGEMAP_SCAN, &arg )) <= 0)
+        {
+            if (ret) ERR( "failed to scan %p-%p: %s\n", base, (char *)base + size, strerror(errno) );
+            break;
+        }
+        for (i = 0; i < ret; i++)
+            for (addr = regions[i].start; addr < regions[i].end; addr += page_size)
+                addresses[pos++] = (void *)addr;
+        arg.start = arg.walk_end;
+    }
+    return pos;
+}
+
+#else
+
+static void init_kernel_write_watches(void) { }
+static BOOL reset_kernel_write_watches( void *base, size_t size ) { return FALSE; }
+static BOOL register_kernel_write_watches( void *base, size_t size ) { return FALSE; }
+static void unregister_kernel_write_watches( void *base, size_t size ) { }
+static ULONG_PTR get_kernel_write_watches( void *base, SIZE_T size, void **addresses,
+                                           ULONG_PTR count, BOOL reset ) { return 0; }
+
+#endif
+
+
+/***********************************************************************
+ *           enable_kernel_write_watches
+ *
+ * Let the kernel track the written pages of a new write watch view.
+ */
+static void enable_kernel_write_watches( struct file_view *view )
+{
+    if (!register_kernel_write_watches( view->base, view->size )) return;
+    start_views_update();
+    view->protect |= VPROT_KERNEL_WRITEWATCH;
+    /* the pages no longer need to be write protected */
+    set_page_vprot_bits( view->base, view->size, 0, VPROT_WRITEWATCH );
+    mprotect_range( view->base, view->size, 0, 0 );
+}
+
+
+/***********************************************************************
+ *           disable_kernel_write_watches
+ *
+ * Switch a view back to write protecting the watched pages, keeping
+ * track of the pages the kernel has seen written so far.
+ */
+static void disable_kernel_write_watches( struct file_view *view )
+{
+    char *addr = view->base, *end = addr + view->size;
+    void *addresses[64];
+    ULONG_PTR i, count;
+
+    start_views_update();
+    set_page_vprot_bits( view->base, view->size, VPROT_WRITEWATCH, 0 );
+    while (addr < end &&
+           (count = get_kernel_write_watches( addr, end - addr, addresses, ARRAY_SIZE(addresses), FALSE )))
+    {
+        for (i = 0; i < count; i++) set_page_vprot_bits( addresses[i], page_size, 0, VPROT_WRITEWATCH );
+        addr = (char *)addresses[count - 1] + page_size;
+    }
+    unregister_kernel_write_watches( view->base, view->size );
+    view->protect &= ~VPROT_KERNEL_WRITEWATCH;
+    mprotect_range( view->base, view->size, 0, 0 );
+}
+
+
 /***********************************************************************
  *           update_write_watches
  */
@@ -2025,6 +2331,7 @@ static NTSTATUS map_view( struct file_view **view_ret, void *base, size_t size,
 
         TRACE( "found view %p, size %p, protect %#x.\n", view->base, (void *)view->size, view->protect );
 
+        start_views_update();
         view->protect = vprot | VPROT_PLACEHOLDER;
         set_vprot( view, base, size, vprot );
         if (vprot & VPROT_WRITEWATCH) reset_write_watches( base, size );
@@ -2224,6 +2531,10 @@ static NTSTATUS decommit_pages( struct file_view *view, size_t start, size_t siz
     if (anon_mmap_fixed( (char *)view->base + start, size, PROT_NONE, 0 ) != MAP_FAILED)
     {
         set_page_vprot_bits( (char *)view->base + start, size, 0, VPROT_COMMITTED );
+        /* the new mapping needs to be registered again */
+        if ((view->protect & VPROT_KERNEL_WRITEWATCH) &&
+            !register_kernel_write_watches( (char *)view->base + start, size ))
+            disable_kernel_write_watches( view );
         return STATUS_SUCCESS;
     }
     return STATUS_NO_MEMORY;
@@ -2301,6 +2612,7 @@ static NTSTATUS free_pages_preserve_placeholder( struct file_view *view, char *b
         if (status) return status;
     }
 
+    start_views_update();
     view->protect = VPROT_PLACEHOLDER | VPROT_FREE_PLACEHOLDER;
     set_page_vprot( view->base, view->size, 0 );
     anon_mmap_fixed( view->base, view->size, PROT_NONE, 0 );
@@ -2383,6 +2695,34 @@ static NTSTATUS coalesce_placeholders( struct file_view *view, char *base, size_
 }
 
 
+/***********************************************************************
+ *           get_large_page_mask
+ *
+ * Return the mask for the large page size, or 0 if large pages are not supported.
+ * Large pages are backed by transparent huge pages, the server reports their size.
+ */
+static inline UINT_PTR get_large_page_mask(void)
+{
+    ULONG size = user_shared_data->LargePageMinimum;
+
+    return size ? size - 1 : 0;
+}
+
+
+/***********************************************************************
+ *           enable_huge_pages
+ *
+ * Ask the kernel to back a range with huge pages.
+ */
+static void enable_huge_pages( void *base, size_t size )
+{
+#ifdef MADV_HUGEPAGE
+    if (madvise( base, size, MADV_HUGEPAGE ))
+        WARN( "madvise %p-%p failed: %s\n", base, (char *)base + size, strerror(errno) );
+#endif
+}
+
+
 /***********************************************************************
  *           allocate_dos_memory
  *
@@ -2732,15 +3072,124 @@ static IMAGE_BASE_RELOCATION *process_relocation_block( char *page, IMAGE_BASE_R
 }
 
 
+/***********************************************************************
+ *           get_relocated_pages
+ *
+ * Build a map of the pages modified by the relocation blocks of an image, one byte per page.
+ * Pages of shared sections are left out since they are never copied from the relocated file.
+ */
+static BYTE *get_relocated_pages( IMAGE_BASE_RELOCATION *rel, IMAGE_BASE_RELOCATION *end,
+                                  const IMAGE_SECTION_HEADER *sec, unsigned int nb_sec, SIZE_T total_size )
+{
+    SIZE_T i, first, last, count = ROUND_SIZE( 0, total_size ) >> page_shift;
+    BYTE *pages;
+
+    if (!(pages = calloc( count, 1 ))) return NULL;
+
+    while (rel < end - 1 && rel->SizeOfBlock >= sizeof(*rel) && rel->VirtualAddress < total_size)
+    {
+        USHORT *reloc = (USHORT *)(rel + 1);
+        unsigned int n = (rel->SizeOfBlock - sizeof(*rel)) / sizeof(USHORT);
+        SIZE_T size = 0;
+
+        /* a fixup can extend up to 8 bytes past its offset, possibly into the next page */
+        for (i = 0; i < n; i++)
+            if (reloc[i] >> 12 != IMAGE_REL_BASED_ABSOLUTE) size = max( size, (reloc[i] & 0xfff) + 8 );
+        if (size)
+        {
+            first = rel->VirtualAddress >> page_shift;
+            last = min( (rel->VirtualAddress + size - 1) >> page_shift, count - 1 );
+            memset( pages + first, 1, last - first + 1 );
+        }
+        rel = (IMAGE_BASE_RELOCATION *)((char *)rel + rel->SizeOfBlock);
+    }
+
+    for (i = 0; i < nb_sec; i++)
+    {
+        if (!(sec[i].Characteristics & IMAGE_SCN_MEM_SHARED)) continue;
+        if (!(sec[i].Characteristics & IMAGE_SCN_MEM_WRITE)) continue;
+        first = sec[i].VirtualAddress >> page_shift;
+        last = sec[i].VirtualAddress + (sec[i].Misc.VirtualSize ? sec[i].Misc.VirtualSize : sec[i].SizeOfRawData);
+        last = min( ROUND_SIZE( 0, last ) >> page_shift, count );
+        if (first < last) memset( pages + first, 0, last - first );
+    }
+    return pages;
+}
+
+
+/***********************************************************************
+ *           next_page_run
+ *
+ * Find the next run of pages set in a page map, starting the search at *start.
+ */
+static BOOL next_page_run( const BYTE *pages, SIZE_T count, SIZE_T *start, SIZE_T *end )
+{
+    SIZE_T i = *start;
+
+    while (i < count && !pages[i]) i++;
+    if (i == count) return FALSE;
+    *start = i;
+    while (i < count && pages[i]) i++;
+    *end = i;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           prefetch_relocation_pages
+ *
+ * Ask the kernel to read in the relocation blocks and the pages they modify, so that
+ * the file is read with a few large I/Os instead of one page fault at a time.
+ */
+static void prefetch_relocation_pages( char *base, IMAGE_BASE_RELOCATION *rel, IMAGE_BASE_RELOCATION *end,
+                                       const BYTE *pages, SIZE_T total_size )
+{
+    SIZE_T start, stop, count = ROUND_SIZE( 0, total_size ) >> page_shift;
+
+    madvise( ROUND_ADDR( rel, page_mask ), ROUND_SIZE( rel, (char *)end - (char *)rel ), MADV_WILLNEED );
+
+    for (start = 0; next_page_run( pages, count, &start, &stop ); start = stop)
+        madvise( base + (start << page_shift), (stop - start) << page_shift, MADV_WILLNEED );
+}
+
+
+/***********************************************************************
+ *           write_image_reloc_file
+ *
+ * Write the pages modified by relocation to the file shared with other processes.
+ */
+static unsigned int write_image_reloc_file( int fd, const char *base, const BYTE *pages, SIZE_T total_size )
+{
+    SIZE_T start, stop, pos, count = ROUND_SIZE( 0, total_size ) >> page_shift;
+    ssize_t ret;
+
+    for (start = 0; next_page_run( pages, count, &start, &stop ); start = stop)
+    {
+        pos = start << page_shift;
+        while (pos < stop << page_shift)
+        {
+            if ((ret = pwrite( fd, base + pos, (stop << page_shift) - pos, pos )) > 0) pos += ret;
+            else if (!ret) return STATUS_DISK_FULL;
+            else if (errno != EINTR) return errno_to_status( errno );
+        }
+    }
+    return STATUS_SUCCESS;
+}
+
+
 /***********************************************************************
  *           map_image_into_view
  *
  * Map an executable (PE format) image into an existing view.
+ * If reloc_fd is valid, it holds the pages already relocated to the view address.
+ * If fill_pages is set, it receives the map of relocated pages to write to the shared file,
+ * or fill_status is set if there is nothing to write.
  * virtual_mutex must be held by caller.
  */
 static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filename, int fd,
                                      struct pe_image_info *image_info, USHORT machine,
-                                     int shared_fd, BOOL removable )
+                                     int shared_fd, int reloc_fd, BYTE **fill_pages,
+                                     unsigned int *fill_status, BOOL removable )
 {
     IMAGE_DOS_HEADER *dos;
     IMAGE_NT_HEADERS *nt;
@@ -2754,6 +3203,7 @@ static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filena
     char *ptr = view->base;
     SIZE_T header_size, total_size = view->size;
     INT_PTR delta;
+    BYTE *pages;
 
     TRACE_(module)( "mapping PE file %s at %p-%p\n", debugstr_w(filename), ptr, ptr + total_size );
 
@@ -2761,7 +3211,8 @@ static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filena
 
     fstat( fd, &st );
     header_size = min( image_info->header_size, st.st_size );
-    if ((status = map_pe_header( view->base, header_size, fd, &removable ))) return status;
+    if ((status = map_pe_header( view->base, header_size, fd, &removable )))
+        return status;
 
     status = STATUS_INVALID_IMAGE_FORMAT;  /* generic error */
     dos = (IMAGE_DOS_HEADER *)ptr;
@@ -2935,9 +3386,44 @@ static NTSTATUS map_image_into_view( struct file_view *view, const WCHAR *filena
             IMAGE_BASE_RELOCATION *rel = (IMAGE_BASE_RELOCATION *)(ptr + dir->VirtualAddress);
             IMAGE_BASE_RELOCATION *end = (IMAGE_BASE_RELOCATION *)((char *)rel + dir->Size);
 
-            while (rel && rel < end - 1 && rel->SizeOfBlock && rel->VirtualAddress < total_size)
-                rel = process_relocation_block( ptr + rel->VirtualAddress, rel, delta );
+            pages = get_relocated_pages( rel, end, sections, nt->FileHeader.NumberOfSections, total_size );
+            if (reloc_fd != -1)
+            {
+                /* another process already wrote the relocated pages */
+                SIZE_T start, stop, count = ROUND_SIZE( 0, total_size ) >> page_shift;
+
+                status = STATUS_NO_MEMORY;
+                if (!pages) goto done;
+                for (start = 0; next_page_run( pages, count, &start, &stop ); start = stop)
+                {
+                    if ((status = map_file_into_view( view, reloc_fd, start << page_shift,
+                                                      (stop - start) << page_shift, start << page_shift,
+                                                      VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY,
+                                                      FALSE )))
+                    {
+                        ERR_(module)( "Could not map %s relocated pages\n", debugstr_w(filename) );
+                        break;
+                    }
+                }
+                free( pages );
+                if (status) goto done;
+            }
+            else
+            {
+                if (pages && !removable) prefetch_relocation_pages( ptr, rel, end, pages, total_size );
+                while (rel && rel < end - 1 && rel->SizeOfBlock && rel->VirtualAddress < total_size)
+                    rel = process_relocation_block( ptr + rel->VirtualAddress, rel, delta );
+                /* the caller shares the relocated pages once virtual_mutex is released */
+                if (fill_pages && !rel) *fill_status = STATUS_NOT_SUPPORTED;
+                else if (fill_pages)
+                {
+                    *fill_pages = pages;
+                    pages = NULL;
+                }
+                free( pages );
+            }
         }
+        else if (fill_pages) *fill_status = STATUS_SUCCESS;  /* nothing to share */
     }
 
     /* set the image protections */
@@ -3083,6 +3569,58 @@ static NTSTATUS map_image_view( struct file_view **view_ret, struct pe_image_inf
 }
 
 
+/***********************************************************************
+ *             set_image_reloc_file
+ *
+ * Report the result of writing the relocated image file of a mapping.
+ * STATUS_RETRY lets another process write it.
+ */
+static void set_image_reloc_file( HANDLE mapping, unsigned int status )
+{
+    SERVER_START_REQ( set_image_reloc_file )
+    {
+        req->handle = wine_server_obj_handle( mapping );
+        req->status = status;
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+
+/***********************************************************************
+ *             get_image_reloc_file
+ *
+ * Get the file shared between processes that holds the image relocated to its map address.
+ */
+static HANDLE get_image_reloc_file( HANDLE mapping, int *fd, int *needs_close, BOOL *fill )
+{
+    HANDLE file = 0;
+
+    *fill = FALSE;
+    SERVER_START_REQ( get_image_reloc_file )
+    {
+        req->handle = wine_server_obj_handle( mapping );
+        if (!wine_server_call( req ))
+        {
+            file = wine_server_ptr_handle( reply->file );
+            *fill = reply->fill;
+        }
+    }
+    SERVER_END_REQ;
+
+    if (file && server_get_unix_fd( file, *fill ? FILE_READ_DATA | FILE_WRITE_DATA : FILE_READ_DATA,
+                                    fd, needs_close, NULL, NULL ))
+    {
+        /* let another process write the file */
+        if (*fill) set_image_reloc_file( mapping, STATUS_RETRY );
+        NtClose( file );
+        file = 0;
+        *fill = FALSE;
+    }
+    return file;
+}
+
+
 /***********************************************************************
  *             virtual_map_image
  *
@@ -3095,7 +3633,12 @@ static NTSTATUS virtual_map_image( HANDLE mapping, void **addr_ptr, SIZE_T *size
 {
     int unix_fd = -1, needs_close;
     int shared_fd = -1, shared_needs_close = 0;
+    int reloc_fd = -1, reloc_needs_close = 0;
+    unsigned int fill_status = STATUS_RETRY;
     SIZE_T size = image_info->map_size;
+    BYTE *fill_pages = NULL;
+    HANDLE reloc_file = 0;
+    BOOL reloc_fill = FALSE;
     struct file_view *view;
     unsigned int status;
     sigset_t sigset;
@@ -3122,12 +3665,26 @@ static NTSTATUS virtual_map_image( HANDLE mapping, void **addr_ptr, SIZE_T *size
         SERVER_END_REQ;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    /* other processes mapping the image at the same address can share the relocated pages */
+    if (image_info->map_addr && image_info->map_addr != image_info->base)
+        reloc_file = get_image_reloc_file( mapping, &reloc_fd, &reloc_needs_close, &reloc_fill );
+
+    lock_virtual( &sigset );
 
     status = map_image_view( &view, image_info, size, limit_low, limit_high, alloc_type );
     if (status) goto done;
 
-    status = map_image_into_view( view, filename, unix_fd, image_info, machine, shared_fd, needs_close );
+    if (view->base != wine_server_get_ptr( image_info->map_addr ))
+    {
+        if (reloc_needs_close) close( reloc_fd );
+        reloc_fd = -1;
+        reloc_needs_close = 0;
+    }
+    /* the process writing the relocated image file relocates its own copy first */
+    status = map_image_into_view( view, filename, unix_fd, image_info, machine, shared_fd,
+                                  reloc_fill ? -1 : reloc_fd,
+                                  reloc_fill && reloc_fd != -1 ? &fill_pages : NULL,
+                                  &fill_status, needs_close );
     if (status == STATUS_SUCCESS)
     {
         SERVER_START_REQ( map_image_view )
@@ -3151,9 +3708,18 @@ static NTSTATUS virtual_map_image( HANDLE mapping, void **addr_ptr, SIZE_T *size
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
+    /* share the relocated pages with the other processes mapping the image at this address */
+    if (fill_pages)
+    {
+        if (NT_SUCCESS(status)) fill_status = write_image_reloc_file( reloc_fd, *addr_ptr, fill_pages, size );
+        free( fill_pages );
+    }
     if (needs_close) close( unix_fd );
     if (shared_needs_close) close( shared_fd );
+    if (reloc_needs_close) close( reloc_fd );
+    if (reloc_fill) set_image_reloc_file( mapping, fill_status );
+    if (reloc_file) NtClose( reloc_file );
     return status;
 }
 
@@ -3256,15 +3822,17 @@ static unsigned int virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_P
 
     if ((res = server_get_unix_fd( handle, 0, &unix_handle, &needs_close, NULL, NULL ))) return res;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
 
-    res = map_view( &view, base, size, alloc_type, vprot, limit_low, limit_high, 0 );
+    res = map_view( &view, base, size, alloc_type, vprot, limit_low, limit_high,
+                    (sec_flags & SEC_LARGE_PAGES) ? max( get_large_page_mask(), granularity_mask ) : 0 );
     if (res) goto done;
 
     TRACE( "handle=%p size=%lx offset=%s\n", handle, size, wine_dbgstr_longlong(offset.QuadPart) );
     res = map_file_into_view( view, unix_handle, 0, size, offset.QuadPart, vprot, needs_close );
     if (res == STATUS_SUCCESS)
     {
+        if (sec_flags & SEC_LARGE_PAGES) enable_huge_pages( view->base, size );
         SERVER_START_REQ( map_view )
         {
             req->mapping = wine_server_obj_handle( handle );
@@ -3287,7 +3855,7 @@ static unsigned int virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_P
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     if (needs_close) close( unix_handle );
     return res;
 }
@@ -3333,7 +3901,7 @@ static void *alloc_virtual_heap( SIZE_T size )
 void virtual_init(void)
 {
     const struct preload_info **preload_info = dlsym( RTLD_DEFAULT, "wine_main_preload_info" );
-    const char *preload;
+    const char *preload, *env;
     size_t size;
     int i;
     pthread_mutexattr_t attr;
@@ -3343,6 +3911,8 @@ void virtual_init(void)
     pthread_mutex_init( &virtual_mutex, &attr );
     pthread_mutexattr_destroy( &attr );
 
+    init_kernel_write_watches();
+
 #ifdef _WIN64
     host_addr_space_limit = get_host_addr_space_limit();
     TRACE( "host addr space limit: %p\n", host_addr_space_limit );
@@ -3356,6 +3926,8 @@ void virtual_init(void)
 
     mmap_init( preload_info ? *preload_info : NULL );
 
+    if ((env = getenv( "WINEHUGEPAGES" ))) use_huge_pages = atoi( env );
+
     if ((preload = getenv("WINEPRELOADRESERVE")))
     {
         unsigned long start, end;
@@ -3549,7 +4121,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
     void *base = wine_server_get_ptr( info->base );
     int i;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     status = create_view( &view, base, size, SEC_IMAGE | SEC_FILE | VPROT_SYSTEM |
                           VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY | VPROT_EXEC );
     if (!status)
@@ -3586,7 +4158,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
         }
         else delete_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 
     return status;
 }
@@ -3759,7 +4331,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
     NTSTATUS status = STATUS_SUCCESS;
     SIZE_T block_size = signal_stack_mask + 1;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (next_free_teb)
     {
         ptr = next_free_teb;
@@ -3775,7 +4347,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
             if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, user_space_wow_limit,
                                                    &total, MEM_RESERVE, PAGE_READWRITE )))
             {
-                server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                unlock_virtual( &sigset );
                 return status;
             }
             teb_block = ptr;
@@ -3786,14 +4358,14 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
                                  MEM_COMMIT, PAGE_READWRITE );
     }
     *ret_teb = teb = init_teb( ptr, is_wow64() );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 
     if ((status = signal_alloc_thread( teb )))
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_virtual( &sigset );
         *(void **)ptr = next_free_teb;
         next_free_teb = ptr;
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_virtual( &sigset );
     }
     return status;
 }
@@ -3834,13 +4406,13 @@ void virtual_free_teb( TEB *teb )
         NtFreeVirtualMemory( GetCurrentProcess(), &ptr, &size, MEM_RELEASE );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     list_remove( &thread_data->entry );
     ptr = teb;
     if (!is_win64) ptr = (char *)ptr - teb_offset;
     *(void **)ptr = next_free_teb;
     next_free_teb = ptr;
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 }
 
 
@@ -3854,7 +4426,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 
     if (index < TLS_MINIMUM_AVAILABLE)
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_virtual( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3865,14 +4437,14 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             teb->TlsSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_virtual( &sigset );
     }
     else
     {
         index -= TLS_MINIMUM_AVAILABLE;
         if (index >= 8 * sizeof(peb->TlsExpansionBitmapBits)) return STATUS_INVALID_PARAMETER;
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        lock_virtual( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3887,7 +4459,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             if (teb->TlsExpansionSlots) teb->TlsExpansionSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        unlock_virtual( &sigset );
     }
     return STATUS_SUCCESS;
 }
@@ -3911,7 +4483,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR limit_low, UL
     if (size < 1024 * 1024) size = 1024 * 1024;  /* Xlib needs a large stack */
     size = (size + 0xffff) & ~0xffff;  /* round to 64K boundary */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
 
     status = map_view( &view, NULL, size, 0, VPROT_READ | VPROT_WRITE | VPROT_COMMITTED,
                        limit_low, limit_high, 0 );
@@ -3938,7 +4510,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR limit_low, UL
     stack->StackBase = (char *)view->base + view->size;
     stack->StackLimit = (char *)view->base + (guard_page ? 2 * page_size : 0);
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -4049,6 +4621,7 @@ NTSTATUS virtual_handle_fault( EXCEPTION_RECORD *rec, void *stack )
     BYTE vprot;
 
     mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+    virtual_mutex_depth++;
     vprot = get_page_vprot( page );
 
 #ifdef __APPLE__
@@ -4094,6 +4667,7 @@ NTSTATUS virtual_handle_fault( EXCEPTION_RECORD *rec, void *stack )
                 ret = STATUS_SUCCESS;
         }
     }
+    if (!--virtual_mutex_depth && (views_seq & 1)) InterlockedIncrement( &views_seq );
     mutex_unlock( &virtual_mutex );
     rec->ExceptionCode = ret;
     return ret;
@@ -4134,12 +4708,14 @@ void *virtual_setup_exception( void *stack_ptr, size_t size, EXCEPTION_RECORD *r
     else if (stack < stack_info.limit)
     {
         mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+        virtual_mutex_depth++;
         if ((get_page_vprot( stack ) & VPROT_GUARD) &&
             grow_thread_stack( ROUND_ADDR( stack, page_mask ), &stack_info ))
         {
             rec->ExceptionCode = STATUS_STACK_OVERFLOW;
             rec->NumberParameters = 0;
         }
+        if (!--virtual_mutex_depth && (views_seq & 1)) InterlockedIncrement( &views_seq );
         mutex_unlock( &virtual_mutex );
     }
 #if defined(VALGRIND_MAKE_MEM_UNDEFINED)
@@ -4189,14 +4765,14 @@ unsigned int virtual_locked_server_call( void *req_ptr )
 
     if (!size) return wine_server_call( req_ptr );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         ret = server_call_unlocked( req );
         if (has_write_watch) update_write_watches( addr, size, wine_server_reply_size( req ));
     }
     else memset( &req->u.reply, 0, sizeof(req->u.reply) );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return ret;
 }
 
@@ -4213,14 +4789,14 @@ ssize_t virtual_locked_read( int fd, void *addr, size_t size )
     ssize_t ret = read( fd, addr, size );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = read( fd, addr, size );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     errno = err;
     return ret;
 }
@@ -4238,14 +4814,14 @@ ssize_t virtual_locked_pread( int fd, void *addr, size_t size, off_t offset )
     ssize_t ret = pread( fd, addr, size, offset );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = pread( fd, addr, size, offset );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     errno = err;
     return ret;
 }
@@ -4264,7 +4840,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     ssize_t ret = recvmsg( fd, hdr, flags );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     for (i = 0; i < hdr->msg_iovlen; i++)
         if (check_write_access( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, &has_write_watch ))
             break;
@@ -4276,7 +4852,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     if (has_write_watch)
         while (i--) update_write_watches( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, 0 );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     errno = err;
     return ret;
 }
@@ -4291,10 +4867,10 @@ BOOL virtual_is_valid_code_address( const void *addr, SIZE_T size )
     BOOL ret = FALSE;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if ((view = find_view( addr, size )))
         ret = !(view->protect & VPROT_SYSTEM);  /* system views are not visible to the app */
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return ret;
 }
 
@@ -4381,7 +4957,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
 
     if (!size) return 0;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if ((view = find_view( addr, size )))
     {
         if (!(view->protect & VPROT_SYSTEM))
@@ -4397,7 +4973,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
             }
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return bytes_read;
 }
 
@@ -4417,13 +4993,13 @@ NTSTATUS virtual_uninterrupted_write_memory( void *addr, const void *buffer, SIZ
 
     if (!size) return STATUS_SUCCESS;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         memcpy( addr, buffer, size );
         if (has_write_watch) update_write_watches( addr, size, size );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return ret;
 }
 
@@ -4438,7 +5014,7 @@ void virtual_set_force_exec( BOOL enable )
     struct file_view *view;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (!force_exec_prot != !enable)  /* change all existing views */
     {
         force_exec_prot = enable;
@@ -4451,7 +5027,7 @@ void virtual_set_force_exec( BOOL enable )
             mprotect_range( view->base, view->size, commit, 0 );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 }
 
 
@@ -4463,7 +5039,7 @@ void virtual_enable_write_exceptions( BOOL enable )
     struct file_view *view;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (!enable_write_exceptions && enable)  /* change all existing views */
     {
         WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
@@ -4471,7 +5047,7 @@ void virtual_enable_write_exceptions( BOOL enable )
                 mprotect_range( view->base, view->size, 0, 0 );
     }
     enable_write_exceptions = enable;
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 }
 
 
@@ -4602,9 +5178,19 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
     if (type & MEM_RESERVE_PLACEHOLDER && (protect != PAGE_NOACCESS)) return STATUS_INVALID_PARAMETER;
     if (!arm64ec_view && (attributes & MEM_EXTENDED_PARAMETER_EC_CODE)) return STATUS_INVALID_PARAMETER;
 
+    if (type & MEM_LARGE_PAGES)
+    {
+        UINT_PTR large_page_mask = get_large_page_mask();
+
+        if (!large_page_mask) return STATUS_NOT_SUPPORTED;
+        if ((type & (MEM_RESERVE | MEM_COMMIT)) != (MEM_RESERVE | MEM_COMMIT)) return STATUS_INVALID_PARAMETER;
+        if (((UINT_PTR)base | size) & large_page_mask) return STATUS_INVALID_PARAMETER;
+        if (align <= large_page_mask) align = large_page_mask + 1;
+    }
+
     /* Reserve the memory */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
 
     if ((type & MEM_RESERVE) || !base)
     {
@@ -4613,6 +5199,7 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
             if (type & MEM_COMMIT) vprot |= VPROT_COMMITTED;
             if (type & MEM_WRITE_WATCH) vprot |= VPROT_WRITEWATCH;
             if (type & MEM_RESERVE_PLACEHOLDER) vprot |= VPROT_PLACEHOLDER | VPROT_FREE_PLACEHOLDER;
+            if (type & MEM_LARGE_PAGES) vprot |= SEC_LARGE_PAGES;
             if (protect & PAGE_NOCACHE) vprot |= SEC_NOCACHE;
 
             if (vprot & VPROT_WRITECOPY) status = STATUS_INVALID_PAGE_PROTECTION;
@@ -4620,7 +5207,17 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
             else status = map_view( &view, base, size, type, vprot, limit_low, limit_high,
                                     align ? align - 1 : granularity_mask );
 
-            if (status == STATUS_SUCCESS) base = view->base;
+            if (status == STATUS_SUCCESS)
+            {
+                base = view->base;
+                if (vprot & VPROT_WRITEWATCH) enable_kernel_write_watches( view );
+                /* write watches are tracked per page, huge pages would make them too coarse */
+                if (!(vprot & VPROT_WRITEWATCH) &&
+                    ((vprot & SEC_LARGE_PAGES) ||
+                     (use_huge_pages && !is_dos_memory && !(vprot & VPROT_PLACEHOLDER) &&
+                      get_large_page_mask() && size >= 16 * (get_large_page_mask() + 1))))
+                    enable_huge_pages( view->base, view->size );
+            }
         }
     }
     else if (type & MEM_RESET)
@@ -4654,7 +5251,7 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4675,7 +5272,8 @@ static NTSTATUS allocate_virtual_memory( void **ret, SIZE_T *size_ptr, ULONG typ
 NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR zero_bits,
                                          SIZE_T *size_ptr, ULONG type, ULONG protect )
 {
-    static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET;
+    static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH | MEM_RESET
+                                   | MEM_LARGE_PAGES;
     ULONG_PTR limit;
 
     TRACE("%p %p %08lx %x %08x\n", process, *ret, *size_ptr, (int)type, (int)protect );
@@ -4815,7 +5413,8 @@ NTSTATUS WINAPI NtAllocateVirtualMemoryEx( HANDLE process, PVOID *ret, SIZE_T *s
                                            ULONG count )
 {
     static const ULONG type_mask = MEM_COMMIT | MEM_RESERVE | MEM_TOP_DOWN | MEM_WRITE_WATCH
-                                   | MEM_RESET | MEM_RESERVE_PLACEHOLDER | MEM_REPLACE_PLACEHOLDER;
+                                   | MEM_RESET | MEM_RESERVE_PLACEHOLDER | MEM_REPLACE_PLACEHOLDER
+                                   | MEM_LARGE_PAGES;
     ULONG_PTR limit_low = 0;
     ULONG_PTR limit_high = 0;
     ULONG_PTR align = 0;
@@ -4908,7 +5507,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
     if (size) size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
 
     /* avoid freeing the DOS area when a broken app passes a NULL pointer */
     if (!base)
@@ -4953,7 +5552,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
         *addr_ptr = base;
         *size_ptr = size;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -5007,7 +5606,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
     size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
 
     if ((view = find_view( base, size )))
     {
@@ -5023,7 +5622,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -5035,6 +5634,80 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
 }
 
 
+/***********************************************************************
+ *           fill_basic_memory_info_lockfree
+ *
+ * Optimistic version of fill_basic_memory_info that doesn't take virtual_mutex.
+ * Returns FALSE if the views changed under us, or if the lookup needs the lock.
+ * This is safe because view structures and page protection tables are never unmapped.
+ */
+static BOOL fill_basic_memory_info_lockfree( char *base, MEMORY_BASIC_INFORMATION *info )
+{
+    char *alloc_end = working_set_limit, *view_base = NULL;
+    volatile struct wine_rb_entry *ptr;
+    volatile struct file_view *view;
+    size_t view_size = 0;
+    unsigned int protect = 0, depth = 0;
+    BYTE vprot;
+    LONG seq;
+
+    if (!views_read_begin( &seq )) return FALSE;
+
+    ptr = ((volatile struct wine_rb_tree *)&views_tree)->root;
+    while (ptr)
+    {
+        if (++depth > 128) return FALSE;  /* we are walking a tree that is being rebalanced */
+        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+        view_base = view->base;
+        view_size = view->size;
+        if (view_base > base)
+        {
+            alloc_end = view_base;
+            ptr = ptr->left;
+        }
+        else if (view_base + view_size <= base) ptr = ptr->right;
+        else
+        {
+            protect = view->protect;
+            break;
+        }
+    }
+    if (!views_read_end( seq )) return FALSE;
+
+    info->BaseAddress = base;
+
+    if (!ptr)
+    {
+#ifdef __i386__
+        return FALSE;  /* reserved areas are checked under the lock */
+#endif
+        info->RegionSize        = alloc_end - base;
+        info->State             = MEM_FREE;
+        info->Protect           = PAGE_NOACCESS;
+        info->AllocationBase    = 0;
+        info->AllocationProtect = 0;
+        info->Type              = 0;
+        return TRUE;
+    }
+
+    /* the committed state of SEC_RESERVE mappings is queried from the server */
+    if (protect & SEC_RESERVE) return FALSE;
+
+    /* the page protections of a consistent view are allocated, so this is safe to read */
+    info->RegionSize = get_vprot_range_size( base, view_base + view_size - base, ~VPROT_WRITEWATCH, &vprot );
+    if (!views_read_end( seq )) return FALSE;
+
+    info->AllocationBase = view_base;
+    info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
+    info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, protect ) : 0;
+    info->AllocationProtect = get_win32_prot( protect, protect );
+    if (protect & SEC_IMAGE) info->Type = MEM_IMAGE;
+    else if (protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
+    else info->Type = MEM_PRIVATE;
+    return TRUE;
+}
+
+
 static unsigned int fill_basic_memory_info( const void *addr, MEMORY_BASIC_INFORMATION *info )
 {
     char *base, *alloc_base = 0, *alloc_end = working_set_limit;
@@ -5046,9 +5719,11 @@ static unsigned int fill_basic_memory_info( const void *addr, MEMORY_BASIC_INFOR
 
     if (is_beyond_limit( base, 1, working_set_limit )) return STATUS_INVALID_PARAMETER;
 
+    if (fill_basic_memory_info_lockfree( base, info )) return STATUS_SUCCESS;
+
     /* Find the view containing the address */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     ptr = views_tree.root;
     while (ptr)
     {
@@ -5148,7 +5823,7 @@ static unsigned int fill_basic_memory_info( const void *addr, MEMORY_BASIC_INFOR
         else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
         else info->Type = MEM_PRIVATE;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 
     return STATUS_SUCCESS;
 }
@@ -5412,7 +6087,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
     start = ref[0].addr;
     end = ref[count - 1].addr + page_size;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     init_fill_working_set_info_data( &data, end );
 
     view = find_view_range( start, end - start );
@@ -5443,7 +6118,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
 
     free_fill_working_set_info_data( &data );
     if (ref != ref_buffer) free( ref );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
 
     if (res_len)
         *res_len = len;
@@ -5820,7 +6495,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
         return status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (!(view = find_view( addr, 0 )) || is_view_valloc( view )) goto done;
 
     if (flags & MEM_PRESERVE_PLACEHOLDER && !(view->protect & VPROT_PLACEHOLDER))
@@ -5839,7 +6514,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
             {
                 TRACE( "not freeing in-use builtin %p\n", view->base );
                 builtin->refcount--;
-                server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                unlock_virtual( &sigset );
                 return STATUS_SUCCESS;
             }
         }
@@ -5859,7 +6534,7 @@ static NTSTATUS unmap_view_of_section( HANDLE process, PVOID addr, ULONG flags )
     }
     else FIXME( "failed to unmap %p %x\n", view->base, status );
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -6011,7 +6686,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         return result.virtual_flush.status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     if (!(view = find_view( addr, *size_ptr ))) status = STATUS_INVALID_PARAMETER;
     else
     {
@@ -6021,7 +6696,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         if (msync( addr, *size_ptr, MS_ASYNC )) status = STATUS_NOT_MAPPED_DATA;
 #endif
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -6048,9 +6723,14 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     TRACE( "%p %x %p-%p %p %lu\n", process, (int)flags, base, (char *)base + size,
            addresses, *count );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
 
-    if (is_write_watch_range( base, size ))
+    if (is_kernel_write_watch_range( base, size ))
+    {
+        *count = get_kernel_write_watches( base, size, addresses, *count, flags & WRITE_WATCH_FLAG_RESET );
+        *granularity = page_size;
+    }
+    else if (is_write_watch_range( base, size ))
     {
         ULONG_PTR pos = 0;
         char *addr = base;
@@ -6067,7 +6747,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     }
     else status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -6088,14 +6768,16 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 
     if (!size) return STATUS_INVALID_PARAMETER;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
 
-    if (is_write_watch_range( base, size ))
+    if (is_kernel_write_watch_range( base, size ))
+        reset_kernel_write_watches( base, size );
+    else if (is_write_watch_range( base, size ))
         reset_write_watches( base, size );
     else
         status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -6186,7 +6868,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
 
     TRACE("%p %p\n", addr1, addr2);
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
 
     view1 = find_view( addr1, 0 );
     view2 = find_view( addr2, 0 );
@@ -6210,7 +6892,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
         SERVER_END_REQ;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return status;
 }
 
@@ -6252,7 +6934,7 @@ static NTSTATUS set_dirty_state_information( ULONG_PTR count, MEMORY_RANGE_ENTRY
     sigset_t sigset;
     NTSTATUS ret = STATUS_SUCCESS;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    lock_virtual( &sigset );
     for (i = 0; i < count; i++)
     {
         void *base = ROUND_ADDR( addresses[i].VirtualAddress, page_mask );
@@ -6270,7 +6952,7 @@ static NTSTATUS set_dirty_state_information( ULONG_PTR count, MEMORY_RANGE_ENTRY
             break;
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    unlock_virtual( &sigset );
     return ret;
 }
 
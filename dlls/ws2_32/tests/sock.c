@@ -14373,8 +14373,196 @@ static void test_send_buffering(void)
     closesocket(client);
 }
 
+static void test_inproc_io_child(void)
+{
+    char buffer[16];
+    DWORD size, flags, key;
+    OVERLAPPED ov = {0}, *ovp;
+    SOCKET client, server;
+    unsigned int apc_count;
+    WSABUF wsabuf;
+    HANDLE port;
+    u_long one = 1;
+    int ret;
+
+    tcp_socketpair(&client, &server);
+    ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    wsabuf.buf = buffer;
+    wsabuf.len = sizeof(buffer);
+
+    /* the first request goes through the server and shares the socket state */
+    flags = 0;
+    ret = WSARecv(client, &wsabuf, 1, NULL, &flags, &ov, NULL);
+    ok(ret == -1, "got %d\n", ret);
+    ok(WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+    ret = send(server, "data", 4, 0);
+    ok(ret == 4, "got %d\n", ret);
+    ret = WaitForSingleObject(ov.hEvent, 1000);
+    ok(!ret, "got %d\n", ret);
+    ret = WSAGetOverlappedResult(client, &ov, &size, FALSE, &flags);
+    ok(ret, "got error %u\n", WSAGetLastError());
+    ok(size == 4, "got size %lu\n", size);
+
+    /* immediate completion */
+    ret = send(server, "immediate", 9, 0);
+    ok(ret == 9, "got %d\n", ret);
+    Sleep(100);
+    ResetEvent(ov.hEvent);
+    size = 0xdeadbeef;
+    flags = 0;
+    ret = WSARecv(client, &wsabuf, 1, &size, &flags, &ov, NULL);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ok(size == 9, "got size %lu\n", size);
+    ok(!memcmp(buffer, "immediate", 9), "got %s\n", debugstr_an(buffer, size));
+    ret = WaitForSingleObject(ov.hEvent, 0);
+    ok(!ret, "event not signaled\n");
+    ret = WSAGetOverlappedResult(client, &ov, &size, FALSE, &flags);
+    ok(ret, "got error %u\n", WSAGetLastError());
+    ok(size == 9, "got size %lu\n", size);
+
+    ResetEvent(ov.hEvent);
+    wsabuf.len = 4;
+    ret = WSASend(client, &wsabuf, 1, &size, 0, &ov, NULL);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ok(size == 4, "got size %lu\n", size);
+    ret = WaitForSingleObject(ov.hEvent, 0);
+    ok(!ret, "event not signaled\n");
+    ret = recv(server, buffer, sizeof(buffer), 0);
+    ok(ret == 4, "got %d\n", ret);
+    wsabuf.len = sizeof(buffer);
+
+    /* a pending read is queued on the server and still completes */
+    ResetEvent(ov.hEvent);
+    flags = 0;
+    ret = WSARecv(client, &wsabuf, 1, NULL, &flags, &ov, NULL);
+    ok(ret == -1, "got %d\n", ret);
+    ok(WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+    ret = WaitForSingleObject(ov.hEvent, 100);
+    ok(ret == WAIT_TIMEOUT, "got %d\n", ret);
+    ret = send(server, "pending", 7, 0);
+    ok(ret == 7, "got %d\n", ret);
+    ret = WaitForSingleObject(ov.hEvent, 1000);
+    ok(!ret, "got %d\n", ret);
+    ret = WSAGetOverlappedResult(client, &ov, &size, FALSE, &flags);
+    ok(ret, "got error %u\n", WSAGetLastError());
+    ok(size == 7, "got size %lu\n", size);
+    ok(!memcmp(buffer, "pending", 7), "got %s\n", debugstr_an(buffer, size));
+
+    /* reads after the pending one has completed can complete immediately again */
+    ret = send(server, "again", 5, 0);
+    ok(ret == 5, "got %d\n", ret);
+    Sleep(100);
+    ResetEvent(ov.hEvent);
+    size = 0xdeadbeef;
+    flags = 0;
+    ret = WSARecv(client, &wsabuf, 1, &size, &flags, &ov, NULL);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ok(size == 5, "got size %lu\n", size);
+
+    /* completion routines are still delivered as APCs */
+    ret = send(server, "apc", 3, 0);
+    ok(ret == 3, "got %d\n", ret);
+    Sleep(100);
+    completion_called = 0;
+    flags = 0;
+    ret = WSARecv(client, &wsabuf, 1, &size, &flags, &ov, io_completion);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ok(size == 3, "got size %lu\n", size);
+    ok(!completion_called, "completion called\n");
+    ret = SleepEx(0, TRUE);
+    ok(ret == WAIT_IO_COMPLETION, "got %d\n", ret);
+    ok(completion_called == 1, "got %u calls\n", completion_called);
+
+    apc_count = 0;
+    ret = QueueUserAPC(apc_func, GetCurrentThread(), (ULONG_PTR)&apc_count);
+    ok(ret, "QueueUserAPC returned %d\n", ret);
+    ret = send(server, "apc", 3, 0);
+    ok(ret == 3, "got %d\n", ret);
+    Sleep(100);
+    ResetEvent(ov.hEvent);
+    flags = 0;
+    ret = WSARecv(client, &wsabuf, 1, &size, &flags, &ov, NULL);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ok(!apc_count, "APC was called\n");
+    SleepEx(0, TRUE);
+    ok(apc_count == 1, "got %u APCs\n", apc_count);
+
+    /* completions are posted to an associated port unless skipped */
+    port = CreateIoCompletionPort((HANDLE)client, NULL, 123, 0);
+    ok(!!port, "failed to create port, error %lu\n", GetLastError());
+
+    ret = send(server, "port", 4, 0);
+    ok(ret == 4, "got %d\n", ret);
+    Sleep(100);
+    ResetEvent(ov.hEvent);
+    flags = 0;
+    ret = WSARecv(client, &wsabuf, 1, &size, &flags, &ov, NULL);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ok(size == 4, "got size %lu\n", size);
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovp, 0);
+    ok(ret, "got error %lu\n", GetLastError());
+    ok(key == 123, "got key %lu\n", key);
+    ok(size == 4, "got size %lu\n", size);
+    ok(ovp == &ov, "got overlapped %p\n", ovp);
+
+    ret = SetFileCompletionNotificationModes((HANDLE)client, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS);
+    ok(ret, "got error %lu\n", GetLastError());
+    ret = send(server, "skip", 4, 0);
+    ok(ret == 4, "got %d\n", ret);
+    Sleep(100);
+    ResetEvent(ov.hEvent);
+    flags = 0;
+    ret = WSARecv(client, &wsabuf, 1, &size, &flags, &ov, NULL);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ok(size == 4, "got size %lu\n", size);
+    ovp = (OVERLAPPED *)0xdeadbeef;
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovp, 0);
+    ok(!ret, "expected failure\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "got error %lu\n", GetLastError());
+    ok(!ovp, "got overlapped %p\n", ovp);
+
+    /* a non-blocking read with no data fails instead of queuing an async */
+    ret = ioctlsocket(client, FIONBIO, &one);
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ret = recv(client, buffer, sizeof(buffer), 0);
+    ok(ret == -1, "got %d\n", ret);
+    ok(WSAGetLastError() == WSAEWOULDBLOCK, "got error %u\n", WSAGetLastError());
+    ret = send(server, "nonblock", 8, 0);
+    ok(ret == 8, "got %d\n", ret);
+    Sleep(100);
+    ret = recv(client, buffer, sizeof(buffer), 0);
+    ok(ret == 8, "got %d\n", ret);
+    ok(!memcmp(buffer, "nonblock", 8), "got %s\n", debugstr_an(buffer, ret));
+
+    closesocket(client);
+    closesocket(server);
+    CloseHandle(port);
+    CloseHandle(ov.hEvent);
+}
+
+static void test_inproc_io(char **argv)
+{
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA si = {0};
+    char cmdline[MAX_PATH];
+    BOOL ret;
+
+    /* run the socket I/O tests with in-process synchronization enabled */
+    SetEnvironmentVariableA("WINEINPROCSYNC", "1");
+    sprintf(cmdline, "%s %s inproc_io", argv[0], argv[1]);
+    si.cb = sizeof(si);
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    ok(ret, "failed to create process, error %lu\n", GetLastError());
+    SetEnvironmentVariableA("WINEINPROCSYNC", NULL);
+
+    wait_child_process(pi.hProcess);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+}
+
 START_TEST( sock )
 {
+    char **argv;
     int i;
 
 /* Leave these tests at the beginning. They depend on WSAStartup not having been
@@ -14384,6 +14572,13 @@ START_TEST( sock )
 
     Init();
 
+    if (winetest_get_mainargs(&argv) > 2)
+    {
+        if (!strcmp(argv[2], "inproc_io")) test_inproc_io_child();
+        Exit();
+        return;
+    }
+
     test_set_getsockopt();
     test_reuseaddr();
     test_ip_pktinfo();
@@ -14457,6 +14652,7 @@ START_TEST( sock )
     test_tcp_sendto_recvfrom();
     test_broadcast();
     test_send_buffering();
+    test_inproc_io(argv);
 
     /* There is apparently an obscure interaction between this test and
      * test_WSAGetOverlappedResult().
@@ -191,6 +191,16 @@ struct send_fd
 };
 
 
+struct completion_msg
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    int           __pad;
+};
+
+
 struct wake_up_reply
 {
     client_ptr_t cookie;
@@ -1005,6 +1015,46 @@ typedef volatile struct
     object_shm_t         shm;
 } shared_object_t;
 
+
+typedef volatile struct
+{
+    unsigned __int64     state;
+    unsigned int         type;
+    unsigned int         max;
+} inproc_sync_t;
+
+#define INPROC_SYNC_NONE           0
+#define INPROC_SYNC_AUTO_EVENT     1
+#define INPROC_SYNC_MANUAL_EVENT   2
+#define INPROC_SYNC_SEMAPHORE      3
+#define INPROC_SYNC_MUTEX          4
+#define INPROC_SYNC_SOCKET         5
+#define INPROC_SYNC_FILE           6
+
+
+#define INPROC_SYNC_SERVER_WAIT    ((unsigned __int64)1 << 63)
+
+#define INPROC_SYNC_MUTEX_OWNER    0xffffffff
+#define INPROC_SYNC_MUTEX_COUNT_SHIFT 32
+#define INPROC_SYNC_MUTEX_COUNT_MAX   0x3fffffff
+#define INPROC_SYNC_MUTEX_ABANDONED ((unsigned __int64)1 << 62)
+
+#define INPROC_SOCKET_RECV         0x01
+#define INPROC_SOCKET_SEND         0x02
+#define INPROC_SOCKET_SKIP_PORT    0x04
+#define INPROC_SOCKET_SKIP_SIGNAL  0x08
+#define INPROC_SOCKET_NONBLOCKING  0x10
+
+#define INPROC_FILE_COMPLETION     0x01
+
+
+#define REGISTRY_SHM_SLOTS 4096
+
+typedef volatile struct
+{
+    unsigned __int64     serials[REGISTRY_SHM_SLOTS];
+} registry_shm_t;
+
 struct obj_locator
 {
     object_id_t          id;
@@ -1448,7 +1498,9 @@ struct dup_handle_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          fd_type;
+    unsigned int fd_access;
+    unsigned int fd_options;
 };
 
 
@@ -1565,7 +1617,7 @@ struct create_event_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    data_size_t  sync_offset;
 };
 
 
@@ -1597,6 +1649,19 @@ struct query_event_reply
 };
 
 
+struct get_inproc_sync_mapping_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_inproc_sync_mapping_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    data_size_t  size;
+};
+
+
 struct open_event_request
 {
     struct request_header __header;
@@ -1657,7 +1722,7 @@ struct create_mutex_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    data_size_t  sync_offset;
 };
 
 
@@ -1721,7 +1786,7 @@ struct create_semaphore_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    data_size_t  sync_offset;
 };
 
 
@@ -1785,7 +1850,9 @@ struct create_file_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    int          fd_type;
+    unsigned int fd_access;
+    unsigned int fd_options;
 };
 
 
@@ -1973,7 +2040,7 @@ struct recv_socket_reply
     obj_handle_t wait;
     unsigned int options;
     int          nonblocking;
-    char __pad_20[4];
+    data_size_t  sync_offset;
 };
 
 
@@ -1990,7 +2057,7 @@ struct send_socket_reply
     obj_handle_t wait;
     unsigned int options;
     int          nonblocking;
-    char __pad_20[4];
+    data_size_t  sync_offset;
 };
 
 #define SERVER_SOCKET_IO_FORCE_ASYNC 0x01
@@ -2165,6 +2232,34 @@ struct get_image_map_address_reply
 
 
 
+struct get_image_reloc_file_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_image_reloc_file_reply
+{
+    struct reply_header __header;
+    obj_handle_t file;
+    int          fill;
+};
+
+
+
+struct set_image_reloc_file_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+    unsigned int status;
+    char __pad_20[4];
+};
+struct set_image_reloc_file_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct map_view_request
 {
     struct request_header __header;
@@ -2496,7 +2591,10 @@ struct create_key_reply
 {
     struct reply_header __header;
     obj_handle_t hkey;
-    char __pad_12[4];
+    unsigned int slot;
+    unsigned __int64 key_id;
+    unsigned int access;
+    char __pad_28[4];
 };
 
 
@@ -2512,7 +2610,10 @@ struct open_key_reply
 {
     struct reply_header __header;
     obj_handle_t hkey;
-    char __pad_12[4];
+    unsigned int slot;
+    unsigned __int64 key_id;
+    unsigned int access;
+    char __pad_28[4];
 };
 
 
@@ -2593,11 +2694,29 @@ struct get_key_value_reply
     struct reply_header __header;
     int          type;
     data_size_t  total;
+    unsigned int slot;
+    char __pad_20[4];
+    unsigned __int64 serial;
+    unsigned __int64 key_id;
     /* VARARG(data,bytes); */
 };
 
 
 
+struct get_registry_mapping_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_registry_mapping_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    data_size_t  size;
+};
+
+
+
 struct enum_key_value_request
 {
     struct request_header __header;
@@ -5451,6 +5570,7 @@ struct remove_completion_reply
     apc_param_t   information;
     unsigned int  status;
     obj_handle_t  wait_handle;
+    /* VARARG(msgs,completion_msgs); */
 };
 
 
@@ -5513,6 +5633,8 @@ struct add_fd_completion_request
 struct add_fd_completion_reply
 {
     struct reply_header __header;
+    data_size_t    sync_offset;
+    char __pad_12[4];
 };
 
 
@@ -5918,6 +6040,7 @@ enum request
     REQ_create_event,
     REQ_event_op,
     REQ_query_event,
+    REQ_get_inproc_sync_mapping,
     REQ_open_event,
     REQ_create_keyed_event,
     REQ_open_keyed_event,
@@ -5952,6 +6075,8 @@ enum request
     REQ_open_mapping,
     REQ_get_mapping_info,
     REQ_get_image_map_address,
+    REQ_get_image_reloc_file,
+    REQ_set_image_reloc_file,
     REQ_map_view,
     REQ_map_image_view,
     REQ_map_builtin_view,
@@ -5978,6 +6103,7 @@ enum request
     REQ_enum_key,
     REQ_set_key_value,
     REQ_get_key_value,
+    REQ_get_registry_mapping,
     REQ_enum_key_value,
     REQ_delete_key_value,
     REQ_load_registry,
@@ -6217,6 +6343,7 @@ union generic_request
     struct create_event_request create_event_request;
     struct event_op_request event_op_request;
     struct query_event_request query_event_request;
+    struct get_inproc_sync_mapping_request get_inproc_sync_mapping_request;
     struct open_event_request open_event_request;
     struct create_keyed_event_request create_keyed_event_request;
     struct open_keyed_event_request open_keyed_event_request;
@@ -6251,6 +6378,8 @@ union generic_request
     struct open_mapping_request open_mapping_request;
     struct get_mapping_info_request get_mapping_info_request;
     struct get_image_map_address_request get_image_map_address_request;
+    struct get_image_reloc_file_request get_image_reloc_file_request;
+    struct set_image_reloc_file_request set_image_reloc_file_request;
     struct map_view_request map_view_request;
     struct map_image_view_request map_image_view_request;
     struct map_builtin_view_request map_builtin_view_request;
@@ -6277,6 +6406,7 @@ union generic_request
     struct enum_key_request enum_key_request;
     struct set_key_value_request set_key_value_request;
     struct get_key_value_request get_key_value_request;
+    struct get_registry_mapping_request get_registry_mapping_request;
     struct enum_key_value_request enum_key_value_request;
     struct delete_key_value_request delete_key_value_request;
     struct load_registry_request load_registry_request;
@@ -6514,6 +6644,7 @@ union generic_reply
     struct create_event_reply create_event_reply;
     struct event_op_reply event_op_reply;
     struct query_event_reply query_event_reply;
+    struct get_inproc_sync_mapping_reply get_inproc_sync_mapping_reply;
     struct open_event_reply open_event_reply;
     struct create_keyed_event_reply create_keyed_event_reply;
     struct open_keyed_event_reply open_keyed_event_reply;
@@ -6548,6 +6679,8 @@ union generic_reply
     struct open_mapping_reply open_mapping_reply;
     struct get_mapping_info_reply get_mapping_info_reply;
     struct get_image_map_address_reply get_image_map_address_reply;
+    struct get_image_reloc_file_reply get_image_reloc_file_reply;
+    struct set_image_reloc_file_reply set_image_reloc_file_reply;
     struct map_view_reply map_view_reply;
     struct map_image_view_reply map_image_view_reply;
     struct map_builtin_view_reply map_builtin_view_reply;
@@ -6574,6 +6707,7 @@ union generic_reply
     struct enum_key_reply enum_key_reply;
     struct set_key_value_reply set_key_value_reply;
     struct get_key_value_reply get_key_value_reply;
+    struct get_registry_mapping_reply get_registry_mapping_reply;
     struct enum_key_value_reply enum_key_value_reply;
     struct delete_key_value_reply delete_key_value_reply;
     struct load_registry_reply load_registry_reply;
@@ -6775,6 +6909,6 @@ union generic_reply
     struct set_keyboard_repeat_reply set_keyboard_repeat_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 855
+#define SERVER_PROTOCOL_VERSION 870
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
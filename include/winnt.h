@@ -1049,6 +1049,9 @@ NTSYSAPI WORD         WINAPI RtlQueryDepthSList(PSLIST_HEADER);
 
 typedef enum _HEAP_INFORMATION_CLASS {
     HeapCompatibilityInformation,
+#ifdef __WINESRC__
+    HeapWineStatistics = 1000,
+#endif
 } HEAP_INFORMATION_CLASS;
 
 /* Processor feature flags.  */
@@ -2703,6 +2703,39 @@ typedef struct _RTL_HEAP_PARAMETERS
     SIZE_T Reserved[2];
 } RTL_HEAP_PARAMETERS, *PRTL_HEAP_PARAMETERS;
 
+#ifdef __WINESRC__
+
+/* Wine specific heap statistics, returned by RtlQueryHeapInformation( HeapWineStatistics ) */
+typedef struct _HEAP_WINE_BIN_STATISTICS
+{
+    SIZE_T BlockSize;           /* block size of the size class, including the block header */
+    ULONG  AllocCount;          /* blocks allocated from the backend since heap creation */
+    ULONG  FreeCount;           /* blocks freed to the backend since heap creation */
+    ULONG  LfhEnabled;          /* size class is served by the low fragmentation heap */
+    ULONG  LfhGroupCount;       /* LFH block groups currently allocated */
+    ULONG  LfhUsedCount;        /* LFH blocks not currently released to their group */
+    ULONG  LfhFreeCount;        /* LFH blocks free in their group */
+} HEAP_WINE_BIN_STATISTICS, *PHEAP_WINE_BIN_STATISTICS;
+
+typedef struct _HEAP_WINE_STATISTICS
+{
+    SIZE_T ReservedSize;        /* virtual memory reserved by the heap, including large blocks */
+    SIZE_T CommittedSize;       /* virtual memory committed by the heap, including large blocks */
+    SIZE_T UsedSize;            /* data size of used blocks, LFH groups counted as used blocks */
+    SIZE_T FreeSize;            /* data size of free blocks */
+    SIZE_T OverheadSize;        /* block headers and subheap headers */
+    SIZE_T LargestFreeSize;     /* largest free block data size, to estimate fragmentation */
+    SIZE_T LargeSize;           /* data size of large blocks */
+    ULONG  SubheapCount;
+    ULONG  UsedCount;
+    ULONG  FreeCount;
+    ULONG  LargeCount;
+    ULONG  BinCount;            /* number of entries in Bins, 0 if the heap has no LFH support */
+    HEAP_WINE_BIN_STATISTICS Bins[1];
+} HEAP_WINE_STATISTICS, *PHEAP_WINE_STATISTICS;
+
+#endif /* __WINESRC__ */
+
 typedef struct _RTL_RWLOCK {
     RTL_CRITICAL_SECTION rtlCS;
 
@@ -3920,6 +3953,7 @@ typedef void (CALLBACK *PLDR_DLL_NOTIFICATION_FUNCTION)(ULONG, LDR_DLL_NOTIFICAT
 #define LDR_UNLOAD_IN_PROGRESS          0x00002000
 #define LDR_NO_DLL_CALLS                0x00040000
 #define LDR_PROCESS_ATTACHED            0x00080000
+#define LDR_IMAGE_NOT_AT_BASE           0x00200000
 #define LDR_COR_IMAGE                   0x00400000
 #define LDR_COR_ILONLY                  0x01000000
 
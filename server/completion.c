@@ -399,6 +399,9 @@ DECL_HANDLER(remove_completion)
     }
     else
     {
+        data_size_t count = min( completion->depth - 1, get_reply_max_size() / sizeof(struct completion_msg) );
+        struct completion_msg *msgs;
+
         list_remove( entry );
         completion->depth--;
         msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
@@ -408,6 +411,26 @@ DECL_HANDLER(remove_completion)
         reply->information = msg->information;
         free( msg );
         reply->wait_handle = 0;
+
+        /* return further queued packets in the same reply to save round trips */
+        if (count && (msgs = set_reply_data_size( count * sizeof(*msgs) )))
+        {
+            data_size_t i;
+
+            for (i = 0; i < count; i++)
+            {
+                entry = list_head( &completion->queue );
+                list_remove( entry );
+                completion->depth--;
+                msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
+                msgs[i].ckey = msg->ckey;
+                msgs[i].cvalue = msg->cvalue;
+                msgs[i].information = msg->information;
+                msgs[i].status = msg->status;
+                msgs[i].__pad = 0;
+                free( msg );
+            }
+        }
     }
 
     release_object( completion );
@@ -31,6 +31,7 @@
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "thread.h"
 #include "request.h"
@@ -55,22 +56,25 @@ struct event
     struct object  obj;             /* object header */
     struct list    kernel_object;   /* list of kernel object pointers */
     int            manual_reset;    /* is it a manual reset event? */
-    int            signaled;        /* event has been signaled */
+    struct inproc_sync sync;        /* event state, possibly shared with the client */
 };
 
 static void event_dump( struct object *obj, int verbose );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int event_signal( struct object *obj, unsigned int access);
 static struct list *event_get_kernel_obj_list( struct object *obj );
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     &event_type,               /* type */
     event_dump,                /* dump */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -85,7 +89,7 @@ static const struct object_ops event_ops =
     no_open_file,              /* open_file */
     event_get_kernel_obj_list, /* get_kernel_obj_list */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -149,7 +153,8 @@ struct event *create_event( struct object *root, const struct unicode_str *name,
             /* initialize it if it didn't already exist */
             list_init( &event->kernel_object );
             event->manual_reset = manual_reset;
-            event->signaled     = initial_state;
+            init_inproc_sync( &event->sync, manual_reset ? INPROC_SYNC_MANUAL_EVENT : INPROC_SYNC_AUTO_EVENT,
+                              !!initial_state, 0 );
         }
     }
     return event;
@@ -160,39 +165,65 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
     return (struct event *)get_handle_obj( process, handle, access, &event_ops );
 }
 
-static void pulse_event( struct event *event )
+static int pulse_event( struct event *event )
 {
-    event->signaled = 1;
+    int prev = set_inproc_sync_state( &event->sync, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
-    event->signaled = 0;
+    set_inproc_sync_state( &event->sync, 0 );
+    return prev;
 }
 
-void set_event( struct event *event )
+static int do_set_event( struct event *event )
 {
-    event->signaled = 1;
+    int prev = set_inproc_sync_state( &event->sync, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
+    return prev;
+}
+
+static int do_reset_event( struct event *event )
+{
+    return set_inproc_sync_state( &event->sync, 0 );
+}
+
+void set_event( struct event *event )
+{
+    do_set_event( event );
 }
 
 void reset_event( struct event *event )
 {
-    event->signaled = 0;
+    do_reset_event( event );
 }
 
 static void event_dump( struct object *obj, int verbose )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    fprintf( stderr, "Event manual=%d signaled=%d\n",
-             event->manual_reset, event->signaled );
+    fprintf( stderr, "Event manual=%d signaled=%d shared=%d\n", event->manual_reset,
+             (int)get_inproc_sync_state( &event->sync ), event->sync.block != NULL );
+}
+
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    return add_inproc_sync_queue( obj, &event->sync, entry );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    remove_inproc_sync_queue( obj, &event->sync, entry );
 }
 
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    return event->signaled;
+    return get_inproc_sync_state( &event->sync ) != 0;
 }
 
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -200,7 +231,7 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (!event->manual_reset) set_inproc_sync_state( &event->sync, 0 );
 }
 
 static int event_signal( struct object *obj, unsigned int access )
@@ -223,6 +254,13 @@ static struct list *event_get_kernel_obj_list( struct object *obj )
     return &event->kernel_object;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    free_inproc_sync( &event->sync );
+}
+
 struct keyed_event *create_keyed_event( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -293,8 +331,13 @@ DECL_HANDLER(create_event)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, event, req->access, objattr->attributes );
         else
+        {
+            share_inproc_sync( &event->sync, current->process );
             reply->handle = alloc_handle_no_access_check( current->process, event,
                                                           req->access, objattr->attributes );
+        }
+        reply->sync_offset = get_inproc_sync_offset( &event->sync, reply->handle,
+                                                     SYNCHRONIZE | EVENT_QUERY_STATE | EVENT_MODIFY_STATE );
         release_object( event );
     }
 
@@ -316,17 +359,16 @@ DECL_HANDLER(event_op)
     struct event *event;
 
     if (!(event = get_event_obj( current->process, req->handle, EVENT_MODIFY_STATE ))) return;
-    reply->state = event->signaled;
     switch(req->op)
     {
     case PULSE_EVENT:
-        pulse_event( event );
+        reply->state = pulse_event( event );
         break;
     case SET_EVENT:
-        set_event( event );
+        reply->state = do_set_event( event );
         break;
     case RESET_EVENT:
-        reset_event( event );
+        reply->state = do_reset_event( event );
         break;
     default:
         set_error( STATUS_INVALID_PARAMETER );
@@ -343,7 +385,7 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    reply->state = get_inproc_sync_state( &event->sync );
 
     release_object( event );
 }
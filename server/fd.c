@@ -154,6 +154,7 @@ struct fd
     struct completion   *completion;  /* completion object attached to this fd */
     apc_param_t          comp_key;    /* completion key to set in completion events */
     unsigned int         comp_flags;  /* completion flags */
+    struct inproc_sync   comp_sync;   /* completion state, possibly shared with the client */
 };
 
 static void fd_dump( struct object *obj, int verbose );
@@ -326,14 +327,27 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct list           entry;      /* entry in expired list */
     abstime_t             when;       /* timeout expiry */
+    unsigned int          index;      /* index in timeout heap, or TIMEOUT_NOT_QUEUED */
+    unsigned int          seq;        /* insertion sequence, to keep ordering stable */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list abs_timeout_list = LIST_INIT(abs_timeout_list); /* sorted absolute timeouts list */
-static struct list rel_timeout_list = LIST_INIT(rel_timeout_list); /* sorted relative timeouts list */
+#define TIMEOUT_NOT_QUEUED (~0u)
+
+/* binary min-heap of pending timeouts, ordered by expiry time */
+struct timeout_heap
+{
+    struct timeout_user **users;      /* heap array */
+    unsigned int          count;      /* number of entries in use */
+    unsigned int          size;       /* allocated size of the array */
+};
+
+static struct timeout_heap abs_timeouts;  /* absolute timeouts heap */
+static struct timeout_heap rel_timeouts;  /* relative (monotonic) timeouts heap */
+static unsigned int timeout_seq;          /* sequence counter for timeout insertion */
 timeout_t current_time;
 timeout_t monotonic_time;
 
@@ -410,43 +424,127 @@ void set_current_time(void)
     if (user_shared_data) set_user_shared_data_time();
 }
 
+/* expiry of a timeout in its own clock, for ordering in the heap */
+static inline timeout_t timeout_expiry( const struct timeout_user *user )
+{
+    return user->when > 0 ? user->when : -user->when;
+}
+
+/* check if a timeout should expire before another one */
+static inline int timeout_before( const struct timeout_user *a, const struct timeout_user *b )
+{
+    timeout_t diff = timeout_expiry( a ) - timeout_expiry( b );
+
+    /* timeouts with the same expiry are processed most recently added first */
+    if (!diff) return (int)(a->seq - b->seq) > 0;
+    return diff < 0;
+}
+
+static inline void timeout_heap_set( struct timeout_heap *heap, unsigned int index, struct timeout_user *user )
+{
+    heap->users[index] = user;
+    user->index = index;
+}
+
+/* move a heap entry towards the root until the heap property is restored */
+static void timeout_heap_sift_up( struct timeout_heap *heap, unsigned int index )
+{
+    struct timeout_user *user = heap->users[index];
+
+    while (index)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (!timeout_before( user, heap->users[parent] )) break;
+        timeout_heap_set( heap, index, heap->users[parent] );
+        index = parent;
+    }
+    timeout_heap_set( heap, index, user );
+}
+
+/* move a heap entry towards the leaves until the heap property is restored */
+static void timeout_heap_sift_down( struct timeout_heap *heap, unsigned int index )
+{
+    struct timeout_user *user = heap->users[index];
+
+    for (;;)
+    {
+        unsigned int child = 2 * index + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && timeout_before( heap->users[child + 1], heap->users[child] )) child++;
+        if (!timeout_before( heap->users[child], user )) break;
+        timeout_heap_set( heap, index, heap->users[child] );
+        index = child;
+    }
+    timeout_heap_set( heap, index, user );
+}
+
+static int timeout_heap_insert( struct timeout_heap *heap, struct timeout_user *user )
+{
+    if (heap->count == heap->size)
+    {
+        struct timeout_user **new_users;
+        unsigned int new_size = heap->size ? heap->size + heap->size / 2 : 64;
+
+        if (!(new_users = realloc( heap->users, new_size * sizeof(*new_users) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        heap->users = new_users;
+        heap->size = new_size;
+    }
+    heap->users[heap->count++] = user;
+    timeout_heap_sift_up( heap, heap->count - 1 );
+    return 1;
+}
+
+static void timeout_heap_remove( struct timeout_heap *heap, struct timeout_user *user )
+{
+    unsigned int index = user->index;
+    struct timeout_user *last = heap->users[--heap->count];
+
+    assert( heap->users[index] == user );
+    user->index = TIMEOUT_NOT_QUEUED;
+    if (last == user) return;
+
+    timeout_heap_set( heap, index, last );
+    if (index && timeout_before( last, heap->users[(index - 1) / 2] ))
+        timeout_heap_sift_up( heap, index );
+    else
+        timeout_heap_sift_down( heap, index );
+}
+
+static inline struct timeout_user *timeout_heap_head( const struct timeout_heap *heap )
+{
+    return heap->count ? heap->users[0] : NULL;
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = timeout_to_abstime( when );
+    user->seq      = timeout_seq++;
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
-
-    if (user->when > 0)
+    if (!timeout_heap_insert( user->when > 0 ? &abs_timeouts : &rel_timeouts, user ))
     {
-        LIST_FOR_EACH( ptr, &abs_timeout_list )
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when >= user->when) break;
-        }
-    }
-    else
-    {
-        LIST_FOR_EACH( ptr, &rel_timeout_list )
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when <= user->when) break;
-        }
+        free( user );
+        return NULL;
     }
-    list_add_before( ptr, &user->entry );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->index != TIMEOUT_NOT_QUEUED)
+        timeout_heap_remove( user->when > 0 ? &abs_timeouts : &rel_timeouts, user );
+    else  /* already expired, waiting for its callback */
+        list_remove( &user->entry );
     free( user );
 }
 
@@ -881,58 +979,45 @@ static int get_next_timeout(void)
 {
     int ret = user_shared_data ? user_shared_data_timeout : -1;
 
-    if (!list_empty( &abs_timeout_list ) || !list_empty( &rel_timeout_list ))
+    if (abs_timeouts.count || rel_timeouts.count)
     {
+        struct timeout_user *timeout;
         struct list expired_list, *ptr;
 
-        /* first remove all expired timers from the list */
+        /* first remove all expired timers from the heaps */
 
         list_init( &expired_list );
-        while ((ptr = list_head( &abs_timeout_list )) != NULL)
+        while ((timeout = timeout_heap_head( &abs_timeouts )) && timeout->when <= current_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            timeout_heap_remove( &abs_timeouts, timeout );
+            list_add_tail( &expired_list, &timeout->entry );
         }
-        while ((ptr = list_head( &rel_timeout_list )) != NULL)
+        while ((timeout = timeout_heap_head( &rel_timeouts )) && -timeout->when <= monotonic_time)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (-timeout->when <= monotonic_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
+            timeout_heap_remove( &rel_timeouts, timeout );
+            list_add_tail( &expired_list, &timeout->entry );
         }
 
         /* now call the callback for all the removed timers */
 
         while ((ptr = list_head( &expired_list )) != NULL)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
             list_remove( &timeout->entry );
             timeout->callback( timeout->private );
             free( timeout );
         }
 
-        if ((ptr = list_head( &abs_timeout_list )) != NULL)
+        if ((timeout = timeout_heap_head( &abs_timeouts )))
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
             timeout_t diff = (timeout->when - current_time + 9999) / 10000;
             if (diff > INT_MAX) diff = INT_MAX;
             else if (diff < 0) diff = 0;
             if (ret == -1 || diff < ret) ret = diff;
         }
 
-        if ((ptr = list_head( &rel_timeout_list )) != NULL)
+        if ((timeout = timeout_heap_head( &rel_timeouts )))
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
             timeout_t diff = (-timeout->when - monotonic_time + 9999) / 10000;
             if (diff > INT_MAX) diff = INT_MAX;
             else if (diff < 0) diff = 0;
@@ -1558,6 +1643,7 @@ static void fd_destroy( struct object *obj )
 
     if (fd->map_addr) free_map_addr( fd->map_addr, fd->map_size );
     if (fd->completion) release_object( fd->completion );
+    free_inproc_sync( &fd->comp_sync );
     remove_fd_locks( fd );
     list_remove( &fd->inode_entry );
     if (fd->poll_index != -1) remove_poll_user( fd, fd->poll_index );
@@ -1690,6 +1776,7 @@ static struct fd *alloc_fd_object(void)
     fd->poll_index = -1;
     fd->completion = NULL;
     fd->comp_flags = 0;
+    init_inproc_sync( &fd->comp_sync, INPROC_SYNC_FILE, 0, 0 );
     init_async_queue( &fd->read_q );
     init_async_queue( &fd->write_q );
     init_async_queue( &fd->wait_q );
@@ -1730,6 +1817,7 @@ struct fd *alloc_pseudo_fd( const struct fd_ops *fd_user_ops, struct object *use
     fd->poll_index = -1;
     fd->completion = NULL;
     fd->comp_flags = 0;
+    init_inproc_sync( &fd->comp_sync, INPROC_SYNC_FILE, 0, 0 );
     fd->no_fd_status = STATUS_BAD_DEVICE_TYPE;
     init_async_queue( &fd->read_q );
     init_async_queue( &fd->write_q );
@@ -2435,6 +2523,32 @@ static struct fd *get_handle_fd_obj( struct process *process, obj_handle_t handl
     return fd;
 }
 
+/* send the unix fd of a newly created handle along with the reply, */
+/* to save the client a separate get_handle_fd request to cache it */
+int send_handle_fd( obj_handle_t handle, unsigned int *access, unsigned int *options )
+{
+    unsigned int error = get_error();
+    int type = FD_TYPE_INVALID;
+    struct fd *fd;
+
+    if ((fd = get_handle_fd_obj( current->process, handle, 0 )))
+    {
+        /* handles that can't read or write data may never need the fd */
+        if (fd->cacheable && !fd->completion && fd->unix_fd != -1 &&
+            (get_handle_access( current->process, handle ) & (FILE_READ_DATA | FILE_WRITE_DATA | FILE_APPEND_DATA)))
+        {
+            type = fd->fd_ops->get_fd_type( fd );
+            *access = get_handle_access( current->process, handle );
+            *options = fd->options;
+            if (type != FD_TYPE_INVALID && send_client_fd( current->process, fd->unix_fd, handle ) == -1)
+                type = FD_TYPE_INVALID;
+        }
+        release_object( fd );
+    }
+    set_error( error );
+    return type;
+}
+
 static int is_dir_empty( int fd )
 {
     DIR *dir;
@@ -2717,6 +2831,7 @@ void fd_copy_completion( struct fd *src, struct fd *dst )
     assert( !dst->completion );
     dst->completion = fd_get_completion( src, &dst->comp_key );
     dst->comp_flags = src->comp_flags;
+    if (dst->completion) set_inproc_sync_state( &dst->comp_sync, INPROC_FILE_COMPLETION );
 }
 
 /* flush a file buffers */
@@ -2921,6 +3036,7 @@ DECL_HANDLER(set_completion_info)
         {
             fd->completion = get_completion_obj( current->process, req->chandle, IO_COMPLETION_MODIFY_STATE );
             fd->comp_key = req->ckey;
+            if (fd->completion) set_inproc_sync_state( &fd->comp_sync, INPROC_FILE_COMPLETION );
             set_fd_signaled( fd, 1 );
         }
         else set_error( STATUS_INVALID_PARAMETER );
@@ -2936,6 +3052,12 @@ DECL_HANDLER(add_fd_completion)
     {
         if (fd->completion && (req->async || !(fd->comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)))
             add_completion( fd->completion, fd->comp_key, req->cvalue, req->status, req->information );
+        else if (!fd->completion && fd->fd_ops->get_fd_type( fd ) == FD_TYPE_FILE)
+        {
+            /* let the client skip this request until a completion port is attached */
+            share_inproc_sync( &fd->comp_sync, current->process );
+            reply->sync_offset = get_inproc_sync_offset( &fd->comp_sync, req->handle, 0 );
+        }
         release_object( fd );
     }
 }
@@ -667,6 +667,8 @@ DECL_HANDLER(create_file)
                              req->create, req->options, req->attrs, sd )))
     {
         reply->handle = alloc_handle( current->process, file, req->access, objattr->attributes );
+        if (reply->handle)
+            reply->fd_type = send_handle_fd( reply->handle, &reply->fd_access, &reply->fd_options );
         release_object( file );
     }
     if (root_fd) release_object( root_fd );
@@ -129,6 +129,7 @@ extern void default_fd_queue_async( struct fd *fd, struct async *async, int type
 extern void default_fd_reselect_async( struct fd *fd, struct async_queue *queue );
 extern void main_loop(void);
 extern void remove_process_locks( struct process *process );
+extern int send_handle_fd( obj_handle_t handle, unsigned int *access, unsigned int *options );
 
 static inline struct fd *get_obj_fd( struct object *obj ) { return obj->ops->get_fd( obj ); }
 
@@ -192,12 +193,33 @@ extern struct object *create_user_data_mapping( struct object *root, const struc
 extern struct mapping *create_session_mapping( struct object *root, const struct unicode_str *name,
                                                unsigned int attr, const struct security_descriptor *sd );
 extern void set_session_mapping( struct mapping *mapping );
+extern struct mapping *create_server_mapping( mem_size_t size, void **data );
 
 extern const volatile void *alloc_shared_object(void);
 extern void free_shared_object( const volatile void *object_shm );
 extern void invalidate_shared_object( const volatile void *object_shm );
 extern struct obj_locator get_shared_object_locator( const volatile void *object_shm );
 
+/* state of an event, semaphore, mutex or socket, possibly shared with the client process */
+struct inproc_sync
+{
+    struct inproc_sync_block *block;  /* shared block holding the state, or NULL */
+    inproc_sync_t            *shm;    /* current location of the state */
+    inproc_sync_t             local;  /* server private state if not shared */
+};
+
+extern void release_inproc_sync_block( struct process *process );
+extern void init_inproc_sync( struct inproc_sync *sync, unsigned int type, unsigned __int64 state, unsigned int max );
+extern void share_inproc_sync( struct inproc_sync *sync, struct process *process );
+extern void free_inproc_sync( struct inproc_sync *sync );
+extern int is_inproc_sync_shared( const struct inproc_sync *sync, struct process *process );
+extern data_size_t get_inproc_sync_offset( const struct inproc_sync *sync, obj_handle_t handle, unsigned int access );
+extern unsigned __int64 get_inproc_sync_state( const struct inproc_sync *sync );
+extern int replace_inproc_sync_state( struct inproc_sync *sync, unsigned __int64 old, unsigned __int64 new );
+extern unsigned __int64 set_inproc_sync_state( struct inproc_sync *sync, unsigned __int64 state );
+extern int add_inproc_sync_queue( struct object *obj, struct inproc_sync *sync, struct wait_queue_entry *entry );
+extern void remove_inproc_sync_queue( struct object *obj, struct inproc_sync *sync, struct wait_queue_entry *entry );
+
 #define SHARED_WRITE_BEGIN( object_shm, type )                          \
     do {                                                                \
         const type *__shared = (object_shm);                            \
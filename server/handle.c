@@ -33,6 +33,7 @@
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "process.h"
 #include "thread.h"
@@ -45,14 +46,21 @@ struct handle_entry
     unsigned int   access;    /* access rights */
 };
 
+/* the entries are allocated in fixed size pages, so that growing the table never moves them */
+#define HANDLE_PAGE_SHIFT  8
+#define HANDLE_PAGE_SIZE   (1 << HANDLE_PAGE_SHIFT)
+#define HANDLE_PAGE_MASK   (HANDLE_PAGE_SIZE - 1)
+
 struct handle_table
 {
-    struct object        obj;         /* object header */
-    struct process      *process;     /* process owning this table */
-    int                  count;       /* number of allocated entries */
-    int                  last;        /* last used entry */
-    int                  free;        /* first entry that may be free */
-    struct handle_entry *entries;     /* handle entries */
+    struct object         obj;         /* object header */
+    struct process       *process;     /* process owning this table */
+    int                   count;       /* number of allocated entries */
+    int                   last;        /* last used entry */
+    int                   free;        /* first entry that may be free */
+    int                   max_pages;   /* size of the pages and used arrays */
+    struct handle_entry **pages;       /* pages of handle entries */
+    unsigned short       *used;        /* number of used entries in each page */
 };
 
 static struct handle_table *global_table;
@@ -63,7 +71,6 @@ static struct handle_table *global_table;
 #define RESERVED_CLOSE_PROTECT (HANDLE_FLAG_PROTECT_FROM_CLOSE << RESERVED_SHIFT)
 #define RESERVED_ALL           (RESERVED_INHERIT | RESERVED_CLOSE_PROTECT)
 
-#define MIN_HANDLE_ENTRIES  32
 #define MAX_HANDLE_ENTRIES  0x00ffffff
 
 
@@ -79,6 +86,12 @@ static inline int handle_to_index( obj_handle_t handle )
     return (handle >> 2) - 1;
 }
 
+/* get the entry at a given index, which must be below table->count */
+static inline struct handle_entry *get_entry( struct handle_table *table, int index )
+{
+    return table->pages[index >> HANDLE_PAGE_SHIFT] + (index & HANDLE_PAGE_MASK);
+}
+
 /* global handle conversion */
 
 #define HANDLE_OBFUSCATOR 0x544a4def
@@ -154,9 +167,9 @@ static void handle_table_dump( struct object *obj, int verbose )
     fprintf( stderr, "Handle table last=%d count=%d process=%p\n",
              table->last, table->count, table->process );
     if (!verbose) return;
-    entry = table->entries;
-    for (i = 0; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr) continue;
         fprintf( stderr, "    %04x: %p %08x ",
                  index_to_handle(i), entry->ptr, entry->access );
@@ -174,9 +187,12 @@ static void handle_table_destroy( struct object *obj )
 
     assert( obj->ops == &handle_table_ops );
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
-        struct object *obj = entry->ptr;
+        struct object *obj;
+
+        entry = get_entry( table, i );
+        obj = entry->ptr;
         entry->ptr = NULL;
         if (obj)
         {
@@ -185,7 +201,9 @@ static void handle_table_destroy( struct object *obj )
             release_object_from_handle( obj );
         }
     }
-    free( table->entries );
+    for (i = 0; i < table->count >> HANDLE_PAGE_SHIFT; i++) free( table->pages[i] );
+    free( table->pages );
+    free( table->used );
 }
 
 /* close all the process handles and free the handle table */
@@ -197,55 +215,99 @@ void close_process_handles( struct process *process )
     if (table) release_object( table );
 }
 
+/* grow a handle table by one page */
+static int grow_handle_table( struct handle_table *table )
+{
+    struct handle_entry *page;
+    int index = table->count >> HANDLE_PAGE_SHIFT;
+
+    if (table->count > MAX_HANDLE_ENTRIES - HANDLE_PAGE_SIZE)
+    {
+        set_error( STATUS_INSUFFICIENT_RESOURCES );
+        return 0;
+    }
+    if (index == table->max_pages)
+    {
+        int max_pages = max( 4, table->max_pages * 2 );
+        struct handle_entry **new_pages;
+        unsigned short *new_used;
+
+        if (!(new_pages = realloc( table->pages, max_pages * sizeof(*new_pages) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        table->pages = new_pages;
+        if (!(new_used = realloc( table->used, max_pages * sizeof(*new_used) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        table->used      = new_used;
+        table->max_pages = max_pages;
+    }
+    if (!(page = mem_alloc( HANDLE_PAGE_SIZE * sizeof(*page) ))) return 0;
+    table->pages[index] = page;
+    table->used[index]  = 0;
+    table->count += HANDLE_PAGE_SIZE;
+    return 1;
+}
+
 /* allocate a new handle table */
 struct handle_table *alloc_handle_table( struct process *process, int count )
 {
     struct handle_table *table;
 
-    if (count < MIN_HANDLE_ENTRIES) count = MIN_HANDLE_ENTRIES;
     if (!(table = alloc_object( &handle_table_ops )))
         return NULL;
-    table->process = process;
-    table->count   = count;
-    table->last    = -1;
-    table->free    = 0;
-    if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
-    release_object( table );
-    return NULL;
+    table->process   = process;
+    table->count     = 0;
+    table->last      = -1;
+    table->free      = 0;
+    table->max_pages = 0;
+    table->pages     = NULL;
+    table->used      = NULL;
+    do
+    {
+        if (!grow_handle_table( table ))
+        {
+            release_object( table );
+            return NULL;
+        }
+    } while (table->count < count);
+    return table;
 }
 
-/* grow a handle table */
-static int grow_handle_table( struct handle_table *table )
+/* count the used entries of every page, after entries have been copied into the table */
+static void count_used_entries( struct handle_table *table )
 {
-    struct handle_entry *new_entries;
-    int count = min( table->count * 2, MAX_HANDLE_ENTRIES );
+    int i;
 
-    if (count == table->count ||
-        !(new_entries = realloc( table->entries, count * sizeof(struct handle_entry) )))
-    {
-        set_error( STATUS_INSUFFICIENT_RESOURCES );
-        return 0;
-    }
-    table->entries = new_entries;
-    table->count   = count;
-    return 1;
+    memset( table->used, 0, (table->count >> HANDLE_PAGE_SHIFT) * sizeof(*table->used) );
+    for (i = 0; i <= table->last; i++)
+        if (get_entry( table, i )->ptr) table->used[i >> HANDLE_PAGE_SHIFT]++;
+    table->free = 0;
 }
 
-/* allocate the first free entry in the handle table */
+/* allocate a free entry in the handle table */
 static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *entry = table->entries + table->free;
-    int i;
+    struct handle_entry *entry;
+    int i = table->free;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
+    /* reuse the lowest free entry, skipping the pages that are full */
+    while (i <= table->last)
     {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
+        if (table->used[i >> HANDLE_PAGE_SHIFT] == HANDLE_PAGE_SIZE) i = (i | HANDLE_PAGE_MASK) + 1;
+        else if (!get_entry( table, i )->ptr) goto found;
+        else i++;
     }
+    if (i >= table->count && !grow_handle_table( table )) return 0;
     table->last = i;
  found:
     table->free = i + 1;
+    table->used[i >> HANDLE_PAGE_SHIFT]++;
+    entry = get_entry( table, i );
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
     return index_to_handle(i);
@@ -331,7 +393,7 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
     index = handle_to_index( handle );
     if (index < 0) return NULL;
     if (index > table->last) return NULL;
-    entry = table->entries + index;
+    entry = get_entry( table, index );
     if (!entry->ptr) return NULL;
     return entry;
 }
@@ -339,22 +401,16 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
 /* attempt to shrink a table */
 static void shrink_handle_table( struct handle_table *table )
 {
-    struct handle_entry *entry = table->entries + table->last;
-    struct handle_entry *new_entries;
-    int count = table->count;
+    int pages = table->count >> HANDLE_PAGE_SHIFT;
 
-    while (table->last >= 0)
+    while (table->last >= 0 && !get_entry( table, table->last )->ptr) table->last--;
+    if (table->last >= table->count / 4) return;  /* no need to shrink */
+    if (pages < 2) return;  /* too small to shrink */
+    while (table->count > (pages / 2) << HANDLE_PAGE_SHIFT)
     {
-        if (entry->ptr) break;
-        table->last--;
-        entry--;
+        table->count -= HANDLE_PAGE_SIZE;
+        free( table->pages[table->count >> HANDLE_PAGE_SHIFT] );
     }
-    if (table->last >= count / 4) return;  /* no need to shrink */
-    if (count < MIN_HANDLE_ENTRIES * 2) return;  /* too small to shrink */
-    count /= 2;
-    if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
-    table->count   = count;
-    table->entries = new_entries;
 }
 
 static void inherit_handle( struct process *parent, const obj_handle_t handle, struct handle_table *table )
@@ -362,14 +418,13 @@ static void inherit_handle( struct process *parent, const obj_handle_t handle, s
     struct handle_entry *dst, *src;
     int index;
 
-    dst = table->entries;
-
     src = get_handle( parent, handle );
     if (!src || !(src->access & RESERVED_INHERIT)) return;
     index = handle_to_index( handle );
-    if (dst[index].ptr) return;
+    dst = get_entry( table, index );
+    if (dst->ptr) return;
     grab_object_for_handle( src->ptr );
-    dst[index] = *src;
+    *dst = *src;
     table->last = max( table->last, index );
 }
 
@@ -391,7 +446,8 @@ struct handle_table *copy_handle_table( struct process *process, struct process
 
     if (handles)
     {
-        memset( table->entries, 0, parent_table->count * sizeof(*table->entries) );
+        for (i = 0; i < table->count >> HANDLE_PAGE_SHIFT; i++)
+            memset( table->pages[i], 0, HANDLE_PAGE_SIZE * sizeof(struct handle_entry) );
 
         for (i = 0; i < handle_count; i++)
         {
@@ -405,18 +461,18 @@ struct handle_table *copy_handle_table( struct process *process, struct process
     }
     else
     {
-        if ((table->last = parent_table->last) >= 0)
+        table->last = parent_table->last;
+        for (i = 0; i <= table->last; i++)
         {
-            struct handle_entry *ptr = table->entries;
-            memcpy( ptr, parent_table->entries, (table->last + 1) * sizeof(struct handle_entry) );
-            for (i = 0; i <= table->last; i++, ptr++)
-            {
-                if (!ptr->ptr) continue;
-                if (ptr->access & RESERVED_INHERIT) grab_object_for_handle( ptr->ptr );
-                else ptr->ptr = NULL; /* don't inherit this entry */
-            }
+            struct handle_entry *ptr = get_entry( table, i );
+
+            *ptr = *get_entry( parent_table, i );
+            if (!ptr->ptr) continue;
+            if (ptr->access & RESERVED_INHERIT) grab_object_for_handle( ptr->ptr );
+            else ptr->ptr = NULL; /* don't inherit this entry */
         }
     }
+    count_used_entries( table );
     /* attempt to shrink the table */
     shrink_handle_table( table );
     return table;
@@ -428,15 +484,26 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     struct handle_table *table;
     struct handle_entry *entry;
     struct object *obj;
+    int index;
 
     if (!(entry = get_handle( process, handle ))) return STATUS_INVALID_HANDLE;
     if (entry->access & RESERVED_CLOSE_PROTECT) return STATUS_HANDLE_NOT_CLOSABLE;
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
+    if (handle_is_global(handle))
+    {
+        table = global_table;
+        index = handle_to_index( handle_global_to_local( handle ));
+    }
+    else
+    {
+        table = process->handles;
+        index = handle_to_index( handle );
+    }
     entry->ptr = NULL;
-    table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
-    if (entry == table->entries + table->last) shrink_handle_table( table );
+    table->used[index >> HANDLE_PAGE_SHIFT]--;
+    if (index < table->free) table->free = index;
+    if (index == table->last) shrink_handle_table( table );
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
 }
@@ -516,8 +583,9 @@ obj_handle_t find_inherited_handle( struct process *process, const struct object
 
     if (!table) return 0;
 
-    for (i = 0, ptr = table->entries; i <= table->last; i++, ptr++)
+    for (i = 0; i <= table->last; i++)
     {
+        ptr = get_entry( table, i );
         if (!ptr->ptr) continue;
         if (ptr->ptr->ops != ops) continue;
         if (ptr->access & RESERVED_INHERIT) return index_to_handle(i);
@@ -529,14 +597,13 @@ obj_handle_t find_inherited_handle( struct process *process, const struct object
 unsigned int get_obj_handle_count( struct process *process, const struct object *obj )
 {
     struct handle_table *table = process->handles;
-    struct handle_entry *ptr;
     unsigned int count = 0;
     int i;
 
     if (!table) return 0;
 
-    for (i = 0, ptr = table->entries; i <= table->last; i++, ptr++)
-        if (ptr->ptr == obj) ++count;
+    for (i = 0; i <= table->last; i++)
+        if (get_entry( table, i )->ptr == obj) ++count;
     return count;
 }
 
@@ -694,6 +761,8 @@ DECL_HANDLER(dup_handle)
         {
             reply->handle = duplicate_handle( src, req->src_handle, dst,
                                               req->access, req->attributes, req->options );
+            if (reply->handle && dst == current->process)
+                reply->fd_type = send_handle_fd( reply->handle, &reply->fd_access, &reply->fd_options );
             release_object( dst );
         }
         /* close the handle no matter what happened */
@@ -846,8 +915,9 @@ static int enum_handles( struct process *process, void *user )
     if (!table)
         return 0;
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr) continue;
         if (!info->handle)
         {
@@ -906,8 +976,9 @@ static int enum_process_handles_cb( struct process *process, void *user )
     if (!table)
         return 0;
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr || entry->ptr->ops != info->ops) continue;
         if ((info->cb)( process, entry->ptr, info->user )) return 1;
     }
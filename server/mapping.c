@@ -121,6 +121,57 @@ static const struct object_ops shared_map_ops =
 
 static struct list shared_map_list = LIST_INIT( shared_map_list );
 
+enum reloc_map_state
+{
+    RELOC_MAP_FILLING,               /* a client is writing the relocated image */
+    RELOC_MAP_READY,                 /* the relocated image can be mapped */
+    RELOC_MAP_FAILED                 /* the image could not be relocated */
+};
+
+/* file holding the pages of a PE image modified by relocation to its map address, at their image offsets */
+struct reloc_map
+{
+    struct object   obj;             /* object header */
+    struct fd      *fd;              /* file descriptor of the mapped PE file */
+    client_ptr_t    base;            /* address the image is relocated to */
+    file_pos_t      file_size;       /* size of the PE file when the image was relocated */
+    time_t          mtime;           /* modification time of the PE file */
+    unsigned int    mtime_nsec;      /* nanoseconds of the modification time */
+    struct file    *file;            /* temp file holding the relocated image, NULL if relocation failed */
+    enum reloc_map_state state;      /* state of the relocated image */
+    process_id_t    filler;          /* process writing the relocated image */
+    struct list     entry;           /* entry in global relocated maps list */
+};
+
+static void reloc_map_dump( struct object *obj, int verbose );
+static void reloc_map_destroy( struct object *obj );
+
+static const struct object_ops reloc_map_ops =
+{
+    sizeof(struct reloc_map),  /* size */
+    &no_type,                  /* type */
+    reloc_map_dump,            /* dump */
+    no_add_queue,              /* add_queue */
+    NULL,                      /* remove_queue */
+    NULL,                      /* signaled */
+    NULL,                      /* satisfied */
+    no_signal,                 /* signal */
+    no_get_fd,                 /* get_fd */
+    default_map_access,        /* map_access */
+    default_get_sd,            /* get_sd */
+    default_set_sd,            /* set_sd */
+    no_get_full_name,          /* get_full_name */
+    no_lookup_name,            /* lookup_name */
+    no_link_name,              /* link_name */
+    NULL,                      /* unlink_name */
+    no_open_file,              /* open_file */
+    no_kernel_obj_list,        /* get_kernel_obj_list */
+    no_close_handle,           /* close_handle */
+    reloc_map_destroy          /* destroy */
+};
+
+static struct list reloc_map_list = LIST_INIT( reloc_map_list );
+
 /* memory view mapped in client address space */
 struct memory_view
 {
@@ -161,6 +212,7 @@ struct mapping
     struct pe_image_info image;      /* image info (for PE image mapping) */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct shared_map *shared;       /* temp file for shared PE mapping */
+    struct reloc_map *reloc;         /* temp file for relocated PE mapping */
 };
 
 static void mapping_dump( struct object *obj, int verbose );
@@ -294,6 +346,22 @@ static void shared_map_destroy( struct object *obj )
     list_remove( &shared->entry );
 }
 
+static void reloc_map_dump( struct object *obj, int verbose )
+{
+    struct reloc_map *reloc = (struct reloc_map *)obj;
+    fprintf( stderr, "Relocated mapping fd=%p base=%08x%08x file=%p state=%u\n", reloc->fd,
+             (unsigned int)(reloc->base >> 32), (unsigned int)reloc->base, reloc->file, reloc->state );
+}
+
+static void reloc_map_destroy( struct object *obj )
+{
+    struct reloc_map *reloc = (struct reloc_map *)obj;
+
+    release_object( reloc->fd );
+    if (reloc->file) release_object( reloc->file );
+    list_remove( &reloc->entry );
+}
+
 /* extend a file beyond the current end of file */
 int grow_file( int unix_fd, file_pos_t new_size )
 {
@@ -687,6 +755,86 @@ static int build_shared_mapping( struct mapping *mapping, int fd,
     return 0;
 }
 
+/* check whether a relocated image was built from the current contents of the mapped file */
+static int reloc_map_matches( struct reloc_map *reloc, struct mapping *mapping, const struct stat *st )
+{
+    if (reloc->base != mapping->image.map_addr || !is_same_file_fd( reloc->fd, mapping->fd )) return 0;
+    if (reloc->file_size != st->st_size || reloc->mtime != st->st_mtime) return 0;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    if (reloc->mtime_nsec != st->st_mtim.tv_nsec) return 0;
+#endif
+    return 1;
+}
+
+/* check whether the process writing a relocated image exited before reporting the result */
+static int reloc_filler_exited( struct reloc_map *reloc )
+{
+    struct process *process;
+    int ret;
+
+    if (!(process = get_process_from_id( reloc->filler )))
+    {
+        clear_error();
+        return 1;
+    }
+    ret = !process->running_threads;
+    release_object( process );
+    return ret;
+}
+
+/* get the temp file holding an image relocated to its mapping address, to be written by a client */
+static struct reloc_map *get_reloc_map( struct mapping *mapping )
+{
+    struct reloc_map *reloc;
+    struct file *file = NULL;
+    struct stat st;
+    int unix_fd, reloc_fd;
+
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1) return NULL;
+    if (fstat( unix_fd, &st ) == -1)
+    {
+        file_set_error();
+        return NULL;
+    }
+
+    if (mapping->reloc)
+    {
+        if (reloc_map_matches( mapping->reloc, mapping, &st )) return mapping->reloc;
+        release_object( mapping->reloc );
+        mapping->reloc = NULL;
+    }
+
+    LIST_FOR_EACH_ENTRY( reloc, &reloc_map_list, struct reloc_map, entry )
+    {
+        if (!reloc_map_matches( reloc, mapping, &st )) continue;
+        return mapping->reloc = (struct reloc_map *)grab_object( reloc );
+    }
+
+    if ((reloc_fd = create_temp_file( mapping->image.map_size )) != -1)
+        file = create_file_for_fd( reloc_fd, FILE_GENERIC_READ | FILE_GENERIC_WRITE, 0 );
+
+    if (!(reloc = alloc_object( &reloc_map_ops )))
+    {
+        if (file) release_object( file );
+        return NULL;
+    }
+    reloc->fd         = (struct fd *)grab_object( mapping->fd );
+    reloc->base       = mapping->image.map_addr;
+    reloc->file_size  = st.st_size;
+    reloc->mtime      = st.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    reloc->mtime_nsec = st.st_mtim.tv_nsec;
+#else
+    reloc->mtime_nsec = 0;
+#endif
+    reloc->file       = file;
+    reloc->filler     = current->process->id;
+    /* failures are remembered too, so that the image isn't relocated again for every mapping */
+    reloc->state      = file ? RELOC_MAP_FILLING : RELOC_MAP_FAILED;
+    list_add_head( &reloc_map_list, &reloc->entry );
+    return mapping->reloc = reloc;
+}
+
 /* load a data directory header from its section */
 static int load_data_dir( void *dir, size_t dir_size, size_t va, size_t size, int unix_fd,
                           IMAGE_SECTION_HEADER *sec, unsigned int nb_sec )
@@ -1015,6 +1163,7 @@ static struct mapping *create_mapping( struct object *root, const struct unicode
     mapping->size        = size;
     mapping->fd          = NULL;
     mapping->shared      = NULL;
+    mapping->reloc       = NULL;
     mapping->committed   = NULL;
 
     if (!(mapping->flags = get_mapping_flags( handle, flags ))) goto error;
@@ -1104,6 +1253,7 @@ struct mapping *create_fd_mapping( struct object *root, const struct unicode_str
     if (get_error() == STATUS_OBJECT_NAME_EXISTS) return mapping;  /* Nothing else to do */
 
     mapping->shared    = NULL;
+    mapping->reloc     = NULL;
     mapping->committed = NULL;
     mapping->flags     = SEC_FILE;
     mapping->fd        = (struct fd *)grab_object( fd );
@@ -1216,6 +1366,7 @@ static void mapping_destroy( struct object *obj )
     if (mapping->fd) release_object( mapping->fd );
     if (mapping->committed) release_object( mapping->committed );
     if (mapping->shared) release_object( mapping->shared );
+    if (mapping->reloc) release_object( mapping->reloc );
 }
 
 static enum server_fd_type mapping_get_fd_type( struct fd *fd )
@@ -1432,6 +1583,242 @@ struct obj_locator get_shared_object_locator( const volatile void *object_shm )
     return locator;
 }
 
+#define INPROC_SYNC_BLOCK_SIZE  0x10000
+#define INPROC_SYNC_BLOCK_COUNT (INPROC_SYNC_BLOCK_SIZE / sizeof(inproc_sync_t))
+
+/* block of in-process sync objects shared with a single client process */
+struct inproc_sync_block
+{
+    struct object   obj;             /* object header */
+    struct mapping *mapping;         /* mapping shared with the client */
+    inproc_sync_t  *data;            /* server view of the shared data */
+    struct process *process;         /* process using the block, NULL once it's gone */
+    unsigned int    used;            /* number of entries ever allocated */
+    unsigned int    free_count;      /* number of entries in the free list */
+    unsigned short  free[INPROC_SYNC_BLOCK_COUNT]; /* free entries list */
+};
+
+static void inproc_sync_block_dump( struct object *obj, int verbose );
+static void inproc_sync_block_destroy( struct object *obj );
+
+static const struct object_ops inproc_sync_block_ops =
+{
+    sizeof(struct inproc_sync_block), /* size */
+    &no_type,                         /* type */
+    inproc_sync_block_dump,           /* dump */
+    no_add_queue,                     /* add_queue */
+    NULL,                             /* remove_queue */
+    NULL,                             /* signaled */
+    NULL,                             /* satisfied */
+    no_signal,                        /* signal */
+    no_get_fd,                        /* get_fd */
+    default_map_access,               /* map_access */
+    default_get_sd,                   /* get_sd */
+    default_set_sd,                   /* set_sd */
+    no_get_full_name,                 /* get_full_name */
+    no_lookup_name,                   /* lookup_name */
+    no_link_name,                     /* link_name */
+    NULL,                             /* unlink_name */
+    no_open_file,                     /* open_file */
+    no_kernel_obj_list,               /* get_kernel_obj_list */
+    no_close_handle,                  /* close_handle */
+    inproc_sync_block_destroy         /* destroy */
+};
+
+static void inproc_sync_block_dump( struct object *obj, int verbose )
+{
+    struct inproc_sync_block *block = (struct inproc_sync_block *)obj;
+    fprintf( stderr, "In-process sync block process=%p used=%u free=%u\n",
+             block->process, block->used, block->free_count );
+}
+
+static void inproc_sync_block_destroy( struct object *obj )
+{
+    struct inproc_sync_block *block = (struct inproc_sync_block *)obj;
+
+    assert( !block->process );
+    if (block->data) munmap( (void *)block->data, INPROC_SYNC_BLOCK_SIZE );
+    if (block->mapping) release_object( block->mapping );
+}
+
+/* get the in-process sync block of a process, creating it if needed */
+static struct inproc_sync_block *get_inproc_sync_block( struct process *process )
+{
+    struct inproc_sync_block *block;
+    void *ptr;
+
+    if (process->inproc_sync) return process->inproc_sync;
+
+    if (!(block = alloc_object( &inproc_sync_block_ops ))) return NULL;
+    block->data       = NULL;
+    block->process    = NULL;
+    block->used       = 1;  /* offset 0 is reserved to mean no object */
+    block->free_count = 0;
+    if (!(block->mapping = create_server_mapping( INPROC_SYNC_BLOCK_SIZE, &ptr ))) goto error;
+    block->data = ptr;
+    block->process = process;
+    process->inproc_sync = block;
+    return block;
+
+error:
+    release_object( block );
+    return NULL;
+}
+
+/* detach a dying process from its in-process sync block */
+void release_inproc_sync_block( struct process *process )
+{
+    struct inproc_sync_block *block = process->inproc_sync;
+
+    if (!block) return;
+    block->process = NULL;
+    process->inproc_sync = NULL;
+    release_object( block );
+}
+
+/* initialize the state of a sync object, stored privately in the server */
+void init_inproc_sync( struct inproc_sync *sync, unsigned int type, unsigned __int64 state, unsigned int max )
+{
+    sync->block       = NULL;
+    sync->shm         = &sync->local;
+    sync->local.state = state;
+    sync->local.type  = type;
+    sync->local.max   = max;
+}
+
+/* move the state of a newly created sync object to the shared block of a process, if it has one */
+void share_inproc_sync( struct inproc_sync *sync, struct process *process )
+{
+    struct inproc_sync_block *block = process->inproc_sync;
+    unsigned int index;
+
+    if (!block || sync->block) return;
+    if (block->free_count) index = block->free[--block->free_count];
+    else if (block->used < INPROC_SYNC_BLOCK_COUNT) index = block->used++;
+    else return;  /* block is full, keep the object private */
+
+    block->data[index].type  = sync->local.type;
+    block->data[index].max   = sync->local.max;
+    block->data[index].state = sync->local.state;
+    sync->block = (struct inproc_sync_block *)grab_object( block );
+    sync->shm   = &block->data[index];
+}
+
+/* release the shared entry of a sync object */
+void free_inproc_sync( struct inproc_sync *sync )
+{
+    struct inproc_sync_block *block = sync->block;
+
+    if (!block) return;
+    sync->shm->type  = INPROC_SYNC_NONE;
+    sync->shm->state = 0;
+    block->free[block->free_count++] = sync->shm - block->data;
+    sync->block = NULL;
+    sync->shm   = &sync->local;
+    release_object( block );
+}
+
+/* check if a sync object lives in the shared block of a given process */
+int is_inproc_sync_shared( const struct inproc_sync *sync, struct process *process )
+{
+    return sync->block && sync->block->process == process;
+}
+
+/* get the offset of a sync object in the shared block, for returning to the client */
+data_size_t get_inproc_sync_offset( const struct inproc_sync *sync, obj_handle_t handle, unsigned int access )
+{
+    if (!handle || !is_inproc_sync_shared( sync, current->process )) return 0;
+    /* only expose it if the client can perform all the operations on its own */
+    if ((get_handle_access( current->process, handle ) & access) != access) return 0;
+    return (const char *)sync->shm - (const char *)sync->block->data;
+}
+
+/* get the current state of a sync object */
+unsigned __int64 get_inproc_sync_state( const struct inproc_sync *sync )
+{
+    return __atomic_load_n( &sync->shm->state, __ATOMIC_SEQ_CST ) & ~INPROC_SYNC_SERVER_WAIT;
+}
+
+/* atomically replace the state of a sync object, return 0 if it changed in the meantime */
+int replace_inproc_sync_state( struct inproc_sync *sync, unsigned __int64 old, unsigned __int64 new )
+{
+    /* only the server changes the wait flag, so it can't change under us */
+    unsigned __int64 flag = __atomic_load_n( &sync->shm->state, __ATOMIC_SEQ_CST ) & INPROC_SYNC_SERVER_WAIT;
+
+    old |= flag;
+    new |= flag;
+    return __atomic_compare_exchange_n( &sync->shm->state, &old, new, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+}
+
+/* set the state of a sync object and return the previous one */
+unsigned __int64 set_inproc_sync_state( struct inproc_sync *sync, unsigned __int64 state )
+{
+    unsigned __int64 old;
+
+    do old = get_inproc_sync_state( sync );
+    while (!replace_inproc_sync_state( sync, old, state ));
+    return old;
+}
+
+/* add a thread to the wait queue of a sync object, preventing the client from changing its state */
+int add_inproc_sync_queue( struct object *obj, struct inproc_sync *sync, struct wait_queue_entry *entry )
+{
+    /* the flag must be visible before checking whether the object is signaled */
+    if (list_empty( &obj->wait_queue ))
+        __atomic_fetch_or( &sync->shm->state, INPROC_SYNC_SERVER_WAIT, __ATOMIC_SEQ_CST );
+    return add_queue( obj, entry );
+}
+
+/* remove a thread from the wait queue of a sync object */
+void remove_inproc_sync_queue( struct object *obj, struct inproc_sync *sync, struct wait_queue_entry *entry )
+{
+    list_remove( &entry->entry );
+    if (list_empty( &obj->wait_queue ))
+        __atomic_fetch_and( &sync->shm->state, ~INPROC_SYNC_SERVER_WAIT, __ATOMIC_SEQ_CST );
+    release_object( obj );
+}
+
+/* create an anonymous mapping shared between the server and its clients, and map it in the server */
+struct mapping *create_server_mapping( mem_size_t size, void **data )
+{
+    struct mapping *mapping;
+    void *ptr;
+
+    if (!(mapping = create_mapping( NULL, NULL, 0, size, SEC_COMMIT, 0,
+                                    FILE_READ_DATA | FILE_WRITE_DATA, NULL ))) return NULL;
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
+    if (ptr == MAP_FAILED)
+    {
+        file_set_error();
+        release_object( mapping );
+        return NULL;
+    }
+    *data = ptr;
+    return mapping;
+}
+
+/* get the size of the pages used for large page allocations, 0 if not supported */
+static unsigned int get_large_page_minimum(void)
+{
+    unsigned long size = 0;
+#ifdef __linux__
+    char buffer[64];
+    FILE *f;
+
+    /* large pages are backed by transparent huge pages */
+    if (!(f = fopen( "/sys/kernel/mm/transparent_hugepage/enabled", "r" ))) return 0;
+    if (!fgets( buffer, sizeof(buffer), f ) || strstr( buffer, "[never]" )) buffer[0] = 0;
+    fclose( f );
+    if (!buffer[0]) return 0;
+
+    if (!(f = fopen( "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r" ))) return 0;
+    if (fscanf( f, "%lu", &size ) != 1) size = 0;
+    fclose( f );
+    if ((size & (size - 1)) || size > 0x80000000) size = 0;
+#endif
+    return size;
+}
+
 struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -1445,6 +1832,7 @@ struct object *create_user_data_mapping( struct object *root, const struct unico
     {
         user_shared_data = ptr;
         user_shared_data->SystemCall = 1;
+        user_shared_data->LargePageMinimum = get_large_page_minimum();
     }
     return &mapping->obj;
 }
@@ -1539,6 +1927,72 @@ DECL_HANDLER(get_image_map_address)
     release_object( mapping );
 }
 
+/* get the file holding an image mapping relocated to its map address */
+DECL_HANDLER(get_image_reloc_file)
+{
+    struct mapping *mapping;
+    struct reloc_map *reloc;
+
+    if (!(mapping = get_mapping_obj( current->process, req->handle, SECTION_MAP_READ ))) return;
+
+    /* shared sections and hybrid images need more than base relocations */
+    if (!(mapping->flags & SEC_IMAGE) || !mapping->image.map_addr ||
+        mapping->image.map_addr == mapping->image.base ||
+        (mapping->image.image_flags & IMAGE_FLAGS_ImageMappedFlat) ||
+        mapping->image.is_hybrid || mapping->shared)
+    {
+        set_error( STATUS_NOT_SUPPORTED );
+    }
+    else if ((reloc = get_reloc_map( mapping )))
+    {
+        switch (reloc->state)
+        {
+        case RELOC_MAP_FILLING:
+            if (!reloc->filler || (reloc->filler != current->process->id && reloc_filler_exited( reloc )))
+                reloc->filler = current->process->id;
+            if (reloc->filler != current->process->id)
+            {
+                set_error( STATUS_PENDING );
+                break;
+            }
+            reply->file = alloc_handle( current->process, reloc->file, GENERIC_READ | GENERIC_WRITE, 0 );
+            reply->fill = 1;
+            break;
+        case RELOC_MAP_READY:
+            reply->file = alloc_handle( current->process, reloc->file, GENERIC_READ, 0 );
+            break;
+        case RELOC_MAP_FAILED:
+            set_error( STATUS_NOT_SUPPORTED );
+            break;
+        }
+    }
+
+    release_object( mapping );
+}
+
+/* report whether the relocated image file of a mapping has been written */
+DECL_HANDLER(set_image_reloc_file)
+{
+    struct mapping *mapping;
+    struct reloc_map *reloc;
+
+    if (!(mapping = get_mapping_obj( current->process, req->handle, SECTION_MAP_READ ))) return;
+
+    if (!(reloc = mapping->reloc) || reloc->state != RELOC_MAP_FILLING || reloc->filler != current->process->id)
+        set_error( STATUS_INVALID_PARAMETER );
+    else if (req->status == STATUS_SUCCESS)
+        reloc->state = RELOC_MAP_READY;
+    else if (req->status == STATUS_RETRY)
+        reloc->filler = 0;
+    else
+    {
+        reloc->state = RELOC_MAP_FAILED;
+        release_object( reloc->file );
+        reloc->file = NULL;
+    }
+    release_object( mapping );
+}
+
 /* add a memory view in the current process */
 DECL_HANDLER(map_view)
 {
@@ -1737,3 +2191,14 @@ DECL_HANDLER(get_mapping_filename)
 
     release_object( process );
 }
+
+/* get the shared mapping holding the in-process sync objects of the current process */
+DECL_HANDLER(get_inproc_sync_mapping)
+{
+    struct inproc_sync_block *block;
+
+    if (!(block = get_inproc_sync_block( current->process ))) return;
+    reply->handle = alloc_handle( current->process, block->mapping,
+                                  SECTION_QUERY | SECTION_MAP_READ | SECTION_MAP_WRITE, 0 );
+    reply->size   = INPROC_SYNC_BLOCK_SIZE;
+}
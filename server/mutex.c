@@ -31,8 +31,10 @@
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "thread.h"
+#include "process.h"
 #include "request.h"
 #include "security.h"
 
@@ -53,13 +55,14 @@ struct type_descr mutex_type =
 struct mutex
 {
     struct object  obj;             /* object header */
-    struct thread *owner;           /* mutex owner */
-    unsigned int   count;           /* recursion count */
-    int            abandoned;       /* has it been abandoned? */
     struct list    entry;           /* entry in owner thread mutex list */
+    struct list    inproc_entry;    /* entry in the list of mutexes shared with the client process */
+    struct inproc_sync sync;        /* owner, count and abandoned state, possibly shared with the client */
 };
 
 static void mutex_dump( struct object *obj, int verbose );
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_destroy( struct object *obj );
@@ -70,8 +73,8 @@ static const struct object_ops mutex_ops =
     sizeof(struct mutex),      /* size */
     &mutex_type,               /* type */
     mutex_dump,                /* dump */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    mutex_add_queue,           /* add_queue */
+    mutex_remove_queue,        /* remove_queue */
     mutex_signaled,            /* signaled */
     mutex_satisfied,           /* satisfied */
     mutex_signal,              /* signal */
@@ -89,27 +92,54 @@ static const struct object_ops mutex_ops =
     mutex_destroy              /* destroy */
 };
 
+static inline unsigned int mutex_owner( unsigned __int64 state )
+{
+    return state & INPROC_SYNC_MUTEX_OWNER;
+}
+
+static inline unsigned int mutex_count( unsigned __int64 state )
+{
+    return (state >> INPROC_SYNC_MUTEX_COUNT_SHIFT) & INPROC_SYNC_MUTEX_COUNT_MAX;
+}
+
+static inline unsigned __int64 mutex_state( unsigned int owner, unsigned int count, unsigned __int64 abandoned )
+{
+    return owner | ((unsigned __int64)count << INPROC_SYNC_MUTEX_COUNT_SHIFT) | abandoned;
+}
+
+/* check if a mutex is currently owned by a given thread */
+static int is_mutex_owner( struct mutex *mutex, struct thread *thread )
+{
+    unsigned __int64 state = get_inproc_sync_state( &mutex->sync );
+    return mutex_count( state ) && mutex_owner( state ) == thread->id;
+}
 
 /* grab a mutex for a given thread */
 static void do_grab( struct mutex *mutex, struct thread *thread )
 {
-    assert( !mutex->count || (mutex->owner == thread) );
+    unsigned __int64 state = get_inproc_sync_state( &mutex->sync );
+    unsigned int count = mutex_count( state );
+
+    assert( !count || mutex_owner( state ) == thread->id );
 
-    if (!mutex->count++)  /* FIXME: avoid wrap-around */
+    if (!count)
     {
-        assert( !mutex->owner );
-        mutex->owner = thread;
+        /* the mutex may still be in the list of a thread that released it on the client side */
+        list_remove( &mutex->entry );
         list_add_head( &thread->mutex_list, &mutex->entry );
     }
+    /* FIXME: avoid wrap-around */
+    set_inproc_sync_state( &mutex->sync, mutex_state( thread->id, (count + 1) & INPROC_SYNC_MUTEX_COUNT_MAX,
+                                                      state & INPROC_SYNC_MUTEX_ABANDONED ));
 }
 
 /* release a mutex once the recursion count is 0 */
-static void do_release( struct mutex *mutex )
+static void do_release( struct mutex *mutex, unsigned __int64 abandoned )
 {
-    assert( !mutex->count );
     /* remove the mutex from the thread list of owned mutexes */
     list_remove( &mutex->entry );
-    mutex->owner = NULL;
+    list_init( &mutex->entry );
+    set_inproc_sync_state( &mutex->sync, mutex_state( 0, 0, abandoned ));
     wake_up( &mutex->obj, 0 );
 }
 
@@ -123,9 +153,9 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
         if (get_error() != STATUS_OBJECT_NAME_EXISTS)
         {
             /* initialize it if it didn't already exist */
-            mutex->count = 0;
-            mutex->owner = NULL;
-            mutex->abandoned = 0;
+            list_init( &mutex->entry );
+            list_init( &mutex->inproc_entry );
+            init_inproc_sync( &mutex->sync, INPROC_SYNC_MUTEX, 0, 0 );
             if (owned) do_grab( mutex, current );
         }
     }
@@ -134,40 +164,111 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
 
 void abandon_mutexes( struct thread *thread )
 {
+    struct mutex *mutex, *next;
     struct list *ptr;
 
     while ((ptr = list_head( &thread->mutex_list )) != NULL)
     {
-        struct mutex *mutex = LIST_ENTRY( ptr, struct mutex, entry );
-        assert( mutex->owner == thread );
-        mutex->count = 0;
-        mutex->abandoned = 1;
-        do_release( mutex );
+        mutex = LIST_ENTRY( ptr, struct mutex, entry );
+        if (is_mutex_owner( mutex, thread )) do_release( mutex, INPROC_SYNC_MUTEX_ABANDONED );
+        else
+        {
+            /* released on the client side */
+            list_remove( &mutex->entry );
+            list_init( &mutex->entry );
+        }
+    }
+
+    /* the client may also have acquired the mutexes shared with its process on its own */
+    LIST_FOR_EACH_ENTRY_SAFE( mutex, next, &thread->process->inproc_mutexes, struct mutex, inproc_entry )
+    {
+        if (is_mutex_owner( mutex, thread )) do_release( mutex, INPROC_SYNC_MUTEX_ABANDONED );
+    }
+}
+
+/* detach the mutexes shared with a dying process */
+void release_inproc_mutexes( struct process *process )
+{
+    struct list *ptr;
+
+    while ((ptr = list_head( &process->inproc_mutexes )) != NULL)
+    {
+        list_remove( ptr );
+        list_init( ptr );
     }
 }
 
 static void mutex_dump( struct object *obj, int verbose )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    unsigned __int64 state = get_inproc_sync_state( &mutex->sync );
+
+    assert( obj->ops == &mutex_ops );
+    fprintf( stderr, "Mutex count=%u owner=%04x shared=%d\n", mutex_count( state ), mutex_owner( state ),
+             mutex->sync.block != NULL );
+}
+
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    return add_inproc_sync_queue( obj, &mutex->sync, entry );
+}
+
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
-    fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
+    remove_inproc_sync_queue( obj, &mutex->sync, entry );
 }
 
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
+    unsigned __int64 state = get_inproc_sync_state( &mutex->sync );
+
     assert( obj->ops == &mutex_ops );
-    return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
+    return (!mutex_count( state ) || mutex_owner( state ) == get_wait_queue_thread( entry )->id);
 }
 
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
+    unsigned __int64 state;
+
     assert( obj->ops == &mutex_ops );
 
     do_grab( mutex, get_wait_queue_thread( entry ));
-    if (mutex->abandoned) make_wait_abandoned( entry );
-    mutex->abandoned = 0;
+    state = get_inproc_sync_state( &mutex->sync );
+    if (state & INPROC_SYNC_MUTEX_ABANDONED)
+    {
+        make_wait_abandoned( entry );
+        set_inproc_sync_state( &mutex->sync, state & ~INPROC_SYNC_MUTEX_ABANDONED );
+    }
+}
+
+/* release a mutex owned by the current thread */
+static int release_mutex( struct mutex *mutex, unsigned int *prev_count )
+{
+    unsigned __int64 state;
+    unsigned int count;
+
+    do
+    {
+        state = get_inproc_sync_state( &mutex->sync );
+        count = mutex_count( state );
+        if (!count || mutex_owner( state ) != current->id)
+        {
+            set_error( STATUS_MUTANT_NOT_OWNED );
+            return 0;
+        }
+        if (count == 1) break;
+    } while (!replace_inproc_sync_state( &mutex->sync, state, mutex_state( current->id, count - 1,
+                                         state & INPROC_SYNC_MUTEX_ABANDONED )));
+
+    if (prev_count) *prev_count = count;
+    if (count == 1) do_release( mutex, state & INPROC_SYNC_MUTEX_ABANDONED );
+    return 1;
 }
 
 static int mutex_signal( struct object *obj, unsigned int access )
@@ -180,13 +281,7 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
-    if (!mutex->count || (mutex->owner != current))
-    {
-        set_error( STATUS_MUTANT_NOT_OWNED );
-        return 0;
-    }
-    if (!--mutex->count) do_release( mutex );
-    return 1;
+    return release_mutex( mutex, NULL );
 }
 
 static void mutex_destroy( struct object *obj )
@@ -194,9 +289,9 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
-    if (!mutex->count) return;
-    mutex->count = 0;
-    do_release( mutex );
+    list_remove( &mutex->entry );
+    list_remove( &mutex->inproc_entry );
+    free_inproc_sync( &mutex->sync );
 }
 
 /* create a mutex */
@@ -215,8 +310,14 @@ DECL_HANDLER(create_mutex)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, mutex, req->access, objattr->attributes );
         else
+        {
+            share_inproc_sync( &mutex->sync, current->process );
+            if (mutex->sync.block) list_add_tail( &current->process->inproc_mutexes, &mutex->inproc_entry );
             reply->handle = alloc_handle_no_access_check( current->process, mutex,
                                                           req->access, objattr->attributes );
+        }
+        reply->sync_offset = get_inproc_sync_offset( &mutex->sync, reply->handle,
+                                                     SYNCHRONIZE | MUTANT_QUERY_STATE );
         release_object( mutex );
     }
 
@@ -240,12 +341,7 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
-        if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
-        else
-        {
-            reply->prev_count = mutex->count;
-            if (!--mutex->count) do_release( mutex );
-        }
+        release_mutex( mutex, &reply->prev_count );
         release_object( mutex );
     }
 }
@@ -258,9 +354,11 @@ DECL_HANDLER(query_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  MUTANT_QUERY_STATE, &mutex_ops )))
     {
-        reply->count = mutex->count;
-        reply->owned = (mutex->owner == current);
-        reply->abandoned = mutex->abandoned;
+        unsigned __int64 state = get_inproc_sync_state( &mutex->sync );
+
+        reply->count = mutex_count( state );
+        reply->owned = reply->count && mutex_owner( state ) == current->id;
+        reply->abandoned = !!(state & INPROC_SYNC_MUTEX_ABANDONED);
 
         release_object( mutex );
     }
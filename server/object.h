@@ -227,6 +227,7 @@ extern void reset_event( struct event *event );
 /* mutex functions */
 
 extern void abandon_mutexes( struct thread *thread );
+extern void release_inproc_mutexes( struct process *process );
 
 /* serial functions */
 
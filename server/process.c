@@ -676,6 +676,7 @@ struct process *create_process( int fd, struct process *parent, unsigned int fla
     process->peb             = 0;
     process->ldt_copy        = 0;
     process->dir_cache       = NULL;
+    process->inproc_sync     = NULL;
     process->winstation      = 0;
     process->desktop         = 0;
     process->token           = NULL;
@@ -692,6 +693,7 @@ struct process *create_process( int fd, struct process *parent, unsigned int fla
     list_init( &process->asyncs );
     list_init( &process->classes );
     list_init( &process->views );
+    list_init( &process->inproc_mutexes );
 
     process->end_time = 0;
 
@@ -784,6 +786,8 @@ static void process_destroy( struct object *obj )
     free( process->rawinput_devices );
     free( process->dir_cache );
     free( process->image );
+    release_inproc_mutexes( process );
+    release_inproc_sync_block( process );
 }
 
 /* dump a process on stdout for debugging purposes */
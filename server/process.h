@@ -78,6 +78,8 @@ struct process
     client_ptr_t         peb;             /* PEB address in client address space */
     client_ptr_t         ldt_copy;        /* pointer to LDT copy in client addr space */
     struct dir_cache    *dir_cache;       /* map of client-side directory cache */
+    struct inproc_sync_block *inproc_sync; /* block of in-process sync objects */
+    struct list          inproc_mutexes;  /* mutexes the client can acquire on its own */
     unsigned int         trace_data;      /* opaque data used by the process tracing mechanism */
     struct rawinput_device *rawinput_devices;     /* list of registered rawinput devices */
     unsigned int         rawinput_device_count;   /* number of registered rawinput devices */
@@ -27,6 +27,7 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -90,7 +91,10 @@ static int open_proc_lwpctl( struct thread *thread )
 /* handle a SIGCHLD signal */
 void sigchld_callback(void)
 {
-    assert( 0 );  /* should only be called when using ptrace */
+    int status;
+
+    /* the only children are the background registry savers */
+    while (waitpid( -1, &status, WNOHANG ) > 0);
 }
 
 /* initialize the process tracing mechanism */
@@ -26,13 +26,18 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -74,6 +79,14 @@ struct type_descr key_type =
     },
 };
 
+/* hash index of the subkeys or values of a key, only used for keys with many entries */
+struct name_index
+{
+    unsigned int      size;        /* number of hash slots, 0 if the entries aren't indexed */
+    int               sorted;      /* number of sorted entries at the start of the array */
+    int              *slots;       /* array indices of the entries, -1 for empty slots */
+};
+
 /* a registry key */
 struct key
 {
@@ -83,13 +96,16 @@ struct key
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
     struct key      **subkeys;     /* subkeys array */
+    struct name_index subkey_index; /* subkeys hash index */
     struct key       *wow6432node; /* Wow6432Node subkey */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
     struct key_value *values;      /* values array */
+    struct name_index value_index; /* values hash index */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    unsigned __int64  id;          /* unique id, identifies the key in the client caches */
 };
 
 /* key flags */
@@ -114,6 +130,7 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_INDEXED  256 /* min. number of subkeys or values for a key to use a hash index */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -121,9 +138,15 @@ struct key_value
 /* the root of the registry tree */
 static struct key *root_key;
 
+/* change serials shared with the clients */
+static struct mapping *registry_mapping;
+static registry_shm_t *registry_shm;
+static unsigned __int64 next_key_id;
+
 static const timeout_t ticks_1601_to_1970 = (timeout_t)86400 * (369 * 365 + 89) * TICKS_PER_SEC;
 static const timeout_t save_period = 30 * -TICKS_PER_SEC;  /* delay between periodic saves */
 static struct timeout_user *save_timeout_user;  /* saving timer */
+static int save_pipe = -1;  /* pipe to the background saving process */
 static enum prefix_type { PREFIX_UNKNOWN, PREFIX_32BIT, PREFIX_64BIT } prefix_type;
 
 static const WCHAR wow6432node[] = {'W','o','w','6','4','3','2','N','o','d','e'};
@@ -131,6 +154,7 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
+static void save_branch_cache( struct key *key, const char *filename );
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
 
 /* information about where to save a registry branch */
@@ -160,6 +184,64 @@ struct file_load_info
     size_t      tmplen;   /* length of temp buffer */
 };
 
+/* binary cache of a registry branch, to avoid parsing the text file on startup */
+/* the text file remains the reference, the cache is only used if it matches it */
+
+#define HIVE_CACHE_VERSION 1
+
+struct hive_cache_header
+{
+    char             magic[8];    /* HIVE_CACHE_MAGIC */
+    unsigned int     version;     /* HIVE_CACHE_VERSION */
+    unsigned int     prefix_type; /* prefix architecture */
+    unsigned __int64 file_size;   /* size of the text file */
+    unsigned __int64 file_mtime;  /* modification time of the text file */
+    unsigned __int64 file_nsec;   /* nanoseconds part of the modification time */
+    unsigned __int64 file_ino;    /* inode of the text file */
+    unsigned __int64 data_size;   /* size of the records following the header */
+    unsigned __int64 checksum;    /* FNV-1a hash of the records */
+};
+
+/* all records are followed by their variable-size data, and padded to 8 bytes */
+struct hive_cache_key
+{
+    timeout_t        modif;       /* last modification time */
+    unsigned int     flags;       /* HIVE_KEY_* flags */
+    unsigned int     namelen;     /* length of the name, followed by the name (0 for the branch root) */
+    unsigned int     classlen;    /* length of the class, followed by the class */
+    unsigned int     values;      /* number of value records following the key */
+    unsigned int     subkeys;     /* number of subkey records following the values */
+    unsigned int     __pad;
+};
+
+#define HIVE_KEY_SAVED   0x01  /* key is saved explicitly in the text file */
+#define HIVE_KEY_SYMLINK 0x02  /* key is a symbolic link */
+
+struct hive_cache_value
+{
+    unsigned int     namelen;     /* length of the name, followed by the name */
+    unsigned int     type;        /* value type */
+    data_size_t      len;         /* length of the data, followed by the data */
+    unsigned int     __pad;
+};
+
+struct hive_cache_reader
+{
+    const char      *ptr;         /* current position */
+    const char      *end;         /* end of the records */
+};
+
+struct hive_cache_writer
+{
+    FILE            *file;        /* output file */
+    unsigned __int64 size;        /* size of the records written so far */
+    unsigned __int64 checksum;    /* hash of the records written so far */
+};
+
+static const char hive_cache_magic[8] = {'W','i','n','e','H','i','v','e'};
+static const unsigned __int64 fnv_offset_basis = 0xcbf29ce484222325ull;
+static const unsigned __int64 fnv_prime = 0x100000001b3ull;
+
 
 static void key_dump( struct object *obj, int verbose );
 static unsigned int key_map_access( struct object *obj, unsigned int access );
@@ -285,8 +367,221 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
-/* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+/*
+ * Keys with many subkeys or values use a hash index to look them up. New
+ * entries of indexed keys are appended to the array without moving the
+ * existing ones, and the array is sorted again only when it needs to be
+ * enumerated or saved.
+ */
+
+typedef void (*get_name_func)( const struct key *key, int i, struct unicode_str *name );
+
+static void get_subkey_name( const struct key *key, int i, struct unicode_str *name )
+{
+    name->str = key->subkeys[i]->obj.name->name;
+    name->len = key->subkeys[i]->obj.name->len;
+}
+
+static void get_value_name( const struct key *key, int i, struct unicode_str *name )
+{
+    name->str = key->values[i].name;
+    name->len = key->values[i].namelen;
+}
+
+static int compare_names( const struct unicode_str *name1, const struct unicode_str *name2 )
+{
+    int res = memicmp_strW( name1->str, name2->str, min( name1->len, name2->len ));
+    if (!res) res = name1->len - name2->len;
+    return res;
+}
+
+static int compare_subkeys( const void *ptr1, const void *ptr2 )
+{
+    const struct key *key1 = *(struct key * const *)ptr1;
+    const struct key *key2 = *(struct key * const *)ptr2;
+    struct unicode_str name1 = { key1->obj.name->name, key1->obj.name->len };
+    struct unicode_str name2 = { key2->obj.name->name, key2->obj.name->len };
+
+    return compare_names( &name1, &name2 );
+}
+
+static int compare_values( const void *ptr1, const void *ptr2 )
+{
+    const struct key_value *value1 = ptr1;
+    const struct key_value *value2 = ptr2;
+    struct unicode_str name1 = { value1->name, value1->namelen };
+    struct unicode_str name2 = { value2->name, value2->namelen };
+
+    return compare_names( &name1, &name2 );
+}
+
+/* add an array entry to the index hash slots */
+static void index_insert_slot( const struct key *key, struct name_index *index, get_name_func get_name, int entry )
+{
+    struct unicode_str name;
+    unsigned int slot;
+
+    get_name( key, entry, &name );
+    slot = hash_strW( name.str, name.len, index->size );
+    while (index->slots[slot] != -1) slot = (slot + 1) & (index->size - 1);
+    index->slots[slot] = entry;
+}
+
+/* fill the index hash slots from the array entries */
+static void fill_index( const struct key *key, struct name_index *index, get_name_func get_name, int count )
+{
+    int i;
+
+    memset( index->slots, 0xff, index->size * sizeof(*index->slots) );
+    for (i = 0; i < count; i++) index_insert_slot( key, index, get_name, i );
+}
+
+/* find an entry in the index; return its array index or -1 */
+static int index_find( const struct key *key, const struct name_index *index, get_name_func get_name,
+                       const struct unicode_str *name )
+{
+    struct unicode_str str;
+    unsigned int slot = hash_strW( name->str, name->len, index->size );
+    int entry;
+
+    while ((entry = index->slots[slot]) != -1)
+    {
+        get_name( key, entry, &str );
+        if (!compare_names( &str, name )) return entry;
+        slot = (slot + 1) & (index->size - 1);
+    }
+    return -1;
+}
+
+/* make sure the index has room for one more entry; return 0 on error */
+static int reserve_index( const struct key *key, struct name_index *index, get_name_func get_name, int count )
+{
+    unsigned int size = index->size * 2;
+    int *slots;
+
+    if (!index->size || 2 * (count + 1) <= index->size) return 1;
+    if (!(slots = mem_alloc( size * sizeof(*slots) ))) return 0;
+    free( index->slots );
+    index->slots = slots;
+    index->size  = size;
+    fill_index( key, index, get_name, count );
+    return 1;
+}
+
+/* update the index once an entry has been added; count is the new number of entries */
+static void index_add_entry( const struct key *key, struct name_index *index, get_name_func get_name,
+                             int entry, int count )
+{
+    struct unicode_str name, prev;
+
+    if (!index->size)
+    {
+        unsigned int size = 2 * MIN_INDEXED;
+
+        /* the array is sorted as long as it isn't indexed */
+        if (count < MIN_INDEXED) return;
+        while (size < 2 * count) size *= 2;
+        if (!(index->slots = malloc( size * sizeof(*index->slots) ))) return;  /* keep using the sorted array */
+        index->size   = size;
+        index->sorted = count;
+        fill_index( key, index, get_name, count );
+        return;
+    }
+
+    /* appending in order keeps the array sorted */
+    if (index->sorted == entry)
+    {
+        get_name( key, entry, &name );
+        if (entry) get_name( key, entry - 1, &prev );
+        if (!entry || compare_names( &prev, &name ) < 0) index->sorted++;
+    }
+    index_insert_slot( key, index, get_name, entry );
+}
+
+/* remove an entry from the index hash slots */
+static void index_remove_slot( const struct key *key, struct name_index *index, get_name_func get_name, int entry )
+{
+    struct unicode_str name;
+    unsigned int slot, next, home, mask = index->size - 1;
+
+    get_name( key, entry, &name );
+    slot = hash_strW( name.str, name.len, index->size );
+    while (index->slots[slot] != entry) slot = (slot + 1) & mask;
+
+    /* move back the entries that follow in the same probe sequence */
+    for (next = (slot + 1) & mask; index->slots[next] != -1; next = (next + 1) & mask)
+    {
+        get_name( key, index->slots[next], &name );
+        home = hash_strW( name.str, name.len, index->size );
+        if (((next - home) & mask) < ((next - slot) & mask)) continue;
+        index->slots[slot] = index->slots[next];
+        slot = next;
+    }
+    index->slots[slot] = -1;
+}
+
+/* update the index before an entry is removed from the array and the following ones are moved down;
+ * count is the number of entries before the removal */
+static void index_remove_entry( const struct key *key, struct name_index *index, get_name_func get_name,
+                                int entry, int count )
+{
+    unsigned int i;
+
+    index_remove_slot( key, index, get_name, entry );
+    if (entry < index->sorted) index->sorted--;
+    if (entry == count - 1) return;
+    for (i = 0; i < index->size; i++) if (index->slots[i] > entry) index->slots[i]--;
+}
+
+/* sort the unsorted tail of an array and merge it with its sorted start */
+static void sort_entries( void *base, int count, int sorted, size_t size,
+                          int (*compare)( const void *, const void * ) )
+{
+    char *array = base, *tail;
+    int i = sorted, j = count - sorted, k = count;
+
+    if (!sorted || !(tail = memdup( array + sorted * size, (count - sorted) * size )))
+    {
+        qsort( array, count, size, compare );
+        return;
+    }
+    qsort( tail, count - sorted, size, compare );
+    while (j)
+    {
+        if (i && compare( array + (i - 1) * size, tail + (j - 1) * size ) > 0)
+            memcpy( array + --k * size, array + --i * size, size );
+        else
+            memcpy( array + --k * size, tail + --j * size, size );
+    }
+    free( tail );
+}
+
+/* make sure the subkeys of a key are sorted */
+static void sort_subkeys( struct key *key )
+{
+    struct name_index *index = &key->subkey_index;
+    int count = key->last_subkey + 1;
+
+    if (!index->size || index->sorted == count) return;
+    sort_entries( key->subkeys, count, index->sorted, sizeof(*key->subkeys), compare_subkeys );
+    index->sorted = count;
+    fill_index( key, index, get_subkey_name, count );
+}
+
+/* make sure the values of a key are sorted */
+static void sort_values( struct key *key )
+{
+    struct name_index *index = &key->value_index;
+    int count = key->last_value + 1;
+
+    if (!index->size || index->sorted == count) return;
+    sort_entries( key->values, count, index->sorted, sizeof(*key->values), compare_values );
+    index->sorted = count;
+    fill_index( key, index, get_value_name, count );
+}
+
+/* find the named child of a given key in the sorted subkeys array and return its index */
+static struct key *find_sorted_subkey( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
@@ -311,6 +606,22 @@ static struct key *find_subkey( const struct key *key, const struct unicode_str
     return NULL;
 }
 
+/* find the named child of a given key and return its index */
+static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+{
+    int i;
+
+    if (!key->subkey_index.size) return find_sorted_subkey( key, name, index );
+
+    if ((i = index_find( key, &key->subkey_index, get_subkey_name, name )) == -1)
+    {
+        *index = key->last_subkey + 1;  /* append it */
+        return NULL;
+    }
+    *index = i;
+    return key->subkeys[i];
+}
+
 /* try to grow the array of subkeys; return 1 if OK, 0 on error */
 static int grow_subkeys( struct key *key )
 {
@@ -337,11 +648,13 @@ static int grow_subkeys( struct key *key )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_subkeys( key );
+    sort_values( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -597,6 +910,8 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
         /* need to grow the array */
         if (!grow_subkeys( parent_key )) return 0;
     }
+    if (!reserve_index( parent_key, &parent_key->subkey_index, get_subkey_name, parent_key->last_subkey + 1 ))
+        return 0;
     tmp.str = name->name;
     tmp.len = name->len;
     find_subkey( parent_key, &tmp, &index );
@@ -604,6 +919,7 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
     for (i = ++parent_key->last_subkey; i > index; i--)
         parent_key->subkeys[i] = parent_key->subkeys[i - 1];
     parent_key->subkeys[index] = (struct key *)grab_object( key );
+    index_add_entry( parent_key, &parent_key->subkey_index, get_subkey_name, index, parent_key->last_subkey + 1 );
     if (is_wow6432node( name->name, name->len ) &&
         !is_wow6432node( parent_key->obj.name->name, parent_key->obj.name->len ))
         parent_key->wow6432node = key;
@@ -625,10 +941,25 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
         return;
     }
 
-    for (i = 0; i <= parent->last_subkey; i++) if (parent->subkeys[i] == key) break;
-    assert( i <= parent->last_subkey );
-    for ( ; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
-    parent->last_subkey--;
+    if (parent->subkey_index.size)
+    {
+        struct unicode_str str = { name->name, name->len };
+        struct name_index *index = &parent->subkey_index;
+
+        i = index_find( parent, index, get_subkey_name, &str );
+        assert( i != -1 && parent->subkeys[i] == key );
+        index_remove_entry( parent, index, get_subkey_name, i, parent->last_subkey + 1 );
+        memmove( parent->subkeys + i, parent->subkeys + i + 1,
+                 (parent->last_subkey - i) * sizeof(*parent->subkeys) );
+        parent->last_subkey--;
+    }
+    else
+    {
+        for (i = 0; i <= parent->last_subkey; i++) if (parent->subkeys[i] == key) break;
+        assert( i <= parent->last_subkey );
+        for ( ; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+        parent->last_subkey--;
+    }
     name->parent = NULL;
     if (parent->wow6432node == key) parent->wow6432node = NULL;
     release_object( key );
@@ -669,12 +1000,14 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free( key->value_index.slots );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->obj.name->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free( key->subkey_index.slots );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -707,7 +1040,10 @@ static struct key *create_key_object( struct object *parent, const struct unicod
             key->nb_values   = 0;
             key->last_value  = -1;
             key->values      = NULL;
+            memset( &key->subkey_index, 0, sizeof(key->subkey_index) );
+            memset( &key->value_index, 0, sizeof(key->value_index) );
             key->modif       = modif;
+            key->id          = ++next_key_id;
             list_init( &key->notify_list );
 
             if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
@@ -760,10 +1096,41 @@ static void check_notify( struct key *key, unsigned int change, int not_subtree
     }
 }
 
+/* get the slot of a key in the shared change serials */
+static inline unsigned int get_key_slot( const struct key *key )
+{
+    unsigned long ptr = (unsigned long)key;
+    return ((ptr >> 4) ^ (ptr >> 16)) % REGISTRY_SHM_SLOTS;
+}
+
+/* invalidate the data that clients may have cached for a key */
+static void invalidate_key_cache( const struct key *key )
+{
+    unsigned __int64 *serial;
+
+    if (!registry_shm) return;
+    serial = (unsigned __int64 *)&registry_shm->serials[get_key_slot( key )];
+    __atomic_store_n( serial, *serial + 1, __ATOMIC_SEQ_CST );
+}
+
+/* invalidate the data that clients may have cached for all keys */
+static void invalidate_registry_cache(void)
+{
+    unsigned int i;
+
+    if (!registry_shm) return;
+    for (i = 0; i < REGISTRY_SHM_SLOTS; i++)
+    {
+        unsigned __int64 *serial = (unsigned __int64 *)&registry_shm->serials[i];
+        __atomic_store_n( serial, *serial + 1, __ATOMIC_SEQ_CST );
+    }
+}
+
 /* update key modification time */
 static void touch_key( struct key *key, unsigned int change )
 {
     key->modif = current_time;
+    invalidate_key_cache( key );
     make_dirty( key );
 
     /* do notifications */
@@ -923,6 +1290,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -1014,7 +1382,8 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     }
 
     /* check for existing subkey with the same name */
-    if (!parent || find_subkey( parent, new_name, &index ))
+    if (parent) sort_subkeys( parent );
+    if (!parent || find_sorted_subkey( parent, new_name, &index ))
     {
         set_error( STATUS_CANNOT_DELETE );
         return;
@@ -1050,6 +1419,8 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
 
     free( key->obj.name );
     key->obj.name = new_name_ptr;
+    if (parent->subkey_index.size) fill_index( parent, &parent->subkey_index, get_subkey_name,
+                                               parent->last_subkey + 1 );
 
     if (debug_level > 1) dump_operation( key, NULL, "Rename" );
     touch_key( key, REG_NOTIFY_CHANGE_NAME );
@@ -1086,6 +1457,7 @@ static int delete_key( struct key *key, int recurse )
 
     if (debug_level > 1) dump_operation( key, NULL, "Delete" );
     key->flags |= KEY_DELETED;
+    invalidate_key_cache( key );
     unlink_named_object( &key->obj );
     touch_key( parent, REG_NOTIFY_CHANGE_NAME );
     return 1;
@@ -1122,6 +1494,17 @@ static struct key_value *find_value( const struct key *key, const struct unicode
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_index.size)
+    {
+        if ((i = index_find( key, &key->value_index, get_value_name, name )) == -1)
+        {
+            *index = key->last_value + 1;  /* append it */
+            return NULL;
+        }
+        *index = i;
+        return &key->values[i];
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1158,6 +1541,7 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     {
         if (!grow_values( key )) return NULL;
     }
+    if (!reserve_index( key, &key->value_index, get_value_name, key->last_value + 1 )) return NULL;
     if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
     for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
     value = &key->values[index];
@@ -1165,6 +1549,7 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value->namelen = name->len;
     value->len     = 0;
     value->data    = NULL;
+    index_add_entry( key, &key->value_index, get_value_name, index, key->last_value + 1 );
     return value;
 }
 
@@ -1265,6 +1650,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
+        sort_values( key );
         value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
@@ -1323,6 +1709,8 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
+    if (key->value_index.size)
+        index_remove_entry( key, &key->value_index, get_value_name, index, key->last_value + 1 );
     free( value->name );
     free( value->data );
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
@@ -1805,20 +2193,159 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* compute the FNV-1a hash of a block of data */
+static unsigned __int64 hash_cache_data( unsigned __int64 hash, const void *data, size_t len )
+{
+    const unsigned char *p = data;
+    size_t i;
+
+    for (i = 0; i < len; i++) hash = (hash ^ p[i]) * fnv_prime;
+    return hash;
+}
+
+/* get the next record from a registry cache file */
+static const void *get_cache_data( struct hive_cache_reader *reader, size_t len )
+{
+    const void *ret = reader->ptr;
+
+    len = (len + 7) & ~(size_t)7;
+    if (len > reader->end - reader->ptr) return NULL;
+    reader->ptr += len;
+    return ret;
+}
+
+/* create a key and its values and subkeys from a registry cache file */
+/* the key is created as a subkey of parent unless it's already specified */
+static int load_cached_key( struct hive_cache_reader *reader, struct key *parent, struct key *key )
+{
+    const struct hive_cache_key *rec;
+    const struct hive_cache_value *value_rec;
+    const WCHAR *name, *class;
+    const void *data;
+    struct key_value *value;
+    struct unicode_str str;
+    unsigned int i;
+    int index, ret = 1;
+
+    if (!(rec = get_cache_data( reader, sizeof(*rec) ))) return 0;
+    if (!(name = get_cache_data( reader, rec->namelen ))) return 0;
+    if (!(class = get_cache_data( reader, rec->classlen ))) return 0;
+
+    if (!key)
+    {
+        str.str = name;
+        str.len = rec->namelen;
+        if (!str.len || !(key = create_key_object( &parent->obj, &str, OBJ_OPENIF, 0, 0, NULL ))) return 0;
+    }
+    else grab_object( key );
+
+    if (rec->flags & HIVE_KEY_SAVED)
+    {
+        update_key_time( key, rec->modif );
+        if (rec->classlen)
+        {
+            free( key->class );
+            if ((key->class = memdup( class, rec->classlen ))) key->classlen = rec->classlen;
+            else key->classlen = 0;
+        }
+        if (rec->flags & HIVE_KEY_SYMLINK) key->flags |= KEY_SYMLINK;
+    }
+
+    for (i = 0; ret && i < rec->values; i++)
+    {
+        ret = 0;
+        if (!(value_rec = get_cache_data( reader, sizeof(*value_rec) ))) break;
+        if (!(name = get_cache_data( reader, value_rec->namelen ))) break;
+        if (!(data = get_cache_data( reader, value_rec->len ))) break;
+        str.str = name;
+        str.len = value_rec->namelen;
+        if (!(value = find_value( key, &str, &index )) && !(value = insert_value( key, &str, index ))) break;
+        free( value->data );
+        value->data = NULL;
+        value->len  = 0;
+        value->type = value_rec->type;
+        if (value_rec->len && !(value->data = memdup( data, value_rec->len ))) break;
+        value->len = value_rec->len;
+        ret = 1;
+    }
+
+    for (i = 0; ret && i < rec->subkeys; i++) ret = load_cached_key( reader, key, NULL );
+
+    release_object( key );
+    return ret;
+}
+
+/* load a registry branch from its cache file, if it is still valid for the text file */
+static int load_branch_cache( struct key *key, const char *filename )
+{
+    const struct hive_cache_header *header;
+    struct hive_cache_reader reader;
+    struct stat st, cache_st;
+    char cache_name[64];
+    void *base;
+    int fd, ret = 0;
+
+    if (stat( filename, &st ) == -1) return 0;
+    snprintf( cache_name, sizeof(cache_name), "%s.cache", filename );
+    if ((fd = open( cache_name, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &cache_st ) == -1 || cache_st.st_size < sizeof(*header))
+    {
+        close( fd );
+        return 0;
+    }
+    base = mmap( NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (base == MAP_FAILED) return 0;
+
+    header = base;
+    reader.ptr = (const char *)(header + 1);
+    reader.end = (const char *)base + cache_st.st_size;
+
+    if (memcmp( header->magic, hive_cache_magic, sizeof(header->magic) )) goto done;
+    if (header->version != HIVE_CACHE_VERSION) goto done;
+    if (header->data_size != reader.end - reader.ptr) goto done;
+    if (header->file_size != st.st_size || header->file_mtime != st.st_mtime ||
+        header->file_ino != st.st_ino) goto done;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    if (header->file_nsec != st.st_mtim.tv_nsec) goto done;
+#endif
+    if (header->checksum != hash_cache_data( fnv_offset_basis, reader.ptr, header->data_size )) goto done;
+    if (header->prefix_type != PREFIX_UNKNOWN)
+    {
+        if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->prefix_type;
+        else if (header->prefix_type != prefix_type) goto done;
+    }
+
+    if (!(ret = load_cached_key( &reader, NULL, key )))
+        fprintf( stderr, "wineserver: %s is corrupted, loading %s\n", cache_name, filename );
+    else if (debug_level > 1)
+        fprintf( stderr, "wineserver: loaded %s from %s\n", filename, cache_name );
+
+done:
+    munmap( base, cache_st.st_size );
+    return ret;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
     FILE *f;
+    int found = 1;
 
-    if ((f = fopen( filename, "r" )))
+    if (!load_branch_cache( key, filename ))
     {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        if ((f = fopen( filename, "r" )))
         {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
+            load_keys( key, filename, f, 0 );
+            fclose( f );
+            if (get_error() == STATUS_NOT_REGISTRY_FILE)
+            {
+                fprintf( stderr, "%s is not a valid registry file\n", filename );
+                return 1;
+            }
+            save_branch_cache( key, filename );
         }
+        else found = 0;
     }
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
@@ -1826,7 +2353,7 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
     save_branch_info[save_branch_count].filename = filename;
     save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
     make_object_permanent( &key->obj );
-    return (f != NULL);
+    return found;
 }
 
 static WCHAR *format_user_registry_path( const struct sid *sid, struct unicode_str *path )
@@ -1904,6 +2431,14 @@ void init_registry(void)
     unsigned int i;
     char *p;
 
+    /* create the shared change serials */
+
+    if ((registry_mapping = create_server_mapping( sizeof(*registry_shm), (void **)&registry_shm )))
+    {
+        make_object_permanent( (struct object *)registry_mapping );
+        release_object( registry_mapping );
+    }
+
     /* switch to the config dir */
 
     if (fchdir( config_dir_fd ) == -1) fatal_error( "chdir to config dir: %s\n", strerror( errno ));
@@ -2005,6 +2540,104 @@ void init_registry(void)
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
 }
 
+/* write a record to a registry cache file */
+static void write_cache_data( struct hive_cache_writer *writer, const void *data, size_t len )
+{
+    static const char padding[8];
+    size_t pad = -len & 7;
+
+    fwrite( data, len, 1, writer->file );
+    fwrite( padding, pad, 1, writer->file );
+    writer->checksum = hash_cache_data( writer->checksum, data, len );
+    writer->checksum = hash_cache_data( writer->checksum, padding, pad );
+    writer->size += len + pad;
+}
+
+/* write a key and its values and subkeys to a registry cache file */
+static void save_cached_key( struct hive_cache_writer *writer, struct key *key, const struct key *base )
+{
+    struct hive_cache_key rec;
+    struct hive_cache_value value_rec;
+    int i;
+
+    sort_subkeys( key );
+    sort_values( key );
+
+    memset( &rec, 0, sizeof(rec) );
+    rec.modif    = key->modif;
+    rec.namelen  = (key != base) ? key->obj.name->len : 0;
+    rec.classlen = key->classlen;
+    rec.values   = key->last_value + 1;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) rec.subkeys++;
+    /* same rule as save_subkeys() */
+    if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
+        rec.flags |= HIVE_KEY_SAVED;
+    if (key->flags & KEY_SYMLINK) rec.flags |= HIVE_KEY_SYMLINK;
+
+    write_cache_data( writer, &rec, sizeof(rec) );
+    if (rec.namelen) write_cache_data( writer, key->obj.name->name, rec.namelen );
+    write_cache_data( writer, key->class, rec.classlen );
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        memset( &value_rec, 0, sizeof(value_rec) );
+        value_rec.namelen = key->values[i].namelen;
+        value_rec.type    = key->values[i].type;
+        value_rec.len     = key->values[i].len;
+        write_cache_data( writer, &value_rec, sizeof(value_rec) );
+        write_cache_data( writer, key->values[i].name, value_rec.namelen );
+        write_cache_data( writer, key->values[i].data, value_rec.len );
+    }
+
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) save_cached_key( writer, key->subkeys[i], base );
+}
+
+/* write the cache file of a registry branch after its text file has been saved */
+static void save_branch_cache( struct key *key, const char *filename )
+{
+    struct hive_cache_header header;
+    struct hive_cache_writer writer;
+    struct stat st;
+    char cache_name[64], tmp[32];
+    int fd, ret;
+
+    if (stat( filename, &st ) == -1) return;
+    snprintf( cache_name, sizeof(cache_name), "%s.cache", filename );
+    snprintf( tmp, sizeof(tmp), "reg%lx.cache.tmp", (long) getpid() );
+    if ((fd = open( tmp, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) == -1) return;
+    if (!(writer.file = fdopen( fd, "w" )))
+    {
+        close( fd );
+        unlink( tmp );
+        return;
+    }
+    writer.size = 0;
+    writer.checksum = fnv_offset_basis;
+
+    memset( &header, 0, sizeof(header) );
+    fwrite( &header, sizeof(header), 1, writer.file );
+    save_cached_key( &writer, key, key );
+
+    memcpy( header.magic, hive_cache_magic, sizeof(header.magic) );
+    header.version     = HIVE_CACHE_VERSION;
+    header.prefix_type = prefix_type;
+    header.file_size   = st.st_size;
+    header.file_mtime  = st.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    header.file_nsec   = st.st_mtim.tv_nsec;
+#endif
+    header.file_ino    = st.st_ino;
+    header.data_size   = writer.size;
+    header.checksum    = writer.checksum;
+    if (!fseek( writer.file, 0, SEEK_SET )) fwrite( &header, sizeof(header), 1, writer.file );
+
+    ret = !ferror( writer.file );
+    ret = !fclose( writer.file ) && ret;
+    if (!ret || rename( tmp, cache_name )) unlink( tmp );
+}
+
 /* save a registry branch to a file */
 static void save_all_subkeys( struct key *key, FILE *f )
 {
@@ -2117,20 +2750,120 @@ static int save_branch( struct key *key, const char *filename )
     }
 
 done:
-    if (ret) make_clean( key );
+    if (ret)
+    {
+        make_clean( key );
+        save_branch_cache( key, filename );
+    }
     return ret;
 }
 
+/* collect the result of a background save, marking the branches that failed as dirty again */
+/* return 0 if the save is still in progress and we don't want to wait for it */
+static int finish_background_save( int wait )
+{
+    char status[MAX_SAVE_BRANCH_INFO];
+    struct pollfd pfd;
+    int i, ret;
+
+    if (save_pipe == -1) return 1;
+
+    pfd.fd = save_pipe;
+    pfd.events = POLLIN;
+    if (!wait && poll( &pfd, 1, 0 ) <= 0) return 0;
+
+    while ((ret = read( save_pipe, status, save_branch_count )) == -1 && errno == EINTR);
+    close( save_pipe );
+    save_pipe = -1;
+
+    for (i = 0; i < save_branch_count; i++)
+    {
+        if (i < ret && status[i]) continue;
+        fprintf( stderr, "wineserver: could not save registry branch to %s\n",
+                 save_branch_info[i].filename );
+        make_dirty( save_branch_info[i].key );
+    }
+    return 1;
+}
+
+/* close the client sockets, pipes and other server fds in the save child, keeping stdio and one fd */
+static void close_save_child_fds( int keep )
+{
+    struct rlimit rlimit;
+    struct dirent *de;
+    DIR *dir;
+    int fd, max_fd = 1024;
+
+    if ((dir = opendir( "/proc/self/fd" )))
+    {
+        while ((de = readdir( dir )))
+        {
+            if (de->d_name[0] < '0' || de->d_name[0] > '9') continue;
+            fd = atoi( de->d_name );
+            if (fd > 2 && fd != keep && fd != dirfd( dir )) close( fd );
+        }
+        closedir( dir );
+        return;
+    }
+    if (!getrlimit( RLIMIT_NOFILE, &rlimit ) && rlimit.rlim_cur != RLIM_INFINITY) max_fd = rlimit.rlim_cur;
+    for (fd = 3; fd < max_fd; fd++) if (fd != keep) close( fd );
+}
+
+/* save the dirty registry branches from a child process, so that the server doesn't block */
+static int background_save(void)
+{
+    char status[MAX_SAVE_BRANCH_INFO];
+    int i, ret, fds[2];
+
+    for (i = 0; i < save_branch_count; i++)
+        if (save_branch_info[i].key->flags & KEY_DIRTY) break;
+    if (i == save_branch_count) return 1;  /* nothing to save */
+
+    if (pipe( fds ) == -1) return 0;
+    switch (fork())
+    {
+    case -1:
+        close( fds[0] );
+        close( fds[1] );
+        return 0;
+
+    case 0:  /* child */
+        close( fds[0] );
+        signal( SIGHUP, SIG_DFL );
+        signal( SIGINT, SIG_DFL );
+        signal( SIGQUIT, SIG_DFL );
+        signal( SIGTERM, SIG_DFL );
+        if (fchdir( config_dir_fd ) == -1) _exit(1);
+        close_save_child_fds( fds[1] );
+        for (i = 0; i < save_branch_count; i++)
+            status[i] = save_branch( save_branch_info[i].key, save_branch_info[i].filename );
+        /* the server treats missing status bytes as failed saves */
+        while ((ret = write( fds[1], status, save_branch_count )) == -1 && errno == EINTR);
+        _exit( ret != save_branch_count );
+
+    default:  /* parent */
+        close( fds[1] );
+        save_pipe = fds[0];
+        if (debug_level > 1) fprintf( stderr, "wineserver: saving registry in the background\n" );
+        /* the child has its own copy of the tree, later changes will go into the next save */
+        for (i = 0; i < save_branch_count; i++) make_clean( save_branch_info[i].key );
+        return 1;
+    }
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
     int i;
 
-    if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].filename );
-    if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+    /* if the previous save is still running, try again in the next period */
+    if (finish_background_save( 0 ) && !background_save() && fchdir( config_dir_fd ) != -1)
+    {
+        for (i = 0; i < save_branch_count; i++)
+            save_branch( save_branch_info[i].key, save_branch_info[i].filename );
+        if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+    }
     set_periodic_save_timer();
 }
 
@@ -2146,6 +2879,7 @@ void flush_registry(void)
 {
     int i;
 
+    finish_background_save( 1 );
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
@@ -2197,6 +2931,9 @@ DECL_HANDLER(create_key)
         else
             reply->hkey = alloc_handle_no_access_check( current->process, key,
                                                         access, objattr->attributes );
+        reply->slot   = get_key_slot( key );
+        reply->key_id = key->id;
+        if (reply->hkey) reply->access = get_handle_access( current->process, reply->hkey );
         release_object( key );
     }
     if (parent) release_object( parent );
@@ -2215,7 +2952,10 @@ DECL_HANDLER(open_key)
 
     if ((key = open_key( parent, &name, access, req->attributes )))
     {
-        reply->hkey = alloc_handle( current->process, key, access, req->attributes );
+        reply->hkey   = alloc_handle( current->process, key, access, req->attributes );
+        reply->slot   = get_key_slot( key );
+        reply->key_id = key->id;
+        if (reply->hkey) reply->access = get_handle_access( current->process, reply->hkey );
         release_object( key );
     }
     if (parent) release_object( parent );
@@ -2290,10 +3030,25 @@ DECL_HANDLER(get_key_value)
     if ((key = get_hkey_obj( req->hkey, KEY_QUERY_VALUE )))
     {
         get_value( key, &name, &reply->type, &reply->total );
+        reply->slot   = get_key_slot( key );
+        reply->key_id = key->id;
+        if (registry_shm) reply->serial = registry_shm->serials[reply->slot];
         release_object( key );
     }
 }
 
+/* get the shared mapping holding the registry change serials */
+DECL_HANDLER(get_registry_mapping)
+{
+    if (!registry_mapping)
+    {
+        set_error( STATUS_NOT_SUPPORTED );
+        return;
+    }
+    reply->handle = alloc_handle( current->process, registry_mapping, SECTION_QUERY | SECTION_MAP_READ, 0 );
+    reply->size   = sizeof(*registry_shm);
+}
+
 /* enumerate the value of a registry key */
 DECL_HANDLER(enum_key_value)
 {
@@ -2342,6 +3097,7 @@ DECL_HANDLER(load_registry)
     if ((key = create_key( parent, &name, 0, KEY_WOW64_64KEY, 0, sd )))
     {
         load_registry( key, req->file );
+        invalidate_registry_cache();  /* the loaded values may have replaced existing ones */
         release_object( key );
     }
     if (parent) release_object( parent );
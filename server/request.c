@@ -323,6 +323,16 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* buffer used to read a request header and its variable-sized data with a single system call */
+static unsigned __int64 request_buffer[0x10000 / sizeof(unsigned __int64)];
+
+/* free the variable-sized data of the current request of a thread */
+void free_request_data( struct thread *thread )
+{
+    if (thread->req_data != request_buffer) free( thread->req_data );
+    thread->req_data = NULL;
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
@@ -330,23 +340,42 @@ void read_request( struct thread *thread )
 
     if (!thread->req_toread)  /* no pending request */
     {
-        if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
-                         sizeof(thread->req) )) != sizeof(thread->req)) goto error;
-        if (!(thread->req_toread = thread->req.request_header.request_size))
+        struct iovec vec[2];
+        data_size_t size;
+
+        vec[0].iov_base = &thread->req;
+        vec[0].iov_len  = sizeof(thread->req);
+        vec[1].iov_base = request_buffer;
+        vec[1].iov_len  = sizeof(request_buffer);
+
+        if ((ret = readv( get_unix_fd( thread->request_fd ), vec, 2 )) < (int)sizeof(thread->req)) goto error;
+        size = thread->req.request_header.request_size;
+        ret -= sizeof(thread->req);
+        if (ret > size)
+        {
+            fatal_protocol_error( thread, "extra data %d for request %d\n", ret - (int)size,
+                                  thread->req.request_header.req );
+            return;
+        }
+        if (ret == size)
         {
-            /* no data, handle request at once */
+            /* the whole request is there, handle it at once */
+            if (size) thread->req_data = request_buffer;
             call_req_handler( thread );
+            free_request_data( thread );
             return;
         }
-        if (!(thread->req_data = malloc( thread->req_toread )))
+        if (!(thread->req_data = malloc( size )))
         {
             fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
-                                  thread->req_toread, thread->req.request_header.req );
+                                  size, thread->req.request_header.req );
             return;
         }
+        memcpy( thread->req_data, request_buffer, ret );
+        thread->req_toread = size - ret;
     }
 
-    /* read the variable sized data */
+    /* read the rest of the variable sized data */
     for (;;)
     {
         ret = read( get_unix_fd( thread->request_fd ),
@@ -357,8 +386,7 @@ void read_request( struct thread *thread )
         if (!(thread->req_toread -= ret))
         {
             call_req_handler( thread );
-            free( thread->req_data );
-            thread->req_data = NULL;
+            free_request_data( thread );
             return;
         }
     }
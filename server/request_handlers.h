@@ -40,6 +40,7 @@ DECL_HANDLER(select);
 DECL_HANDLER(create_event);
 DECL_HANDLER(event_op);
 DECL_HANDLER(query_event);
+DECL_HANDLER(get_inproc_sync_mapping);
 DECL_HANDLER(open_event);
 DECL_HANDLER(create_keyed_event);
 DECL_HANDLER(open_keyed_event);
@@ -74,6 +75,8 @@ DECL_HANDLER(create_mapping);
 DECL_HANDLER(open_mapping);
 DECL_HANDLER(get_mapping_info);
 DECL_HANDLER(get_image_map_address);
+DECL_HANDLER(get_image_reloc_file);
+DECL_HANDLER(set_image_reloc_file);
 DECL_HANDLER(map_view);
 DECL_HANDLER(map_image_view);
 DECL_HANDLER(map_builtin_view);
@@ -100,6 +103,7 @@ DECL_HANDLER(flush_key);
 DECL_HANDLER(enum_key);
 DECL_HANDLER(set_key_value);
 DECL_HANDLER(get_key_value);
+DECL_HANDLER(get_registry_mapping);
 DECL_HANDLER(enum_key_value);
 DECL_HANDLER(delete_key_value);
 DECL_HANDLER(load_registry);
@@ -336,6 +340,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_create_event,
     (req_handler)req_event_op,
     (req_handler)req_query_event,
+    (req_handler)req_get_inproc_sync_mapping,
     (req_handler)req_open_event,
     (req_handler)req_create_keyed_event,
     (req_handler)req_open_keyed_event,
@@ -370,6 +375,8 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_mapping,
     (req_handler)req_get_mapping_info,
     (req_handler)req_get_image_map_address,
+    (req_handler)req_get_image_reloc_file,
+    (req_handler)req_set_image_reloc_file,
     (req_handler)req_map_view,
     (req_handler)req_map_image_view,
     (req_handler)req_map_builtin_view,
@@ -396,6 +403,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_enum_key,
     (req_handler)req_set_key_value,
     (req_handler)req_get_key_value,
+    (req_handler)req_get_registry_mapping,
     (req_handler)req_enum_key_value,
     (req_handler)req_delete_key_value,
     (req_handler)req_load_registry,
@@ -818,7 +826,10 @@ C_ASSERT( offsetof(struct dup_handle_request, attributes) == 28 );
 C_ASSERT( offsetof(struct dup_handle_request, options) == 32 );
 C_ASSERT( sizeof(struct dup_handle_request) == 40 );
 C_ASSERT( offsetof(struct dup_handle_reply, handle) == 8 );
-C_ASSERT( sizeof(struct dup_handle_reply) == 16 );
+C_ASSERT( offsetof(struct dup_handle_reply, fd_type) == 12 );
+C_ASSERT( offsetof(struct dup_handle_reply, fd_access) == 16 );
+C_ASSERT( offsetof(struct dup_handle_reply, fd_options) == 20 );
+C_ASSERT( sizeof(struct dup_handle_reply) == 24 );
 C_ASSERT( offsetof(struct allocate_reserve_object_request, type) == 12 );
 C_ASSERT( sizeof(struct allocate_reserve_object_request) == 16 );
 C_ASSERT( offsetof(struct allocate_reserve_object_reply, handle) == 8 );
@@ -855,6 +866,7 @@ C_ASSERT( offsetof(struct create_event_request, manual_reset) == 16 );
 C_ASSERT( offsetof(struct create_event_request, initial_state) == 20 );
 C_ASSERT( sizeof(struct create_event_request) == 24 );
 C_ASSERT( offsetof(struct create_event_reply, handle) == 8 );
+C_ASSERT( offsetof(struct create_event_reply, sync_offset) == 12 );
 C_ASSERT( sizeof(struct create_event_reply) == 16 );
 C_ASSERT( offsetof(struct event_op_request, handle) == 12 );
 C_ASSERT( offsetof(struct event_op_request, op) == 16 );
@@ -866,6 +878,10 @@ C_ASSERT( sizeof(struct query_event_request) == 16 );
 C_ASSERT( offsetof(struct query_event_reply, manual_reset) == 8 );
 C_ASSERT( offsetof(struct query_event_reply, state) == 12 );
 C_ASSERT( sizeof(struct query_event_reply) == 16 );
+C_ASSERT( sizeof(struct get_inproc_sync_mapping_request) == 16 );
+C_ASSERT( offsetof(struct get_inproc_sync_mapping_reply, handle) == 8 );
+C_ASSERT( offsetof(struct get_inproc_sync_mapping_reply, size) == 12 );
+C_ASSERT( sizeof(struct get_inproc_sync_mapping_reply) == 16 );
 C_ASSERT( offsetof(struct open_event_request, access) == 12 );
 C_ASSERT( offsetof(struct open_event_request, attributes) == 16 );
 C_ASSERT( offsetof(struct open_event_request, rootdir) == 20 );
@@ -886,6 +902,7 @@ C_ASSERT( offsetof(struct create_mutex_request, access) == 12 );
 C_ASSERT( offsetof(struct create_mutex_request, owned) == 16 );
 C_ASSERT( sizeof(struct create_mutex_request) == 24 );
 C_ASSERT( offsetof(struct create_mutex_reply, handle) == 8 );
+C_ASSERT( offsetof(struct create_mutex_reply, sync_offset) == 12 );
 C_ASSERT( sizeof(struct create_mutex_reply) == 16 );
 C_ASSERT( offsetof(struct release_mutex_request, handle) == 12 );
 C_ASSERT( sizeof(struct release_mutex_request) == 16 );
@@ -908,6 +925,7 @@ C_ASSERT( offsetof(struct create_semaphore_request, initial) == 16 );
 C_ASSERT( offsetof(struct create_semaphore_request, max) == 20 );
 C_ASSERT( sizeof(struct create_semaphore_request) == 24 );
 C_ASSERT( offsetof(struct create_semaphore_reply, handle) == 8 );
+C_ASSERT( offsetof(struct create_semaphore_reply, sync_offset) == 12 );
 C_ASSERT( sizeof(struct create_semaphore_reply) == 16 );
 C_ASSERT( offsetof(struct release_semaphore_request, handle) == 12 );
 C_ASSERT( offsetof(struct release_semaphore_request, count) == 16 );
@@ -932,7 +950,10 @@ C_ASSERT( offsetof(struct create_file_request, options) == 24 );
 C_ASSERT( offsetof(struct create_file_request, attrs) == 28 );
 C_ASSERT( sizeof(struct create_file_request) == 32 );
 C_ASSERT( offsetof(struct create_file_reply, handle) == 8 );
-C_ASSERT( sizeof(struct create_file_reply) == 16 );
+C_ASSERT( offsetof(struct create_file_reply, fd_type) == 12 );
+C_ASSERT( offsetof(struct create_file_reply, fd_access) == 16 );
+C_ASSERT( offsetof(struct create_file_reply, fd_options) == 20 );
+C_ASSERT( sizeof(struct create_file_reply) == 24 );
 C_ASSERT( offsetof(struct open_file_object_request, access) == 12 );
 C_ASSERT( offsetof(struct open_file_object_request, attributes) == 16 );
 C_ASSERT( offsetof(struct open_file_object_request, rootdir) == 20 );
@@ -996,6 +1017,7 @@ C_ASSERT( sizeof(struct recv_socket_request) == 64 );
 C_ASSERT( offsetof(struct recv_socket_reply, wait) == 8 );
 C_ASSERT( offsetof(struct recv_socket_reply, options) == 12 );
 C_ASSERT( offsetof(struct recv_socket_reply, nonblocking) == 16 );
+C_ASSERT( offsetof(struct recv_socket_reply, sync_offset) == 20 );
 C_ASSERT( sizeof(struct recv_socket_reply) == 24 );
 C_ASSERT( offsetof(struct send_socket_request, flags) == 12 );
 C_ASSERT( offsetof(struct send_socket_request, async) == 16 );
@@ -1003,6 +1025,7 @@ C_ASSERT( sizeof(struct send_socket_request) == 56 );
 C_ASSERT( offsetof(struct send_socket_reply, wait) == 8 );
 C_ASSERT( offsetof(struct send_socket_reply, options) == 12 );
 C_ASSERT( offsetof(struct send_socket_reply, nonblocking) == 16 );
+C_ASSERT( offsetof(struct send_socket_reply, sync_offset) == 20 );
 C_ASSERT( sizeof(struct send_socket_reply) == 24 );
 C_ASSERT( offsetof(struct socket_get_events_request, handle) == 12 );
 C_ASSERT( offsetof(struct socket_get_events_request, event) == 16 );
@@ -1062,6 +1085,14 @@ C_ASSERT( offsetof(struct get_image_map_address_request, handle) == 12 );
 C_ASSERT( sizeof(struct get_image_map_address_request) == 16 );
 C_ASSERT( offsetof(struct get_image_map_address_reply, addr) == 8 );
 C_ASSERT( sizeof(struct get_image_map_address_reply) == 16 );
+C_ASSERT( offsetof(struct get_image_reloc_file_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_image_reloc_file_request) == 16 );
+C_ASSERT( offsetof(struct get_image_reloc_file_reply, file) == 8 );
+C_ASSERT( offsetof(struct get_image_reloc_file_reply, fill) == 12 );
+C_ASSERT( sizeof(struct get_image_reloc_file_reply) == 16 );
+C_ASSERT( offsetof(struct set_image_reloc_file_request, handle) == 12 );
+C_ASSERT( offsetof(struct set_image_reloc_file_request, status) == 16 );
+C_ASSERT( sizeof(struct set_image_reloc_file_request) == 24 );
 C_ASSERT( offsetof(struct map_view_request, mapping) == 12 );
 C_ASSERT( offsetof(struct map_view_request, access) == 16 );
 C_ASSERT( offsetof(struct map_view_request, base) == 24 );
@@ -1151,13 +1182,19 @@ C_ASSERT( offsetof(struct create_key_request, access) == 12 );
 C_ASSERT( offsetof(struct create_key_request, options) == 16 );
 C_ASSERT( sizeof(struct create_key_request) == 24 );
 C_ASSERT( offsetof(struct create_key_reply, hkey) == 8 );
-C_ASSERT( sizeof(struct create_key_reply) == 16 );
+C_ASSERT( offsetof(struct create_key_reply, slot) == 12 );
+C_ASSERT( offsetof(struct create_key_reply, key_id) == 16 );
+C_ASSERT( offsetof(struct create_key_reply, access) == 24 );
+C_ASSERT( sizeof(struct create_key_reply) == 32 );
 C_ASSERT( offsetof(struct open_key_request, parent) == 12 );
 C_ASSERT( offsetof(struct open_key_request, access) == 16 );
 C_ASSERT( offsetof(struct open_key_request, attributes) == 20 );
 C_ASSERT( sizeof(struct open_key_request) == 24 );
 C_ASSERT( offsetof(struct open_key_reply, hkey) == 8 );
-C_ASSERT( sizeof(struct open_key_reply) == 16 );
+C_ASSERT( offsetof(struct open_key_reply, slot) == 12 );
+C_ASSERT( offsetof(struct open_key_reply, key_id) == 16 );
+C_ASSERT( offsetof(struct open_key_reply, access) == 24 );
+C_ASSERT( sizeof(struct open_key_reply) == 32 );
 C_ASSERT( offsetof(struct delete_key_request, hkey) == 12 );
 C_ASSERT( sizeof(struct delete_key_request) == 16 );
 C_ASSERT( offsetof(struct flush_key_request, hkey) == 12 );
@@ -1184,7 +1221,14 @@ C_ASSERT( offsetof(struct get_key_value_request, hkey) == 12 );
 C_ASSERT( sizeof(struct get_key_value_request) == 16 );
 C_ASSERT( offsetof(struct get_key_value_reply, type) == 8 );
 C_ASSERT( offsetof(struct get_key_value_reply, total) == 12 );
-C_ASSERT( sizeof(struct get_key_value_reply) == 16 );
+C_ASSERT( offsetof(struct get_key_value_reply, slot) == 16 );
+C_ASSERT( offsetof(struct get_key_value_reply, serial) == 24 );
+C_ASSERT( offsetof(struct get_key_value_reply, key_id) == 32 );
+C_ASSERT( sizeof(struct get_key_value_reply) == 40 );
+C_ASSERT( sizeof(struct get_registry_mapping_request) == 16 );
+C_ASSERT( offsetof(struct get_registry_mapping_reply, handle) == 8 );
+C_ASSERT( offsetof(struct get_registry_mapping_reply, size) == 12 );
+C_ASSERT( sizeof(struct get_registry_mapping_reply) == 16 );
 C_ASSERT( offsetof(struct enum_key_value_request, hkey) == 12 );
 C_ASSERT( offsetof(struct enum_key_value_request, index) == 16 );
 C_ASSERT( offsetof(struct enum_key_value_request, info_class) == 20 );
@@ -2164,6 +2208,8 @@ C_ASSERT( offsetof(struct add_fd_completion_request, information) == 24 );
 C_ASSERT( offsetof(struct add_fd_completion_request, status) == 32 );
 C_ASSERT( offsetof(struct add_fd_completion_request, async) == 36 );
 C_ASSERT( sizeof(struct add_fd_completion_request) == 40 );
+C_ASSERT( offsetof(struct add_fd_completion_reply, sync_offset) == 8 );
+C_ASSERT( sizeof(struct add_fd_completion_reply) == 16 );
 C_ASSERT( offsetof(struct set_fd_completion_mode_request, handle) == 12 );
 C_ASSERT( offsetof(struct set_fd_completion_mode_request, flags) == 16 );
 C_ASSERT( sizeof(struct set_fd_completion_mode_request) == 24 );
@@ -21,6 +21,7 @@ static void dump_varargs_acl( const char *prefix, data_size_t size );
 static void dump_varargs_apc_call( const char *prefix, data_size_t size );
 static void dump_varargs_apc_result( const char *prefix, data_size_t size );
 static void dump_varargs_bytes( const char *prefix, data_size_t size );
+static void dump_varargs_completion_msgs( const char *prefix, data_size_t size );
 static void dump_varargs_contexts( const char *prefix, data_size_t size );
 static void dump_varargs_cursor_positions( const char *prefix, data_size_t size );
 static void dump_varargs_debug_event( const char *prefix, data_size_t size );
@@ -375,6 +376,9 @@ static void dump_dup_handle_request( const struct dup_handle_request *req )
 static void dump_dup_handle_reply( const struct dup_handle_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", fd_type=%d", req->fd_type );
+    fprintf( stderr, ", fd_access=%08x", req->fd_access );
+    fprintf( stderr, ", fd_options=%08x", req->fd_options );
 }
 
 static void dump_allocate_reserve_object_request( const struct allocate_reserve_object_request *req )
@@ -455,6 +459,7 @@ static void dump_create_event_request( const struct create_event_request *req )
 static void dump_create_event_reply( const struct create_event_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", sync_offset=%u", req->sync_offset );
 }
 
 static void dump_event_op_request( const struct event_op_request *req )
@@ -479,6 +484,16 @@ static void dump_query_event_reply( const struct query_event_reply *req )
     fprintf( stderr, ", state=%d", req->state );
 }
 
+static void dump_get_inproc_sync_mapping_request( const struct get_inproc_sync_mapping_request *req )
+{
+}
+
+static void dump_get_inproc_sync_mapping_reply( const struct get_inproc_sync_mapping_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", size=%u", req->size );
+}
+
 static void dump_open_event_request( const struct open_event_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -526,6 +541,7 @@ static void dump_create_mutex_request( const struct create_mutex_request *req )
 static void dump_create_mutex_reply( const struct create_mutex_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", sync_offset=%u", req->sync_offset );
 }
 
 static void dump_release_mutex_request( const struct release_mutex_request *req )
@@ -574,6 +590,7 @@ static void dump_create_semaphore_request( const struct create_semaphore_request
 static void dump_create_semaphore_reply( const struct create_semaphore_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", sync_offset=%u", req->sync_offset );
 }
 
 static void dump_release_semaphore_request( const struct release_semaphore_request *req )
@@ -625,6 +642,9 @@ static void dump_create_file_request( const struct create_file_request *req )
 static void dump_create_file_reply( const struct create_file_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", fd_type=%d", req->fd_type );
+    fprintf( stderr, ", fd_access=%08x", req->fd_access );
+    fprintf( stderr, ", fd_options=%08x", req->fd_options );
 }
 
 static void dump_open_file_object_request( const struct open_file_object_request *req )
@@ -757,6 +777,7 @@ static void dump_recv_socket_reply( const struct recv_socket_reply *req )
     fprintf( stderr, " wait=%04x", req->wait );
     fprintf( stderr, ", options=%08x", req->options );
     fprintf( stderr, ", nonblocking=%d", req->nonblocking );
+    fprintf( stderr, ", sync_offset=%u", req->sync_offset );
 }
 
 static void dump_send_socket_request( const struct send_socket_request *req )
@@ -770,6 +791,7 @@ static void dump_send_socket_reply( const struct send_socket_reply *req )
     fprintf( stderr, " wait=%04x", req->wait );
     fprintf( stderr, ", options=%08x", req->options );
     fprintf( stderr, ", nonblocking=%d", req->nonblocking );
+    fprintf( stderr, ", sync_offset=%u", req->sync_offset );
 }
 
 static void dump_socket_get_events_request( const struct socket_get_events_request *req )
@@ -891,6 +913,23 @@ static void dump_get_image_map_address_reply( const struct get_image_map_address
     dump_uint64( " addr=", &req->addr );
 }
 
+static void dump_get_image_reloc_file_request( const struct get_image_reloc_file_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_image_reloc_file_reply( const struct get_image_reloc_file_reply *req )
+{
+    fprintf( stderr, " file=%04x", req->file );
+    fprintf( stderr, ", fill=%d", req->fill );
+}
+
+static void dump_set_image_reloc_file_request( const struct set_image_reloc_file_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", status=%08x", req->status );
+}
+
 static void dump_map_view_request( const struct map_view_request *req )
 {
     fprintf( stderr, " mapping=%04x", req->mapping );
@@ -1077,6 +1116,9 @@ static void dump_create_key_request( const struct create_key_request *req )
 static void dump_create_key_reply( const struct create_key_reply *req )
 {
     fprintf( stderr, " hkey=%04x", req->hkey );
+    fprintf( stderr, ", slot=%08x", req->slot );
+    dump_uint64( ", key_id=", &req->key_id );
+    fprintf( stderr, ", access=%08x", req->access );
 }
 
 static void dump_open_key_request( const struct open_key_request *req )
@@ -1090,6 +1132,9 @@ static void dump_open_key_request( const struct open_key_request *req )
 static void dump_open_key_reply( const struct open_key_reply *req )
 {
     fprintf( stderr, " hkey=%04x", req->hkey );
+    fprintf( stderr, ", slot=%08x", req->slot );
+    dump_uint64( ", key_id=", &req->key_id );
+    fprintf( stderr, ", access=%08x", req->access );
 }
 
 static void dump_delete_key_request( const struct delete_key_request *req )
@@ -1143,9 +1188,22 @@ static void dump_get_key_value_reply( const struct get_key_value_reply *req )
 {
     fprintf( stderr, " type=%d", req->type );
     fprintf( stderr, ", total=%u", req->total );
+    fprintf( stderr, ", slot=%08x", req->slot );
+    dump_uint64( ", serial=", &req->serial );
+    dump_uint64( ", key_id=", &req->key_id );
     dump_varargs_bytes( ", data=", cur_size );
 }
 
+static void dump_get_registry_mapping_request( const struct get_registry_mapping_request *req )
+{
+}
+
+static void dump_get_registry_mapping_reply( const struct get_registry_mapping_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", size=%u", req->size );
+}
+
 static void dump_enum_key_value_request( const struct enum_key_value_request *req )
 {
     fprintf( stderr, " hkey=%04x", req->hkey );
@@ -3088,6 +3146,7 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     dump_uint64( ", information=", &req->information );
     fprintf( stderr, ", status=%08x", req->status );
     fprintf( stderr, ", wait_handle=%04x", req->wait_handle );
+    dump_varargs_completion_msgs( ", msgs=", cur_size );
 }
 
 static void dump_get_thread_completion_request( const struct get_thread_completion_request *req )
@@ -3128,6 +3187,11 @@ static void dump_add_fd_completion_request( const struct add_fd_completion_reque
     fprintf( stderr, ", async=%d", req->async );
 }
 
+static void dump_add_fd_completion_reply( const struct add_fd_completion_reply *req )
+{
+    fprintf( stderr, " sync_offset=%u", req->sync_offset );
+}
+
 static void dump_set_fd_completion_mode_request( const struct set_fd_completion_mode_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -3381,6 +3445,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] =
     (dump_func)dump_create_event_request,
     (dump_func)dump_event_op_request,
     (dump_func)dump_query_event_request,
+    (dump_func)dump_get_inproc_sync_mapping_request,
     (dump_func)dump_open_event_request,
     (dump_func)dump_create_keyed_event_request,
     (dump_func)dump_open_keyed_event_request,
@@ -3415,6 +3480,8 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] =
     (dump_func)dump_open_mapping_request,
     (dump_func)dump_get_mapping_info_request,
     (dump_func)dump_get_image_map_address_request,
+    (dump_func)dump_get_image_reloc_file_request,
+    (dump_func)dump_set_image_reloc_file_request,
     (dump_func)dump_map_view_request,
     (dump_func)dump_map_image_view_request,
     (dump_func)dump_map_builtin_view_request,
@@ -3441,6 +3508,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] =
     (dump_func)dump_enum_key_request,
     (dump_func)dump_set_key_value_request,
     (dump_func)dump_get_key_value_request,
+    (dump_func)dump_get_registry_mapping_request,
     (dump_func)dump_enum_key_value_request,
     (dump_func)dump_delete_key_value_request,
     (dump_func)dump_load_registry_request,
@@ -3677,6 +3745,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] =
     (dump_func)dump_create_event_reply,
     (dump_func)dump_event_op_reply,
     (dump_func)dump_query_event_reply,
+    (dump_func)dump_get_inproc_sync_mapping_reply,
     (dump_func)dump_open_event_reply,
     (dump_func)dump_create_keyed_event_reply,
     (dump_func)dump_open_keyed_event_reply,
@@ -3711,6 +3780,8 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] =
     (dump_func)dump_open_mapping_reply,
     (dump_func)dump_get_mapping_info_reply,
     (dump_func)dump_get_image_map_address_reply,
+    (dump_func)dump_get_image_reloc_file_reply,
+    NULL,
     NULL,
     NULL,
     NULL,
@@ -3737,6 +3808,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] =
     (dump_func)dump_enum_key_reply,
     NULL,
     (dump_func)dump_get_key_value_reply,
+    (dump_func)dump_get_registry_mapping_reply,
     (dump_func)dump_enum_key_value_reply,
     NULL,
     NULL,
@@ -3911,7 +3983,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] =
     (dump_func)dump_get_thread_completion_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
-    NULL,
+    (dump_func)dump_add_fd_completion_reply,
     NULL,
     NULL,
     NULL,
@@ -3973,6 +4045,7 @@ static const char * const req_names[REQ_NB_REQUESTS] =
     "create_event",
     "event_op",
     "query_event",
+    "get_inproc_sync_mapping",
     "open_event",
     "create_keyed_event",
     "open_keyed_event",
@@ -4007,6 +4080,8 @@ static const char * const req_names[REQ_NB_REQUESTS] =
     "open_mapping",
     "get_mapping_info",
     "get_image_map_address",
+    "get_image_reloc_file",
+    "set_image_reloc_file",
     "map_view",
     "map_image_view",
     "map_builtin_view",
@@ -4033,6 +4108,7 @@ static const char * const req_names[REQ_NB_REQUESTS] =
     "enum_key",
     "set_key_value",
     "get_key_value",
+    "get_registry_mapping",
     "enum_key_value",
     "delete_key_value",
     "load_registry",
@@ -4356,6 +4432,7 @@ static const struct
     { "PROCESS_IS_TERMINATING",      STATUS_PROCESS_IS_TERMINATING },
     { "PROCESS_NOT_IN_JOB",          STATUS_PROCESS_NOT_IN_JOB },
     { "REPARSE_POINT_NOT_RESOLVED",  STATUS_REPARSE_POINT_NOT_RESOLVED },
+    { "RETRY",                       STATUS_RETRY },
     { "SECTION_TOO_BIG",             STATUS_SECTION_TOO_BIG },
     { "SEMAPHORE_LIMIT_EXCEEDED",    STATUS_SEMAPHORE_LIMIT_EXCEEDED },
     { "SHARING_VIOLATION",           STATUS_SHARING_VIOLATION },
@@ -31,6 +31,7 @@
 #include "windef.h"
 #include "winternl.h"
 
+#include "file.h"
 #include "handle.h"
 #include "thread.h"
 #include "request.h"
@@ -53,22 +54,25 @@ struct type_descr semaphore_type =
 struct semaphore
 {
     struct object  obj;    /* object header */
-    unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    struct inproc_sync sync; /* current count, possibly shared with the client */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     &semaphore_type,               /* type */
     semaphore_dump,                /* dump */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -83,7 +87,7 @@ static const struct object_ops semaphore_ops =
     no_open_file,                  /* open_file */
     no_kernel_obj_list,            /* get_kernel_obj_list */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -103,8 +107,8 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
         if (get_error() != STATUS_OBJECT_NAME_EXISTS)
         {
             /* initialize it if it didn't already exist */
-            sem->count = initial;
-            sem->max   = max;
+            sem->max = max;
+            init_inproc_sync( &sem->sync, INPROC_SYNC_SEMAPHORE, initial, max );
         }
     }
     return sem;
@@ -113,22 +117,21 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
-    if (prev) *prev = sem->count;
-    if (sem->count + count < sem->count || sem->count + count > sem->max)
-    {
-        set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
-        return 0;
-    }
-    else if (sem->count)
-    {
-        /* there cannot be any thread to wake up if the count is != 0 */
-        sem->count += count;
-    }
-    else
+    unsigned int old;
+
+    do
     {
-        sem->count = count;
-        wake_up( &sem->obj, count );
-    }
+        old = get_inproc_sync_state( &sem->sync );
+        if (prev) *prev = old;
+        if (old + count < old || old + count > sem->max)
+        {
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+    } while (!replace_inproc_sync_state( &sem->sync, old, old + count ));
+
+    /* there cannot be any thread to wake up if the count was != 0 */
+    if (!old) wake_up( &sem->obj, count );
     return 1;
 }
 
@@ -136,22 +139,41 @@ static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d\n", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d shared=%d\n", (int)get_inproc_sync_state( &sem->sync ),
+             sem->max, sem->sync.block != NULL );
+}
+
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    return add_inproc_sync_queue( obj, &sem->sync, entry );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    remove_inproc_sync_queue( obj, &sem->sync, entry );
 }
 
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    return (sem->count > 0);
+    return get_inproc_sync_state( &sem->sync ) > 0;
 }
 
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
+    unsigned int count;
+
     assert( obj->ops == &semaphore_ops );
-    assert( sem->count );
-    sem->count--;
+    /* the client can't change the count while we have waiters */
+    count = get_inproc_sync_state( &sem->sync );
+    assert( count );
+    set_inproc_sync_state( &sem->sync, count - 1 );
 }
 
 static int semaphore_signal( struct object *obj, unsigned int access )
@@ -167,6 +189,13 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    free_inproc_sync( &sem->sync );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -183,8 +212,13 @@ DECL_HANDLER(create_semaphore)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, sem, req->access, objattr->attributes );
         else
+        {
+            share_inproc_sync( &sem->sync, current->process );
             reply->handle = alloc_handle_no_access_check( current->process, sem,
                                                           req->access, objattr->attributes );
+        }
+        reply->sync_offset = get_inproc_sync_offset( &sem->sync, reply->handle, SYNCHRONIZE |
+                                                     SEMAPHORE_QUERY_STATE | SEMAPHORE_MODIFY_STATE );
         release_object( sem );
     }
 
@@ -221,7 +255,7 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
+        reply->current = get_inproc_sync_state( &sem->sync );
         reply->max = sem->max;
         release_object( sem );
     }
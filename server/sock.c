@@ -274,6 +274,7 @@ struct sock
     icmp_fixup_data[MAX_ICMP_HISTORY_LENGTH]; /* Sent ICMP packets history used to fixup reply id. */
     struct bound_addr  *bound_addr[2]; /* Links to the entries in bound addresses tree. */
     unsigned int        icmp_fixup_data_len;  /* Sent ICMP packets history length. */
+    struct inproc_sync  inproc;      /* state shared with the client for direct I/O */
     unsigned int        rd_shutdown : 1; /* is the read end shut down? */
     unsigned int        wr_shutdown : 1; /* is the write end shut down? */
     unsigned int        wr_shutdown_pending : 1; /* is a write shutdown pending? */
@@ -770,6 +771,28 @@ void sock_init(void)
     }
 }
 
+/* update the operations that the client may perform without going through the server */
+static void sock_update_inproc( struct sock *sock )
+{
+    unsigned int comp_flags = get_fd_comp_flags( sock->fd );
+    unsigned __int64 state = 0;
+
+    if ((sock->state == SOCK_CONNECTED || sock->state == SOCK_CONNECTIONLESS) && sock->proto != WS_IPPROTO_ICMP)
+    {
+        /* a direct recv() must not have any side effect on the events, nor steal data from a queued async */
+        if (!sock->rd_shutdown && !sock->reset && !sock->accept_recv_req &&
+            !async_queued( &sock->read_q ) && !(sock->reported_events & AFD_POLL_READ))
+            state |= INPROC_SOCKET_RECV;
+        if (!sock->wr_shutdown && !sock->wr_shutdown_pending && (sock->type != WS_SOCK_DGRAM || sock->bound) &&
+            !async_queued( &sock->write_q ))
+            state |= INPROC_SOCKET_SEND;
+    }
+    if (comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS) state |= INPROC_SOCKET_SKIP_PORT;
+    if (comp_flags & FILE_SKIP_SET_EVENT_ON_HANDLE) state |= INPROC_SOCKET_SKIP_SIGNAL;
+    if (sock->nonblocking) state |= INPROC_SOCKET_NONBLOCKING;
+    set_inproc_sync_state( &sock->inproc, state );
+}
+
 static void sock_reselect( struct sock *sock )
 {
     int ev = sock_get_poll_events( sock->fd );
@@ -778,6 +801,7 @@ static void sock_reselect( struct sock *sock )
         fprintf(stderr,"sock_reselect(%p): new mask %x\n", sock, ev);
 
     set_fd_events( sock->fd, ev );
+    sock_update_inproc( sock );
 }
 
 static unsigned int afd_poll_flag_to_win32( unsigned int flags )
@@ -1727,6 +1751,7 @@ static void sock_destroy( struct object *obj )
     free_async_queue( &sock->poll_q );
     if (sock->event) release_object( sock->event );
     if (sock->fd) release_object( sock->fd );
+    free_inproc_sync( &sock->inproc );
 }
 
 static struct sock *create_socket(void)
@@ -1772,6 +1797,7 @@ static struct sock *create_socket(void)
     sock->sndtimeo = 0;
     sock->icmp_fixup_data_len = 0;
     sock->bound_addr[0] = sock->bound_addr[1] = NULL;
+    init_inproc_sync( &sock->inproc, INPROC_SYNC_SOCKET, 0, 0 );
     init_async_queue( &sock->read_q );
     init_async_queue( &sock->write_q );
     init_async_queue( &sock->ifchange_q );
@@ -2850,6 +2876,7 @@ static void sock_ioctl( struct fd *fd, ioctl_code_t code, struct async *async )
             }
             sock->nonblocking = 0;
         }
+        sock_update_inproc( sock );
         return;
 
     case IOCTL_AFD_EVENT_SELECT:
@@ -3926,11 +3953,13 @@ DECL_HANDLER(recv_socket)
             queue_async( &sock->read_q, async );
 
         /* always reselect; we changed reported_events above */
+        share_inproc_sync( &sock->inproc, current->process );
         sock_reselect( sock );
 
         reply->wait = async_handoff( async, NULL, 0 );
         reply->options = get_fd_options( fd );
         reply->nonblocking = sock->nonblocking;
+        reply->sync_offset = get_inproc_sync_offset( &sock->inproc, req->async.handle, 0 );
         release_object( async );
     }
     release_object( sock );
@@ -4048,14 +4077,15 @@ DECL_HANDLER(send_socket)
             async_set_timeout( async, timeout, STATUS_IO_TIMEOUT );
 
         if (status == STATUS_PENDING || status == STATUS_ALERTED)
-        {
             queue_async( &sock->write_q, async );
-            sock_reselect( sock );
-        }
+
+        share_inproc_sync( &sock->inproc, current->process );
+        sock_reselect( sock );
 
         reply->wait = async_handoff( async, NULL, 0 );
         reply->options = get_fd_options( fd );
         reply->nonblocking = sock->nonblocking;
+        reply->sync_offset = get_inproc_sync_offset( &sock->inproc, req->async.handle, 0 );
         release_object( async );
     }
     release_object( sock );